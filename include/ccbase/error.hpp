@@ -9,5 +9,6 @@
 #define Z2EF8C061_9364_490F_9170_196773910B9D
 
 #include <ccbase/error/expected.hpp>
+#include <ccbase/error/errno_expected.hpp>
 
 #endif
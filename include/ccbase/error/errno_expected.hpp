@@ -0,0 +1,130 @@
+/*
+** File Name:	errno_expected.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** `errno_expected<T>` is a counterpart of `expected<T>` for functions whose
+** only failures are system calls that set `errno`. Instead of a
+** `std::exception_ptr`, which costs an allocation to create and an atomic
+** reference count to copy or destroy, it stores the error code as an `int`.
+** An exception is only created if `get` is called on an object that holds an
+** error, in which case a `std::system_error` is thrown.
+**
+** If `T` is trivially copyable, then so is `errno_expected<T>`, so it can be
+** returned in registers, and a call to a function that returns one in a loop
+** costs no more than a check of the error code. For the same reason, unlike
+** `expected<T>`, it does not assert that it was checked before it is destroyed,
+** since doing so would require a destructor.
+**
+** Example:
+**
+**   cc::errno_expected<int> open_file(const char* path)
+**   {
+**   	auto fd = ::open(path, O_RDONLY);
+**   	if (fd == -1) { return cc::current_errno(); }
+**   	return fd;
+**   }
+*/
+
+#ifndef ZBAE165FC_8174_445D_AEA1_474DBFC5A4BA
+#define ZBAE165FC_8174_445D_AEA1_474DBFC5A4BA
+
+#include <cassert>
+#include <cerrno>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <ccbase/platform.hpp>
+
+namespace cc {
+
+/*
+** Used to construct an `errno_expected` that holds an error.
+*/
+struct errno_error
+{
+	int code;
+};
+
+inline errno_error
+current_errno() noexcept
+{ return errno_error{errno}; }
+
+namespace detail {
+
+[[noreturn]] CC_NEVER_INLINE inline void
+throw_errno(int code)
+{ throw std::system_error{code, std::system_category()}; }
+
+}
+
+template <class T>
+class errno_expected
+{
+	static_assert(std::is_default_constructible<T>::value,
+		"Value type must be default-constructible.");
+
+	T t_;
+	// Zero if this object holds a value.
+	int e_;
+public:
+	errno_expected(const T& rhs) noexcept : t_(rhs), e_{0} {}
+	errno_expected(T&& rhs) noexcept : t_(std::move(rhs)), e_{0} {}
+
+	errno_expected(errno_error e) noexcept : t_(), e_{e.code}
+	{ assert(e.code != 0); }
+
+	bool valid() const noexcept
+	{ return e_ == 0; }
+
+	int code() const noexcept
+	{ return e_; }
+
+	std::error_code error() const noexcept
+	{ return std::error_code{e_, std::system_category()}; }
+
+	T& get()
+	{
+		if (e_ != 0) { detail::throw_errno(e_); }
+		return t_;
+	}
+
+	const T& get() const
+	{
+		if (e_ != 0) { detail::throw_errno(e_); }
+		return t_;
+	}
+};
+
+template <>
+class errno_expected<void>
+{
+	int e_;
+public:
+	errno_expected(bool) noexcept : e_{0} {}
+
+	errno_expected(errno_error e) noexcept : e_{e.code}
+	{ assert(e.code != 0); }
+
+	bool valid() const noexcept
+	{ return e_ == 0; }
+
+	int code() const noexcept
+	{ return e_; }
+
+	std::error_code error() const noexcept
+	{ return std::error_code{e_, std::system_category()}; }
+
+	void get() const
+	{ if (e_ != 0) { detail::throw_errno(e_); } }
+};
+
+static_assert(std::is_trivially_copyable<errno_expected<long>>::value,
+	"errno_expected<T> should be trivially copyable for scalar T.");
+static_assert(std::is_trivially_copyable<errno_expected<void>>::value,
+	"errno_expected<void> should be trivially copyable.");
+
+}
+
+#endif
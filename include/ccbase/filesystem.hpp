@@ -8,6 +8,9 @@
 #ifndef Z6ACB21E7_CBB4_4209_8277_C6AD28BF602C
 #define Z6ACB21E7_CBB4_4209_8277_C6AD28BF602C
 
+#include <ccbase/filesystem/compiled_glob.hpp>
+#include <ccbase/filesystem/parallel_walker.hpp>
+#include <ccbase/filesystem/prefetching_directory_iterator.hpp>
 #include <ccbase/filesystem/range.hpp>
 
 #endif
@@ -0,0 +1,236 @@
+/*
+** File Name:	compiled_glob.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** This header defines `compiled_glob`, which accepts the same patterns as
+** `glob_matcher`, but translates the pattern once instead of interpreting it
+** for every string. The pattern is turned into a sequence of character classes
+** (one per `?`, group, or literal character), each of which may be preceded by
+** a wildcard, and strings are matched by running the corresponding NFA with
+** one bit per class (the Shift-And algorithm). Each character then costs a few
+** bitwise operations, and there is no backtracking.
+**
+** Before the NFA is run, the string is checked against the literal prefix and
+** suffix of the pattern, and the longest literal in between is searched for
+** with `memchr` or `memmem`. These functions are vectorized by the C library,
+** so most strings that do not match are rejected without looking at each of
+** their characters.
+**
+** `glob_set` matches a string against several patterns at once. The patterns
+** that end in a literal are indexed by their last character, so only those
+** whose last character agrees with that of the string are tried.
+*/
+
+#ifndef ZC7D45B04_DA1E_4E4A_8113_E177F0488F7F
+#define ZC7D45B04_DA1E_4E4A_8113_E177F0488F7F
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <ccbase/platform.hpp>
+#include <ccbase/filesystem/directory_entry.hpp>
+#include <ccbase/filesystem/glob_matcher.hpp>
+
+namespace cc {
+
+class compiled_glob
+{
+public:
+	// Maximum number of characters, groups, and `?`s in a pattern.
+	static constexpr unsigned max_classes = 63;
+private:
+	// `masks[c]` has bit `k` set if the `k`th class accepts `c`.
+	std::array<uint64_t, 256> masks{};
+	// Bit `k` is set if a wildcard follows the `k`th class (bit zero is
+	// for a wildcard at the start of the pattern).
+	uint64_t loops{};
+	uint64_t accept{};
+	unsigned classes{};
+	bool has_wildcard{};
+
+	// Literal characters at the start of the pattern, before any wildcard
+	// or `?`, and at the end, after the last one.
+	std::string prefix;
+	std::string suffix;
+	// The longest literal run strictly between `prefix` and `suffix`.
+	std::string middle;
+public:
+	explicit compiled_glob(const char* pat)
+	{
+		assert(pat != nullptr && pat[0] != '\0');
+
+		// The literal run that is currently being read, and whether it
+		// began at the start of the pattern.
+		auto run = std::string{};
+		auto anchored = true;
+
+		auto end_run = [&]() {
+			if (anchored) { prefix = run; }
+			else if (run.size() > middle.size()) { middle = run; }
+			run.clear();
+			anchored = false;
+		};
+
+		for (auto i = 0u; pat[i] != '\0';) {
+			if (pat[i] == '*') {
+				loops |= uint64_t{1} << classes;
+				has_wildcard = true;
+				end_run();
+				while (pat[i] == '*') { ++i; }
+				continue;
+			}
+
+			if (classes == max_classes) {
+				throw std::invalid_argument{"Glob pattern is too long."};
+			}
+			auto bit = uint64_t{1} << classes;
+			++classes;
+
+			switch (pat[i]) {
+			case '?':
+				for (auto& m : masks) { m |= bit; }
+				end_run();
+				++i;
+				break;
+			case '[':
+				++i;
+				while (pat[i] != ']') {
+					assert(pat[i] != '\0');
+					i += (pat[i] == '\\');
+					masks[(unsigned char)pat[i]] |= bit;
+					++i;
+				}
+				end_run();
+				++i;
+				break;
+			case '\\':
+				++i;
+				// Fall through.
+			default:
+				masks[(unsigned char)pat[i]] |= bit;
+				run += pat[i];
+				++i;
+			}
+		}
+
+		// The last run is the suffix, unless it is also the prefix.
+		if (anchored) { prefix = run; }
+		else { suffix = run; }
+		accept = uint64_t{1} << classes;
+	}
+
+	/*
+	** Returns the last character of the pattern if it is a literal, and -1
+	** otherwise.
+	*/
+	int last_literal() const noexcept
+	{
+		if (!suffix.empty()) { return (unsigned char)suffix.back(); }
+		if (!has_wildcard && !prefix.empty() && prefix.size() == classes) {
+			return (unsigned char)prefix.back();
+		}
+		return -1;
+	}
+
+	bool operator()(const directory_entry& e) const
+	{ return (*this)(e.name()); }
+
+	bool operator()(const char* s) const
+	{ return match(s, std::strlen(s)); }
+
+	/*
+	** Determines whether the string `s` of length `n` matches the pattern.
+	*/
+	bool match(const char* s, size_t n) const
+	{
+		if (n < classes) { return false; }
+		if (!has_wildcard && n != classes) { return false; }
+
+		auto p = prefix.size();
+		auto q = suffix.size();
+		if (p != 0 && std::memcmp(s, prefix.data(), p) != 0) { return false; }
+		if (q != 0 && std::memcmp(s + n - q, suffix.data(), q) != 0) { return false; }
+
+		if (!middle.empty()) {
+			auto f = s + p;
+			auto len = n - p - q;
+			auto found = middle.size() == 1 ?
+				std::memchr(f, middle[0], len) :
+				::memmem(f, len, middle.data(), middle.size());
+			if (found == nullptr) { return false; }
+		}
+
+		// The prefix consists of the first `p` classes, and none of
+		// them is followed by a wildcard (or it would have ended the
+		// prefix), so the NFA is in exactly one state after them.
+		auto st = uint64_t{1} << p;
+		for (auto i = p; i != n; ++i) {
+			st = ((st & masks[(unsigned char)s[i]]) << 1) | (st & loops);
+			if (st == 0) { return false; }
+		}
+		return (st & accept) != 0;
+	}
+};
+
+/*
+** Matches a string against a set of patterns.
+*/
+class glob_set
+{
+	std::vector<compiled_glob> globs;
+	// Indices of the patterns that end in each literal character.
+	std::array<std::vector<unsigned>, 256> by_last;
+	// Indices of the patterns that do not end in a literal.
+	std::vector<unsigned> others;
+public:
+	explicit glob_set(const std::vector<std::string>& pats)
+	{
+		for (const auto& p : pats) {
+			auto i = unsigned(globs.size());
+			globs.emplace_back(p.c_str());
+			auto c = globs.back().last_literal();
+			if (c == -1) { others.push_back(i); }
+			else { by_last[c].push_back(i); }
+		}
+	}
+
+	bool operator()(const directory_entry& e) const
+	{ return find(e.name()) != -1; }
+
+	bool operator()(const char* s) const
+	{ return find(s) != -1; }
+
+	/*
+	** Returns the index of the first pattern that matches `s`, or -1 if
+	** none does.
+	*/
+	int find(const char* s) const
+	{
+		auto n = std::strlen(s);
+		auto r = -1;
+		auto test = [&](const std::vector<unsigned>& v) {
+			for (const auto& i : v) {
+				if (r != -1 && int(i) > r) { return; }
+				if (globs[i].match(s, n)) {
+					r = i;
+					return;
+				}
+			}
+		};
+
+		if (n != 0) { test(by_last[(unsigned char)s[n - 1]]); }
+		test(others);
+		return r;
+	}
+};
+
+}
+
+#endif
@@ -12,8 +12,8 @@
 ** directory entry, and uses it to reach the next directory entry.
 **
 ** If you need to iterate a very large number of files as fast as possible, then
-** this strategy could be optimized further by using two buffers and
-** preemptively filling the second buffer on another thread while the first
+** use `prefetching_directory_iterator` instead, which uses two buffers of a
+** fixed size and fills the second buffer on another thread while the first
 ** buffer is processed.
 */
 
@@ -126,13 +126,18 @@ public boost::iterator_facade<
 #endif
 
 	ssize_t  bufsz;
-	int      fd;
+	int      fd{-1};
 	int      pos{};
 	unsigned dirlen;
 public:
 	directory_iterator() noexcept : pos{-1} {}
 
-	directory_iterator(const char* dir) : dirlen(std::strlen(dir))
+	/*
+	** If `n` is zero, then the size of the buffer is chosen based on the
+	** size of the directory reported by `fstat`. Otherwise, a buffer of `n`
+	** bytes is used.
+	*/
+	directory_iterator(const char* dir, size_t n = 0) : dirlen(std::strlen(dir))
 	{
 		// Ensure that the string resulting from concatenating the path
 		// to the directory, the platform directory separator, and the
@@ -153,7 +158,7 @@ public:
 				"Failed to get directory status"};
 		}
 
-		bufsz = detail::rumpot(s.st_size, s.st_blksize);
+		bufsz = n != 0 ? n : detail::rumpot(s.st_size, s.st_blksize);
 		buf   = std::unique_ptr<char[]>{new char[bufsz]};
 
 		// We do not want to copy the null character, so we only copy
@@ -165,7 +170,9 @@ public:
 
 	~directory_iterator()
 	{
-		::close(fd);
+		if (fd != -1) {
+			::close(fd);
+		}
 	}
 
 	/*
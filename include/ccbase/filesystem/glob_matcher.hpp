@@ -75,6 +75,15 @@ public:
 	** pattern.
 	*/
 	bool operator()(const directory_entry& e) const
+	{
+		return (*this)(e.name());
+	}
+
+	/*
+	** Determines whether the null-terminated string `s` matches the glob
+	** pattern.
+	*/
+	bool operator()(const char* s) const
 	{
 		#ifndef NDEBUG
 			assert(pat != nullptr);
@@ -82,9 +91,8 @@ public:
 
 		// Offset into pattern that we are matching.
 		auto i = 0u;
-		// Offset into the file name.
+		// Offset into the string.
 		auto j = 0u;
-		auto s = e.name();
 
 		do switch(pat[i]) {
 		default:   if (pat[i++] != s[j++])           return false; continue;
@@ -187,6 +195,8 @@ private:
 					continue;
 				}
 		}
+		// Trailing wildcards match the empty string.
+		while (pat[i] == '*') { ++i; }
 		return pat[i] == '\0';
 	}
 };
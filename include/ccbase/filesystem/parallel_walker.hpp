@@ -0,0 +1,402 @@
+/*
+** File Name:	parallel_walker.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** This header defines a recursive directory walker that lists the directories
+** of a tree on a pool of threads. Walking a deep or wide tree on one thread is
+** bound by the latency of each `getdents` call, so listing several directories
+** at once scales with the number of cores until the device is saturated.
+**
+** Each worker owns a deque of directories that remain to be listed. A worker
+** pushes the subdirectories that it finds onto the back of its own deque and
+** takes its next directory from the back as well, so that it walks its part of
+** the tree depth-first. A worker whose deque is empty steals from the front of
+** another worker's deque, which holds the directories closest to the root, and
+** hence most likely the largest subtrees. The deques are not the lock-free
+** work-stealing deques of Chase and Lev: each one is a `std::deque` guarded by
+** a mutex, which suffices because a deque is only touched a few times for each
+** directory, and listing the directory costs far more than taking the lock.
+**
+** The entries are handed to the thread that called `for_each` through a
+** bounded lock-free queue. The type of each entry is taken from `d_type`;
+** `lstat` is only called for file systems that do not fill it in. Symbolic
+** links are reported, but not followed. Subdirectories that cannot be opened,
+** because of their permissions or because they were removed or replaced during
+** the walk, are skipped and counted, as `find` would skip them.
+*/
+
+#ifndef Z4CFD3436_4797_476A_A1FC_71B39A357F06
+#define Z4CFD3436_4797_476A_A1FC_71B39A357F06
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <ccbase/platform.hpp>
+#include <ccbase/filesystem/directory_iterator.hpp>
+#include <ccbase/filesystem/glob_matcher.hpp>
+
+namespace cc {
+
+namespace detail {
+
+/*
+** A bounded multiple-producer, multiple-consumer queue, due to Dmitry Vyukov.
+** Each cell carries a sequence number that tells producers and consumers
+** whether it is free for the current lap around the ring, so that neither
+** side needs a lock. The capacity must be a power of two.
+*/
+template <class T>
+class bounded_queue
+{
+	struct cell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	std::unique_ptr<cell[]> cells;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head{0};
+	alignas(64) std::atomic<size_t> tail{0};
+public:
+	explicit bounded_queue(size_t n) :
+	cells{new cell[n]}, mask{n - 1}
+	{
+		assert(n >= 2 && (n & (n - 1)) == 0);
+		for (auto i = size_t{0}; i != n; ++i) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool push(T& x)
+	{
+		auto pos = tail.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& c = cells[pos & mask];
+			auto seq = c.seq.load(std::memory_order_acquire);
+			auto d = intptr_t(seq) - intptr_t(pos);
+
+			if (d == 0) {
+				if (tail.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				{
+					c.data = std::move(x);
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (d < 0) {
+				return false;
+			}
+			else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(T& x)
+	{
+		auto pos = head.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& c = cells[pos & mask];
+			auto seq = c.seq.load(std::memory_order_acquire);
+			auto d = intptr_t(seq) - intptr_t(pos + 1);
+
+			if (d == 0) {
+				if (head.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				{
+					x = std::move(c.data);
+					c.seq.store(pos + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (d < 0) {
+				return false;
+			}
+			else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+}
+
+struct walk_entry
+{
+	// Path of the entry, beginning with the root of the walk.
+	std::string path;
+	file_type type;
+	// Depth of the entry below the root; the children of the root have
+	// depth one.
+	unsigned depth;
+};
+
+struct walk_options
+{
+	unsigned threads{std::max(1u, std::thread::hardware_concurrency())};
+	// If not null, only entries whose names match this glob are reported.
+	// All directories are still descended into.
+	const char* match{nullptr};
+	// Only entries at most this deep are reported.
+	unsigned max_depth{~0u};
+	// Size of the buffer used by each `directory_iterator`, or zero to
+	// let the iterator choose.
+	size_t buffer_size{0};
+	// Number of entries that can be waiting to be consumed.
+	size_t queue_size{1 << 14};
+};
+
+class parallel_walker
+{
+	struct work_item
+	{
+		std::string path;
+		unsigned depth;
+	};
+
+	struct worker_deque
+	{
+		std::mutex m;
+		std::deque<work_item> items;
+	};
+
+	std::string root;
+	walk_options opts;
+	glob_matcher match;
+	std::unique_ptr<worker_deque[]> deques;
+	detail::bounded_queue<walk_entry> out;
+	std::vector<std::exception_ptr> errors;
+	// Number of subdirectories that could not be opened.
+	std::atomic<size_t> skipped_dirs{0};
+	// Number of directories that have been found but not yet listed.
+	std::atomic<size_t> pending{0};
+	// Number of workers that have not yet exited.
+	std::atomic<unsigned> running{0};
+	std::atomic<bool> abort{false};
+public:
+	explicit parallel_walker(const char* root, const walk_options& o = {}) :
+	root{root}, opts{o}, deques{new worker_deque[std::max(o.threads, 1u)]},
+	out{queue_capacity(o.queue_size)}, errors(std::max(o.threads, 1u))
+	{
+		opts.threads = std::max(opts.threads, 1u);
+		if (o.match != nullptr) { match = glob_matcher{o.match}; }
+		while (this->root.size() > 1 && this->root.back() == '/') {
+			this->root.pop_back();
+		}
+	}
+
+	parallel_walker(const parallel_walker&) = delete;
+	parallel_walker& operator=(const parallel_walker&) = delete;
+
+	/*
+	** Walks the tree, and calls `f(e)` on the calling thread for each
+	** entry `e`, in no particular order. If `f` throws, then the walk is
+	** stopped and the exception is rethrown. Otherwise, the first error
+	** encountered by a worker (e.g. a directory that cannot be opened) is
+	** rethrown after all workers have stopped.
+	*/
+	template <class Function>
+	void for_each(const Function& f)
+	{
+		// Clear the state left behind by a previous walk, which may
+		// have been stopped before all of the directories were listed.
+		for (auto t = 0u; t != opts.threads; ++t) {
+			deques[t].items.clear();
+			errors[t] = nullptr;
+		}
+		skipped_dirs.store(0, std::memory_order_relaxed);
+		abort.store(false, std::memory_order_relaxed);
+		pending.store(1, std::memory_order_relaxed);
+		deques[0].items.push_back({root, 0});
+		running.store(opts.threads, std::memory_order_relaxed);
+
+		auto ts = std::vector<std::thread>{};
+		for (auto t = 0u; t != opts.threads; ++t) {
+			ts.emplace_back([this, t] { work(t); });
+		}
+
+		try {
+			auto e = walk_entry{};
+			for (;;) {
+				if (out.pop(e)) {
+					f(e);
+					continue;
+				}
+				if (running.load(std::memory_order_acquire) != 0) {
+					std::this_thread::yield();
+					continue;
+				}
+				// All workers have exited, so the queue can no
+				// longer be refilled.
+				while (out.pop(e)) { f(e); }
+				break;
+			}
+		}
+		catch (...) {
+			abort.store(true, std::memory_order_relaxed);
+			for (auto& t : ts) { t.join(); }
+			throw;
+		}
+
+		for (auto& t : ts) { t.join(); }
+		for (const auto& e : errors) {
+			if (e) { std::rethrow_exception(e); }
+		}
+	}
+
+	/*
+	** Returns the number of subdirectories that were skipped by the last
+	** walk because they could not be opened.
+	*/
+	size_t skipped() const noexcept
+	{ return skipped_dirs.load(std::memory_order_relaxed); }
+private:
+	static size_t queue_capacity(size_t n)
+	{
+		auto r = size_t{2};
+		while (r < n) { r <<= 1; }
+		return r;
+	}
+
+	bool take(unsigned t, work_item& w)
+	{
+		{
+			auto& d = deques[t];
+			std::lock_guard<std::mutex> g{d.m};
+			if (!d.items.empty()) {
+				w = std::move(d.items.back());
+				d.items.pop_back();
+				return true;
+			}
+		}
+
+		for (auto i = 1u; i != opts.threads; ++i) {
+			auto& d = deques[(t + i) % opts.threads];
+			std::lock_guard<std::mutex> g{d.m};
+			if (!d.items.empty()) {
+				w = std::move(d.items.front());
+				d.items.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void emit(walk_entry& e)
+	{
+		while (!out.push(e)) {
+			if (abort.load(std::memory_order_relaxed)) { return; }
+			std::this_thread::yield();
+		}
+	}
+
+	/*
+	** Returns true if `e` is an error from opening a directory that a walk
+	** should skip rather than stop for.
+	*/
+	static bool skippable(const std::error_code& e) noexcept
+	{
+		return e.category() == std::system_category() &&
+			(e.value() == EACCES || e.value() == ENOENT ||
+			e.value() == ENOTDIR);
+	}
+
+	void list(unsigned t, const work_item& w)
+	{
+		try {
+			list_entries(t, w);
+		}
+		catch (const std::system_error& e) {
+			// The root must be listable; any other directory is
+			// only skipped.
+			if (w.depth == 0 || !skippable(e.code())) { throw; }
+			skipped_dirs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void list_entries(unsigned t, const work_item& w)
+	{
+		auto end = directory_iterator{};
+		for (auto it = directory_iterator{w.path.c_str(), opts.buffer_size}; it != end; ++it) {
+			if (abort.load(std::memory_order_relaxed)) { return; }
+
+			auto d = *it;
+			auto n = d.name();
+			if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'))) {
+				continue;
+			}
+
+			auto type = d.type();
+			if (type == file_type::unknown) {
+				struct stat s;
+				if (::lstat(d.path(), &s) == -1) {
+					// The entry was removed after it was listed.
+					if (errno == ENOENT) { continue; }
+					throw std::system_error{errno, std::system_category(),
+						"Failed to get file status"};
+				}
+				type = S_ISDIR(s.st_mode) ? file_type::directory :
+					S_ISLNK(s.st_mode) ? file_type::symbolic_link :
+					S_ISREG(s.st_mode) ? file_type::regular :
+					file_type::unknown;
+			}
+
+			if (type == file_type::directory && w.depth + 1 < opts.max_depth) {
+				pending.fetch_add(1, std::memory_order_relaxed);
+				auto& q = deques[t];
+				std::lock_guard<std::mutex> g{q.m};
+				q.items.push_back({d.path(), w.depth + 1});
+			}
+			if (opts.match == nullptr || match(n)) {
+				auto e = walk_entry{d.path(), type, w.depth + 1};
+				emit(e);
+			}
+		}
+	}
+
+	void work(unsigned t)
+	{
+		try {
+			auto w = work_item{};
+			while (!abort.load(std::memory_order_relaxed)) {
+				if (take(t, w)) {
+					list(t, w);
+					pending.fetch_sub(1, std::memory_order_acq_rel);
+				}
+				else if (pending.load(std::memory_order_acquire) == 0) {
+					break;
+				}
+				else {
+					std::this_thread::yield();
+				}
+			}
+		}
+		catch (...) {
+			errors[t] = std::current_exception();
+			abort.store(true, std::memory_order_relaxed);
+		}
+		running.fetch_sub(1, std::memory_order_release);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+** File Name:	prefetching_directory_iterator.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** This header defines an alternative to `directory_iterator` for very large
+** directories. It uses two buffers of a fixed size, and a second thread that
+** fills one buffer with the next chunk of directory entries while the entries
+** in the other one are being processed. The handoff of each buffer is done in
+** the same way as the double-buffer IO engines: through an atomic length that
+** is either the number of bytes read or `empty`.
+**
+** On Linux, the entries are read with `getdents64`. The size of the buffer is
+** not derived from the size of the directory reported by `fstat`, since on
+** ext4 and XFS this grows with the number of entries (leading to a buffer of
+** hundreds of megabytes for a directory with millions of entries), and bears
+** no relation to the number of entries for directories stored inline in the
+** inode.
+**
+** The entry returned by dereferencing the iterator is only valid until the
+** iterator is next incremented.
+*/
+
+#ifndef ZC7A396FD_7BF1_4F55_A410_944BF533DAE4
+#define ZC7A396FD_7BF1_4F55_A410_944BF533DAE4
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <boost/iterator/iterator_facade.hpp>
+#include <ccbase/platform.hpp>
+#include <ccbase/filesystem/directory_entry.hpp>
+#include <ccbase/filesystem/system_call.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	// For POSIX open.
+	#include <fcntl.h>
+	// For POSIX close.
+	#include <unistd.h>
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	// For POSIX open.
+	#include <fcntl.h>
+	// For POSIX close.
+	#include <unistd.h>
+	// For definition of struct dirent.
+	#include <sys/dirent.h>
+#else
+	#error "Unsupported kernel."
+#endif
+
+#if PLATFORM_MAX_FILENAME_LENGTH == PLATFORM_MAX_FILENAME_LENGTH_UNKNOWN || \
+    PLATFORM_MAX_PATHNAME_LENGTH == PLATFORM_MAX_PATHNAME_LENGTH_UNKNOWN || \
+    !defined(PLATFORM_DIRECTORY_SEPARATOR)
+	#error "Could not determine necessary information about platform."
+#endif
+
+namespace cc {
+
+class prefetching_directory_iterator;
+
+namespace detail {
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+struct linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t  d_off;
+	uint16_t d_reclen;
+	uint8_t  d_type;
+	// The name is null-terminated, and extends past the end of the
+	// structure up to `d_reclen`.
+	char     d_name[1];
+};
+
+#endif
+
+/*
+** The state shared by a `prefetching_directory_iterator` and the thread that
+** fills its buffers.
+*/
+class prefetch_state
+{
+public:
+	static constexpr ssize_t empty = -2;
+private:
+	struct slot
+	{
+		std::atomic<ssize_t> len{empty};
+		std::unique_ptr<char[]> buf;
+		// Keeps the lengths of the two buffers on different cache
+		// lines. Over-aligning the structure instead would require
+		// C++17 to allocate it with `new`.
+		char pad[64 - sizeof(std::atomic<ssize_t>) - sizeof(std::unique_ptr<char[]>)];
+	};
+
+	std::array<slot, 2> slots;
+	std::atomic<bool> stop{false};
+	std::thread worker;
+	size_t bufsz;
+	int fd;
+	int err{};
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	off_t off{};
+#endif
+public:
+	prefetch_state(const char* dir, size_t n) : bufsz{n}
+	{
+		fd = ::open(dir, O_RDONLY | O_DIRECTORY);
+		if (fd < 0) {
+			throw std::system_error{errno, std::system_category(),
+				"Failed to open directory"};
+		}
+
+		try {
+			for (auto& s : slots) {
+				s.buf = std::unique_ptr<char[]>{new char[bufsz]};
+			}
+			worker = std::thread{[this] { fill(); }};
+		}
+		catch (...) {
+			::close(fd);
+			throw;
+		}
+	}
+
+	prefetch_state(const prefetch_state&) = delete;
+	prefetch_state& operator=(const prefetch_state&) = delete;
+
+	~prefetch_state()
+	{
+		stop.store(true, std::memory_order_relaxed);
+		worker.join();
+		::close(fd);
+	}
+
+	/*
+	** Waits for buffer `i` to be filled, and returns the number of bytes
+	** read into it. A return value of zero indicates the end of the
+	** directory, and -1 an error, whose code is given by `error()`.
+	*/
+	ssize_t wait(unsigned i) const noexcept
+	{
+		auto r = ssize_t{};
+		while ((r = slots[i].len.load(std::memory_order_acquire)) == empty) {
+			std::this_thread::yield();
+		}
+		return r;
+	}
+
+	/*
+	** Hands buffer `i` back to the worker thread, so that it can be
+	** refilled.
+	*/
+	void release(unsigned i) noexcept
+	{ slots[i].len.store(empty, std::memory_order_release); }
+
+	char* buffer(unsigned i) const noexcept
+	{ return slots[i].buf.get(); }
+
+	int error() const noexcept
+	{ return err; }
+private:
+	void fill() noexcept
+	{
+		for (auto i = 0u;; i ^= 1) {
+			while (slots[i].len.load(std::memory_order_acquire) != empty) {
+				if (stop.load(std::memory_order_relaxed)) { return; }
+				std::this_thread::yield();
+			}
+			if (stop.load(std::memory_order_relaxed)) { return; }
+
+			#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+				auto r = ssize_t(getdents64(fd, slots[i].buf.get(), bufsz));
+			#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+				auto r = ssize_t(getdirentries64(fd, slots[i].buf.get(), bufsz, &off));
+			#endif
+
+			if (r == -1) { err = errno; }
+			slots[i].len.store(r, std::memory_order_release);
+			if (r <= 0) { return; }
+		}
+	}
+};
+
+}
+
+class prefetched_directory_entry
+{
+private:
+	friend class prefetching_directory_iterator;
+
+	using length_type = uint16_t;
+
+	const prefetching_directory_iterator* p;
+	const char* n;
+	const length_type len;
+	const file_type t;
+
+	prefetched_directory_entry(
+		const prefetching_directory_iterator& p,
+		const char* n,
+		const length_type len,
+		const file_type t
+	) noexcept : p{&p}, n{n}, len{len}, t{t} {}
+public:
+	// Defined below, after `prefetching_directory_iterator`.
+	const char* path() const;
+	const char* name() const { return n; }
+	file_type type() const { return t; }
+};
+
+/*
+** Unlike `directory_iterator`, this iterator cannot be copied, since copying
+** it would require a second thread. It can be moved.
+*/
+
+class prefetching_directory_iterator :
+public boost::iterator_facade<
+	prefetching_directory_iterator, prefetched_directory_entry,
+	boost::single_pass_traversal_tag, prefetched_directory_entry
+>
+{
+	using length_type = prefetched_directory_entry::length_type;
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	using native_dirent = detail::linux_dirent64;
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	using native_dirent = ::dirent;
+#endif
+
+	mutable std::array<char, PLATFORM_MAX_PATHNAME_LENGTH> pathbuf;
+	std::unique_ptr<detail::prefetch_state> st;
+	char*    f{};
+	char*    l{};
+	unsigned cur{};
+	int      pos{-1};
+	unsigned dirlen{};
+public:
+	// Size of each of the two buffers if none is given.
+	static constexpr size_t default_buffer_size = 256 * 1024;
+
+	prefetching_directory_iterator() noexcept {}
+
+	/*
+	** Uses two buffers of `n` bytes each, or of `default_buffer_size`
+	** bytes if `n` is zero. Each buffer must be large enough to hold at
+	** least one directory entry.
+	*/
+	explicit prefetching_directory_iterator(const char* dir, size_t n = 0) :
+	pos{0}, dirlen(std::strlen(dir))
+	{
+		// See the corresponding comment in `directory_iterator`.
+		assert(dirlen + 1 + PLATFORM_MAX_FILENAME_LENGTH + 1 <=
+			PLATFORM_MAX_PATHNAME_LENGTH);
+
+		st = std::unique_ptr<detail::prefetch_state>{new detail::prefetch_state{
+			dir, n != 0 ? n : default_buffer_size}};
+		std::copy(dir, dir + dirlen, pathbuf.data());
+		pathbuf[dirlen] = PLATFORM_DIRECTORY_SEPARATOR;
+
+		if (acquire()) { settle(); }
+	}
+
+	prefetching_directory_iterator(const prefetching_directory_iterator&) = delete;
+	prefetching_directory_iterator& operator=(const prefetching_directory_iterator&) = delete;
+	prefetching_directory_iterator(prefetching_directory_iterator&&) = default;
+	prefetching_directory_iterator& operator=(prefetching_directory_iterator&&) = default;
+private:
+	friend class prefetched_directory_entry;
+	friend class boost::iterator_core_access;
+
+	/*
+	** Waits for the current buffer to be filled. Returns false if the end
+	** of the directory was reached, in which case the worker thread is
+	** stopped.
+	*/
+	bool acquire()
+	{
+		auto r = st->wait(cur);
+		if (r > 0) {
+			f = st->buffer(cur);
+			l = f + r;
+			return true;
+		}
+
+		auto e = st->error();
+		st.reset();
+		pos = -1;
+		if (r == -1) {
+			throw std::system_error{e, std::system_category(),
+				"Failed to read directory entries"};
+		}
+		return false;
+	}
+
+	/*
+	** Skips over deleted entries, and moves on to the next buffer once the
+	** current one has been exhausted.
+	*/
+	void settle()
+	{
+		for (;;) {
+			while (f < l && ((native_dirent*)f)->d_ino == 0) {
+				f += ((native_dirent*)f)->d_reclen;
+			}
+			if (f < l) { return; }
+
+			st->release(cur);
+			cur ^= 1;
+			if (!acquire()) { return; }
+		}
+	}
+
+	void increment()
+	{
+		f += ((native_dirent*)f)->d_reclen;
+		++pos;
+		settle();
+	}
+
+	prefetched_directory_entry dereference() const
+	{
+		auto e = (native_dirent*)f;
+		#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+			return { *this, e->d_name, length_type(std::strlen(e->d_name)),
+				static_cast<file_type>(e->d_type) };
+		#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+			return { *this, e->d_name, e->d_namlen,
+				static_cast<file_type>(e->d_type) };
+		#endif
+	}
+
+	bool equal(const prefetching_directory_iterator& rhs) const
+	{
+		return pos == rhs.pos;
+	}
+
+	void update_path(const char* fn, length_type n) const
+	{
+		std::copy(fn, fn + n, pathbuf.data() + dirlen + 1);
+		pathbuf[dirlen + 1 + n] = '\0';
+	}
+
+	const char* path() const { return pathbuf.data(); }
+};
+
+inline const char* prefetched_directory_entry::path() const
+{
+	p->update_path(n, len);
+	return p->path();
+}
+
+}
+
+#endif
@@ -40,6 +40,12 @@ getdents(unsigned fd, char* buf, unsigned n)
 	return ::syscall(SYS_getdents, fd, buf, n);
 }
 
+CC_ALWAYS_INLINE long
+getdents64(unsigned fd, char* buf, size_t n)
+{
+	return ::syscall(SYS_getdents64, fd, buf, n);
+}
+
 #elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
 
 CC_ALWAYS_INLINE user_ssize_t
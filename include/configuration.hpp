@@ -8,8 +8,37 @@
 #ifndef Z86A588AA_6D5A_4CA1_B36E_3EE127F9AF1D
 #define Z86A588AA_6D5A_4CA1_B36E_3EE127F9AF1D
 
-// Number of times to run each method.
-static constexpr auto num_trials = 5;
+#include <cstddef>
+#include <cstdint>
+
+struct sampler_options
+{
+	// Number of untimed trials to run before sampling each method.
+	unsigned warmup_trials{1};
+	// Minimum number of timed trials for each method.
+	unsigned min_trials{5};
+	// Maximum number of timed trials for each method.
+	unsigned max_trials{50};
+	// Wall-clock time after which sampling stops, even if the confidence
+	// interval is still too wide (ms).
+	double time_budget{60000};
+	// Sampling stops once the width of the confidence interval for the
+	// median is at most this fraction of the median.
+	double target_ci_width{0.05};
+	// Confidence level of the interval for the median.
+	double ci_level{0.95};
+	// Number of resamples used to compute the bootstrap confidence
+	// interval.
+	unsigned bootstrap_resamples{2000};
+};
+
+// The options used by `sample_trials`. These can be overridden from the
+// command line of the driver.
+static auto sampler = sampler_options{};
+// Alignment used to keep variables that are written by different threads on
+// separate cache lines. This is two lines, since the adjacent-line prefetcher on
+// Intel CPUs fetches lines in pairs.
+static constexpr auto cache_line_size = size_t{128};
 // Special byte value used to verify correctness for the read benchmark.
 static constexpr auto needle = uint8_t{0xFF};
 
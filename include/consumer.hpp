@@ -0,0 +1,276 @@
+/*
+** File Name:	consumer.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** The work that the read engines do on each block once it has been read. By
+** default, they count the occurrences of `needle`, which costs almost nothing
+** per byte, so the engines that overlap IO with computation have nothing to
+** overlap. The other stages stand in for the parsers that consume the data in
+** practice: CRC32C (with SSE 4.2 when the build targets it), a 64-bit
+** non-cryptographic hash, a copy into an application buffer, and a synthetic
+** load of a given number of cycles per byte. Running the engines with
+** increasingly expensive stages shows the point at which the double-buffer and
+** AIO engines pay off over a plain `pread` loop.
+**
+** The stages other than `count` contribute zero to the value returned by the
+** engines, and store their results in a sink so that they are not optimized
+** away. For these stages, `check` also returns zero, so the check of the value
+** returned by each trial still holds.
+*/
+
+#ifndef ZD80C8B1E_607A_4560_81FA_17FA6B229E63
+#define ZD80C8B1E_607A_4560_81FA_17FA6B229E63
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+#include <ccbase/format.hpp>
+
+#include <configuration.hpp>
+#include <options.hpp>
+
+#ifdef __SSE4_2__
+	#include <nmmintrin.h>
+#endif
+
+enum class consumer_kind
+{
+	// Counts the occurrences of `needle`.
+	count,
+	crc32c,
+	hash,
+	// Copies the block into an application buffer.
+	copy,
+	// Spends about `cycles` cycles on each byte.
+	burn
+};
+
+struct consumer_stage
+{
+	consumer_kind kind{consumer_kind::count};
+	unsigned cycles{0};
+};
+
+// The stage run by the read engines. This can be overridden from the command
+// line of the driver.
+static auto current_consumer = consumer_stage{};
+
+static std::string
+consumer_name(const consumer_stage& c)
+{
+	switch (c.kind) {
+	case consumer_kind::count:  return "count";
+	case consumer_kind::crc32c: return "crc32c";
+	case consumer_kind::hash:   return "hash";
+	case consumer_kind::copy:   return "copy";
+	case consumer_kind::burn:   return "burn:" + std::to_string(c.cycles);
+	}
+	return "unknown";
+}
+
+/*
+** Parses a stage of the form `count`, `crc32c`, `hash`, `copy`, or `burn:N`.
+*/
+static consumer_stage
+parse_consumer(const std::string& s)
+{
+	auto c = consumer_stage{};
+	if      (s == "count")  { c.kind = consumer_kind::count; }
+	else if (s == "crc32c") { c.kind = consumer_kind::crc32c; }
+	else if (s == "hash")   { c.kind = consumer_kind::hash; }
+	else if (s == "copy")   { c.kind = consumer_kind::copy; }
+	else if (s.compare(0, 5, "burn:") == 0) {
+		c.kind = consumer_kind::burn;
+		c.cycles = parse_count(s.c_str() + 5);
+	}
+	else {
+		throw std::invalid_argument{cc::format("invalid consumer \"$\"", s)};
+	}
+	return c;
+}
+
+namespace detail {
+
+static std::atomic<uint64_t> consumer_sink{0};
+
+static void
+sink(uint64_t x)
+{ consumer_sink.store(x, std::memory_order_relaxed); }
+
+static uint64_t
+load_u64(const uint8_t* p)
+{
+	auto x = uint64_t{};
+	std::memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+static uint64_t
+rotl(uint64_t x, unsigned r)
+{ return (x << r) | (x >> (64 - r)); }
+
+#ifndef __SSE4_2__
+
+static const std::array<uint32_t, 256>&
+crc32c_table()
+{
+	static const auto t = []() {
+		auto r = std::array<uint32_t, 256>{};
+		for (auto i = uint32_t{0}; i != 256; ++i) {
+			auto c = i;
+			for (auto j = 0; j != 8; ++j) {
+				c = (c >> 1) ^ (c & 1 ? 0x82F63B78 : 0);
+			}
+			r[i] = c;
+		}
+		return r;
+	}();
+	return t;
+}
+
+#endif
+
+}
+
+/*
+** Computes the CRC32C (Castagnoli) of the `n` bytes at `p`.
+*/
+static uint32_t
+crc32c(const uint8_t* p, size_t n)
+{
+	auto c = ~uint32_t{0};
+#ifdef __SSE4_2__
+	auto c64 = uint64_t{c};
+	for (; n >= 8; p += 8, n -= 8) {
+		c64 = _mm_crc32_u64(c64, detail::load_u64(p));
+	}
+	c = uint32_t(c64);
+	for (; n != 0; ++p, --n) { c = _mm_crc32_u8(c, *p); }
+#else
+	const auto& t = detail::crc32c_table();
+	for (; n != 0; ++p, --n) { c = t[(c ^ *p) & 0xFF] ^ (c >> 8); }
+#endif
+	return ~c;
+}
+
+/*
+** A 64-bit hash of the `n` bytes at `p`, using the round and avalanche
+** functions of XXH64 over four interleaved lanes.
+*/
+static uint64_t
+hash64(const uint8_t* p, size_t n)
+{
+	static constexpr auto p1 = uint64_t{11400714785074694791ull};
+	static constexpr auto p2 = uint64_t{14029467366897019727ull};
+	static constexpr auto p3 = uint64_t{1609587929392839161ull};
+	static constexpr auto p4 = uint64_t{9650029242287828579ull};
+	static constexpr auto p5 = uint64_t{2870177450012600261ull};
+
+	auto round = [](uint64_t a, uint64_t w) {
+		return detail::rotl(a + w * p2, 31) * p1;
+	};
+
+	auto len = uint64_t(n);
+	auto h = p5;
+	if (n >= 32) {
+		auto a = std::array<uint64_t, 4>{{p1 + p2, p2, 0, 0 - p1}};
+		for (; n >= 32; p += 32, n -= 32) {
+			for (auto i = 0; i != 4; ++i) {
+				a[i] = round(a[i], detail::load_u64(p + 8 * i));
+			}
+		}
+		h = detail::rotl(a[0], 1) + detail::rotl(a[1], 7) +
+			detail::rotl(a[2], 12) + detail::rotl(a[3], 18);
+		for (const auto& x : a) { h = (h ^ round(0, x)) * p1 + p4; }
+	}
+	h += len;
+	for (; n >= 8; p += 8, n -= 8) {
+		h = detail::rotl(h ^ round(0, detail::load_u64(p)), 27) * p1 + p4;
+	}
+	for (; n != 0; ++p, --n) {
+		h = detail::rotl(h ^ (*p * p5), 11) * p1;
+	}
+
+	h ^= h >> 33;
+	h *= p2;
+	h ^= h >> 29;
+	h *= p3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*
+** Copies the `n` bytes at `p` into a buffer owned by the calling thread, in
+** pieces of at most 4 MB, so that the `mmap` engines do not allocate a buffer
+** the size of the file.
+*/
+static uint64_t
+copy_out(const uint8_t* p, size_t n)
+{
+	static constexpr auto max_size = size_t{4} << 20;
+	thread_local auto buf = std::unique_ptr<uint8_t[]>{};
+	thread_local auto size = size_t{0};
+
+	auto s = std::min(n, max_size);
+	if (size < s) {
+		buf.reset(new uint8_t[s]);
+		size = s;
+	}
+	auto x = uint64_t{0};
+	while (n != 0) {
+		auto m = std::min(n, s);
+		std::memcpy(buf.get(), p, m);
+		x += buf[m - 1];
+		p += m;
+		n -= m;
+	}
+	return x;
+}
+
+/*
+** Spends about `cycles` cycles on each of the `n` bytes at `p`, by running a
+** chain of dependent additions that the compiler is not allowed to fold.
+*/
+static uint64_t
+burn(const uint8_t* p, size_t n, unsigned cycles)
+{
+	auto x = uint64_t{0};
+	for (auto i = size_t{0}; i != n; ++i) {
+		auto b = uint64_t{p[i]};
+		for (auto j = 0u; j != cycles; ++j) {
+			x += b;
+			asm volatile("" : "+r"(x));
+		}
+	}
+	return x;
+}
+
+/*
+** Runs `current_consumer` on the `n` bytes at `p`. Returns the number of
+** occurrences of `needle` for the `count` stage, and zero otherwise.
+*/
+static off_t
+consume(const uint8_t* p, size_t n)
+{
+	switch (current_consumer.kind) {
+	case consumer_kind::count:
+		return std::count_if(p, p + n, [](auto x) { return x == needle; });
+	case consumer_kind::crc32c: detail::sink(crc32c(p, n)); break;
+	case consumer_kind::hash:   detail::sink(hash64(p, n)); break;
+	case consumer_kind::copy:   detail::sink(copy_out(p, n)); break;
+	case consumer_kind::burn:
+		detail::sink(burn(p, n, current_consumer.cycles));
+		break;
+	}
+	return 0;
+}
+
+#endif
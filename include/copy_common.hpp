@@ -8,20 +8,41 @@
 #ifndef ZD867F4DE_A8CC_4B2A_807C_F44862C521A4
 #define ZD867F4DE_A8CC_4B2A_807C_F44862C521A4
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cassert>
+#include <memory>
 #include <thread>
+#include <tuple>
 #include <io_common.hpp>
 #include <configuration.hpp>
+#include <placement.hpp>
+#include <registry.hpp>
 
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <sys/sendfile.h>
+#endif
+
+/*
+** Copies `in` to `out` in blocks of `buf_size`. If `out` was opened with
+** `O_DIRECT`, then `align` is the alignment required for the lengths of the
+** writes: the last block is padded to it, and `out` is then truncated to the
+** size of `in`.
+*/
 static void
-copy_loop(int in, int out, uint8_t* buf, size_t buf_size)
+copy_loop(int in, int out, uint8_t* buf, size_t buf_size, size_t align = 1)
 {
 	auto off = off_t{0};
 	for (;;) {
-		auto r = full_read(in, buf, buf_size, off).get();
-		auto s = full_write(out, buf, r, off).get();
-		assert(r == s);
-		if (size_t(r) < buf_size) { return; }
+		auto r = size_t(full_read(in, buf, buf_size, off).get());
+		auto m = (r + align - 1) / align * align;
+		auto s = size_t(full_write(out, buf, m, off).get());
+		assert(s == m);
+		if (r < buf_size) {
+			if (m != r) { truncate(out, off_t(off + r)); }
+			return;
+		}
 		off += buf_size;
 	}
 }
@@ -36,6 +57,7 @@ copy_worker(
 	std::atomic<int>& cv2
 )
 {
+	thread_binding b{current_placement.io_cpu, current_placement.io_node};
 	auto r = int{};
 	auto s = int{};
 	auto off = off_t{0};
@@ -75,6 +97,11 @@ async_copy_loop(
 	size_t buf_size
 )
 {
+	thread_binding b{current_placement.consumer_cpu,
+		current_placement.consumer_node};
+	buffer_binding bb1{buf1, buf_size, current_placement.buffer_node};
+	buffer_binding bb2{buf2, buf_size, current_placement.buffer_node};
+
 	auto r = full_read(in, buf1, buf_size, 0).get();
 	if (size_t(r) < buf_size) {
 		auto s = full_write(out, buf1, r, 0).get();
@@ -82,8 +109,8 @@ async_copy_loop(
 		return;
 	}
 
-	std::atomic<int> cv1(buf_size);
-	std::atomic<int> cv2{-1};
+	alignas(cache_line_size) std::atomic<int> cv1(buf_size);
+	alignas(cache_line_size) std::atomic<int> cv2{-1};
 	auto off = off_t(buf_size);
 	auto buf1_active = false;
 	auto t = std::thread(copy_worker, out, buf1, buf2, buf_size,
@@ -134,12 +161,12 @@ copy_async(const char* src, const char* dst, size_t buf_size)
 
 #if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
 
-static cc::expected<std::tuple<int, int>>
+static cc::errno_expected<std::tuple<int, int>>
 make_pipe()
 {
 	auto pipe = std::array<int, 2>{};
 	if (::pipe(pipe.data()) == -1) {
-		return current_system_error();
+		return cc::current_errno();
 	}
 	return std::make_tuple(pipe[0], pipe[1]);
 }
@@ -161,9 +188,14 @@ splice_loop(
 	auto off = off_t{};
 
 	for (;;) {
+		auto t = trace_begin();
 		auto r = ::splice(in_fd, nullptr, in_pipe, nullptr, buf_size, flags);
+		trace_end(trace_op::splice, off, buf_size, t, r);
 		if (r == -1) { throw current_system_error(); }
+
+		t = trace_begin();
 		auto s = ::splice(out_pipe, nullptr, out_fd, nullptr, buf_size, flags);
+		trace_end(trace_op::splice, off, buf_size, t, s);
 		if (s == -1) { throw current_system_error(); }
 
 		assert(r == s);
@@ -172,6 +204,384 @@ splice_loop(
 	}
 }
 
+static auto
+copy_direct(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = open_direct(src, O_RDONLY | O_NOATIME);
+	auto out = open_direct(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME);
+	// The alignments are powers of two, so the larger is a multiple of the
+	// smaller.
+	auto a = std::max(in.align.offset, out.align.offset);
+	auto bs = (buf_size + a - 1) / a * a;
+	auto buf = allocate_aligned(std::max(in.align.memory, out.align.memory), bs);
+	copy_loop(in.fd, out.fd, buf.get(), bs, out.align.offset);
+	::close(in.fd);
+	::close(out.fd);
+}
+
+static auto
+copy_preallocate(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	preallocate(out, fs);
+	copy_loop(in, out, buf.get(), buf_size);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_mmap_plain(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+
+	auto src_buf = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, in, 0);
+	auto dst_buf = (uint8_t*)::mmap(nullptr, fs, PROT_WRITE, MAP_SHARED, out, 0);
+	std::copy(src_buf, src_buf + fs, dst_buf);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_mmap_nocache(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME | O_DIRECT).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME | O_DIRECT).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+
+	auto src_buf = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, in, 0);
+	auto dst_buf = (uint8_t*)::mmap(nullptr, fs, PROT_WRITE, MAP_SHARED, out, 0);
+	std::copy(src_buf, src_buf + fs, dst_buf);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_mmap_fadvise(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	fadvise_sequential_read(in, fs);
+	preallocate(out, fs);
+
+	auto src_buf = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, in, 0);
+	auto dst_buf = (uint8_t*)::mmap(nullptr, fs, PROT_WRITE, MAP_SHARED, out, 0);
+	std::copy(src_buf, src_buf + fs, dst_buf);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_splice(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+
+	auto in_pipe = int{};
+	auto out_pipe = int{};
+	std::tie(out_pipe, in_pipe) = make_pipe().get();
+	splice_loop(in, out, in_pipe, out_pipe, buf_size, fs);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_splice_preallocate(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+
+	auto in_pipe = int{};
+	auto out_pipe = int{};
+	std::tie(out_pipe, in_pipe) = make_pipe().get();
+	splice_loop(in, out, in_pipe, out_pipe, buf_size, fs);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_splice_fadvise(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	fadvise_sequential_read(in, fs);
+
+	auto in_pipe = int{};
+	auto out_pipe = int{};
+	std::tie(out_pipe, in_pipe) = make_pipe().get();
+	splice_loop(in, out, in_pipe, out_pipe, buf_size, fs);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_splice_preallocate_fadvise(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	fadvise_sequential_read(in, fs);
+	preallocate(out, fs);
+
+	auto in_pipe = int{};
+	auto out_pipe = int{};
+	std::tie(out_pipe, in_pipe) = make_pipe().get();
+	splice_loop(in, out, in_pipe, out_pipe, buf_size, fs);
+	::close(in);
+	::close(out);
+}
+
+static ssize_t
+traced_sendfile(int out, int in, off_t fs)
+{
+	auto t = trace_begin();
+	auto r = ::sendfile(out, in, nullptr, fs);
+	trace_end(trace_op::sendfile, 0, fs, t, r);
+	return r;
+}
+
+static auto
+copy_sendfile(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+
+	if (traced_sendfile(out, in, fs) == -1) {
+		throw current_system_error();
+	}
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_sendfile_preallocate(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+
+	if (traced_sendfile(out, in, fs) == -1) {
+		throw current_system_error();
+	}
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_sendfile_fadvise(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	fadvise_sequential_read(in, fs);
+
+	if (traced_sendfile(out, in, fs) == -1) {
+		throw current_system_error();
+	}
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_sendfile_preallocate_fadvise(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+	fadvise_sequential_read(in, fs);
+
+	if (traced_sendfile(out, in, fs) == -1) {
+		throw current_system_error();
+	}
+	::close(in);
+	::close(out);
+}
+
+/*
+** Copies the file with `copy_file_range`, which lets the file system share the
+** extents (on Btrfs and XFS) or do the copy on the server (on NFS), and
+** otherwise falls back to a splice within the kernel.
+*/
+static void
+copy_file_range_loop(int in, int out, off_t fs)
+{
+	auto off = off_t{0};
+	while (off < fs) {
+		auto t = trace_begin();
+		auto r = ::copy_file_range(in, nullptr, out, nullptr, fs - off, 0);
+		trace_end(trace_op::copy_range, off, fs - off, t, r);
+		if (r == -1) { throw current_system_error(); }
+		if (r == 0) { break; }
+		off += r;
+	}
+}
+
+static auto
+copy_range(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	copy_file_range_loop(in, out, fs);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_range_preallocate(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	preallocate(out, fs);
+	copy_file_range_loop(in, out, fs);
+	::close(in);
+	::close(out);
+}
+
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+
+static auto
+copy_nocache(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	disable_cache(in);
+	disable_cache(out);
+
+	copy_loop(in, out, buf.get(), buf_size);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_rdahead_preallocate(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	enable_rdahead(in);
+
+	//preallocate(out, fs);
+	//if (::fcntl(out, F_NOCACHE, 1) == -1) {
+	//	throw current_system_error();
+	//}
+	//if (::ftruncate(out, fs) == -1) {
+	//	throw current_system_error();
+	//}
+
+	copy_loop(in, out, buf.get(), buf_size);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_rdadvise_preallocate(const char* src, const char* dst, size_t buf_size)
+{
+	auto in = safe_open(src, O_RDONLY).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC).get();
+	auto fs = file_size(in).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	enable_rdadvise(in, fs);
+
+	//preallocate(out, fs);
+	//if (::fcntl(out, F_NOCACHE, 1) == -1) {
+	//	throw current_system_error();
+	//}
+	//if (::ftruncate(out, fs) == -1) {
+	//	throw current_system_error();
+	//}
+
+	copy_loop(in, out, buf.get(), buf_size);
+	::close(in);
+	::close(out);
+}
+
+static auto
+copy_mmap_nocache_plain(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC).get();
+	auto fs = file_size(in).get();
+
+	/*
+	** Strangely, copying is fastest when we use `F_NOCACHE` for reading but
+	** not for writing. I do not know why. The `F_RDAHEAD` and `F_RDADVISE`
+	** flags do not help.
+	*/
+	disable_cache(in);
+	preallocate(out, fs);
+	truncate(out, fs);
+
+	auto src_buf = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, in, 0);
+	auto dst_buf = (uint8_t*)::mmap(nullptr, fs, PROT_WRITE, MAP_SHARED, out, 0);
+	std::copy(src_buf, src_buf + fs, dst_buf);
+}
+
+static auto
+copy_mmap_nocache_nocache(const char* src, const char* dst)
+{
+	auto in = safe_open(src, O_RDONLY).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC).get();
+	auto fs = file_size(in).get();
+
+	disable_cache(in);
+	disable_cache(out);
+	preallocate(out, fs);
+	truncate(out, fs);
+
+	auto src_buf = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, in, 0);
+	auto dst_buf = (uint8_t*)::mmap(nullptr, fs, PROT_WRITE, MAP_SHARED, out, 0);
+	std::copy(src_buf, src_buf + fs, dst_buf);
+}
+
 #endif
 
+static void
+register_copy_engines(engine_registry& r)
+{
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	r.copy("copy_plain", copy_plain);
+	r.copy("copy_async", copy_async, false);
+	r.copy("copy_direct", copy_direct);
+	r.copy("copy_preallocate", copy_preallocate);
+	r.copy_whole("copy_mmap_plain", copy_mmap_plain);
+	r.copy_whole("copy_mmap_nocache", copy_mmap_nocache);
+	r.copy_whole("copy_mmap_fadvise", copy_mmap_fadvise);
+	r.copy("copy_splice", copy_splice);
+	r.copy("copy_splice_preallocate", copy_splice_preallocate);
+	r.copy("copy_splice_preallocate_fadvise", copy_splice_preallocate_fadvise);
+	r.copy("copy_splice_fadvise", copy_splice_fadvise);
+	r.copy_whole("copy_sendfile", copy_sendfile);
+	r.copy_whole("copy_sendfile_preallocate", copy_sendfile_preallocate);
+	r.copy_whole("copy_sendfile_preallocate_fadvise", copy_sendfile_preallocate_fadvise);
+	r.copy_whole("copy_sendfile_fadvise", copy_sendfile_fadvise);
+	r.copy_whole("copy_range", copy_range);
+	r.copy_whole("copy_range_preallocate", copy_range_preallocate);
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	r.copy("copy_plain", copy_plain);
+	r.copy("copy_async", copy_async, false);
+	r.copy("copy_nocache", copy_nocache);
+	r.copy("copy_rdahead_preallocate", copy_rdahead_preallocate);
+	r.copy("copy_rdadvise_preallocate", copy_rdadvise_preallocate);
+	r.copy_whole("copy_mmap_nocache_plain", copy_mmap_nocache_plain);
+	r.copy_whole("copy_mmap_nocache_nocache", copy_mmap_nocache_nocache);
+#endif
+}
+
 #endif
@@ -0,0 +1,370 @@
+/*
+** File Name:	coro_io.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** An awaitable IO layer built on C++20 coroutines, backed by the native AIO
+** context in `kernel_aio.hpp`. A coroutine that returns `io_task` can
+** `co_await async_read(fd, buf, n, off)` or `co_await async_write(...)`; the
+** request is queued, the coroutine is suspended, and the `io_loop` that runs it
+** resumes it with the result once the request completes. Many such coroutines
+** (streams) can run on one thread, so that each one is written as a plain loop
+** that issues one request at a time, while the loop keeps a request in flight
+** for each of them.
+**
+** The loop submits the requests made by the coroutines that it resumed in one
+** call to `io_submit`, and handles every completion returned by one call to
+** `io_getevents`, as the loops in `kernel_aio.hpp` do. The `coro_*` engines are
+** therefore the `kaio_*` engines with the state of each request kept in a
+** coroutine frame, so that comparing the two at the same queue depth shows the
+** cost of the abstraction on the hot path.
+**
+** This header requires C++20, and is only used by `coro_benchmark`.
+*/
+
+#ifndef ZAC5754FA_2E1C_4BB3_A8FB_64410EFD089A
+#define ZAC5754FA_2E1C_4BB3_A8FB_64410EFD089A
+
+#include <algorithm>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <consumer.hpp>
+#include <io_common.hpp>
+#include <kernel_aio.hpp>
+#include <registry.hpp>
+#include <trace.hpp>
+#include <write_common.hpp>
+
+/*
+** A coroutine run by an `io_loop`. It is suspended when it is created, and is
+** started by `io_loop::run`. An exception that escapes it is rethrown by
+** `io_loop::run` once every coroutine has finished.
+*/
+class io_task
+{
+public:
+	struct promise_type
+	{
+		std::exception_ptr error;
+
+		io_task get_return_object() noexcept
+		{ return io_task{handle::from_promise(*this)}; }
+
+		std::suspend_always initial_suspend() const noexcept
+		{ return {}; }
+
+		std::suspend_always final_suspend() const noexcept
+		{ return {}; }
+
+		void return_void() const noexcept {}
+
+		void unhandled_exception() noexcept
+		{ error = std::current_exception(); }
+	};
+private:
+	using handle = std::coroutine_handle<promise_type>;
+	handle m_handle;
+
+	explicit io_task(handle h) noexcept : m_handle{h} {}
+public:
+	io_task(io_task&& rhs) noexcept :
+	m_handle{std::exchange(rhs.m_handle, nullptr)} {}
+
+	io_task& operator=(io_task&& rhs) noexcept
+	{
+		std::swap(m_handle, rhs.m_handle);
+		return *this;
+	}
+
+	~io_task()
+	{ if (m_handle) { m_handle.destroy(); } }
+
+	bool done() const noexcept
+	{ return m_handle.done(); }
+
+	void resume() const
+	{ m_handle.resume(); }
+
+	void rethrow() const
+	{
+		if (m_handle.promise().error) {
+			std::rethrow_exception(m_handle.promise().error);
+		}
+	}
+};
+
+class io_op;
+
+/*
+** Runs a set of `io_task` coroutines on the calling thread, keeping at most
+** `depth` requests in flight. Each coroutine has at most one request in flight,
+** so there should be at most `depth` of them.
+*/
+class io_loop
+{
+	aio_context m_ctx;
+	unsigned m_depth;
+	std::vector<iocb*> m_batch;
+	std::vector<io_task> m_tasks;
+	unsigned m_pending{0};
+public:
+	explicit io_loop(unsigned depth) : m_ctx{depth}, m_depth{depth}
+	{ m_batch.reserve(depth); }
+
+	io_loop(const io_loop&) = delete;
+	io_loop& operator=(const io_loop&) = delete;
+
+	void spawn(io_task t)
+	{
+		assert(m_tasks.size() < m_depth);
+		m_tasks.push_back(std::move(t));
+	}
+
+	/*
+	** Queues `cb` to be submitted once the coroutines that are running
+	** have been suspended.
+	*/
+	void enqueue(iocb* cb)
+	{
+		m_batch.push_back(cb);
+		++m_pending;
+	}
+
+	/*
+	** Runs the coroutines until all of them have finished.
+	*/
+	void run();
+};
+
+// The loop that is running on this thread, to which `async_read` and
+// `async_write` submit their requests.
+static thread_local io_loop* current_io_loop = nullptr;
+
+/*
+** The awaitable returned by `async_read` and `async_write`. It lives in the
+** frame of the coroutine that awaits it, so the loop finds it from the
+** completion through `aio_data`.
+*/
+class io_op
+{
+	friend class io_loop;
+
+	iocb m_cb;
+	uint64_t m_time{0};
+	int64_t m_result{0};
+	std::coroutine_handle<> m_handle;
+public:
+	io_op(uint16_t op, int fd, uint8_t* buf, size_t n, off_t off) noexcept
+	{ prepare_iocb(m_cb, op, fd, buf, n, off, 0); }
+
+	bool await_ready() const noexcept
+	{ return false; }
+
+	void await_suspend(std::coroutine_handle<> h)
+	{
+		assert(current_io_loop != nullptr);
+		m_handle = h;
+		m_cb.aio_data = uint64_t(uintptr_t(this));
+		m_time = trace_begin();
+		current_io_loop->enqueue(&m_cb);
+	}
+
+	/*
+	** Returns the number of bytes transferred, or throws if the request
+	** failed.
+	*/
+	size_t await_resume() const
+	{
+		if (m_result < 0) {
+			throw std::system_error{int(-m_result), std::system_category()};
+		}
+		return size_t(m_result);
+	}
+};
+
+inline void
+io_loop::run()
+{
+	auto prev = std::exchange(current_io_loop, this);
+	try {
+		for (const auto& t : m_tasks) { t.resume(); }
+
+		while (m_pending != 0) {
+			m_ctx.submit(m_batch.data(), m_batch.size());
+			m_batch.clear();
+
+			auto n = m_ctx.wait();
+			for (auto j = size_t{0}; j != n; ++j) {
+				const auto& e = m_ctx.events()[j];
+				auto op = (io_op*)uintptr_t(e.data);
+				--m_pending;
+				trace_iocb(op->m_cb, e, op->m_time);
+				op->m_result = e.res;
+				op->m_handle.resume();
+			}
+		}
+	}
+	catch (...) {
+		current_io_loop = prev;
+		throw;
+	}
+	current_io_loop = prev;
+
+	for (const auto& t : m_tasks) {
+		assert(t.done());
+		t.rethrow();
+	}
+	m_tasks.clear();
+}
+
+static io_op
+async_read(int fd, uint8_t* buf, size_t n, off_t off) noexcept
+{ return io_op{IOCB_CMD_PREAD, fd, buf, n, off}; }
+
+static io_op
+async_write(int fd, uint8_t* buf, size_t n, off_t off) noexcept
+{ return io_op{IOCB_CMD_PWRITE, fd, buf, n, off}; }
+
+/*
+** Reads blocks of `buf_size` bytes into `buf` at the offset `next`, which is
+** shared with the other streams, until it reaches `fs`.
+*/
+static io_task
+read_stream(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	off_t fs,
+	off_t& next,
+	off_t& count
+)
+{
+	while (next < fs) {
+		auto off = next;
+		next += buf_size;
+		auto n = co_await async_read(fd, buf, buf_size, off);
+		count += consume(buf, n);
+	}
+}
+
+/*
+** Writes blocks of at most `buf_size` bytes from `buf` at the offset `next`,
+** which is shared with the other streams, until it reaches `count`. The last
+** block is padded to a multiple of `align`.
+*/
+static io_task
+write_stream(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	size_t count,
+	size_t align,
+	size_t& next
+)
+{
+	while (next < count) {
+		auto off = next;
+		auto n = std::min(buf_size, count - off);
+		auto m = (n + align - 1) / align * align;
+		next += n;
+		auto r = co_await async_write(fd, buf, m, off_t(off));
+		assert(r == m);
+		(void)r;
+	}
+}
+
+static off_t
+coro_read_loop(int fd, uint8_t* buf, size_t buf_size, unsigned depth, off_t fs)
+{
+	auto next = off_t{0};
+	auto count = off_t{0};
+	io_loop loop{depth};
+	for (auto i = 0u; i != depth; ++i) {
+		loop.spawn(read_stream(fd, buf + i * buf_size, buf_size, fs, next,
+			count));
+	}
+	loop.run();
+	return count;
+}
+
+static void
+coro_write_loop(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	size_t count,
+	size_t align = 1
+)
+{
+	auto next = size_t{0};
+	io_loop loop{depth};
+	for (auto i = 0u; i != depth; ++i) {
+		loop.spawn(write_stream(fd, buf + i * buf_size, buf_size, count,
+			align, next));
+	}
+	loop.run();
+	if (count % align != 0) { truncate(fd, off_t(count)); }
+}
+
+static auto
+coro_read_plain(const char* path, size_t buf_size, unsigned depth)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	auto count = coro_read_loop(fd, buf.get(), buf_size, depth, fs);
+	::close(fd);
+	return count;
+}
+
+static auto
+coro_read_direct(const char* path, size_t buf_size, unsigned depth)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto fs = file_size(f.fd).get();
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	auto count = coro_read_loop(f.fd, buf.get(), bs, depth, fs);
+	::close(f.fd);
+	return count;
+}
+
+static auto
+coro_write_plain(const char* path, size_t buf_size, size_t count, unsigned depth)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	fill_buffer(buf.get(), depth * buf_size);
+	coro_write_loop(fd, buf.get(), buf_size, depth, count);
+	::close(fd);
+}
+
+static auto
+coro_write_direct(const char* path, size_t buf_size, size_t count, unsigned depth)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	fill_buffer(buf.get(), depth * bs);
+	coro_write_loop(f.fd, buf.get(), bs, depth, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+register_coro_engines(engine_registry& r)
+{
+	r.read_queued("coro_read_plain", coro_read_plain);
+	r.read_queued("coro_read_direct", coro_read_direct);
+	r.write_queued("coro_write_plain", coro_write_plain);
+	r.write_queued("coro_write_direct", coro_write_direct);
+}
+
+#endif
@@ -0,0 +1,474 @@
+/*
+** File Name:	driver.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Command-line driver that runs a selection of the registered engines over a
+** set of block sizes and files. This makes it possible to run a focused sweep
+** over a few engines instead of the full grid.
+*/
+
+#ifndef Z6C13239B_2CF3_437B_A6E1_6AC7D75437AB
+#define Z6C13239B_2CF3_437B_A6E1_6AC7D75437AB
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <ccbase/format.hpp>
+
+#include <configuration.hpp>
+#include <consumer.hpp>
+#include <environment.hpp>
+#include <options.hpp>
+#include <placement.hpp>
+#include <registry.hpp>
+#include <read_common.hpp>
+#include <write_common.hpp>
+#include <copy_common.hpp>
+#include <test.hpp>
+#include <trace.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <uring.hpp>
+#endif
+
+// Block sizes used when none are given on the command line.
+static const auto default_block_sizes = std::vector<size_t>{
+	4 << 10, 8 << 10, 12 << 10, 16 << 10, 24 << 10, 32 << 10, 40 << 10,
+	48 << 10, 56 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20,
+	64 << 20, 256 << 20
+};
+
+// Queue depths used when none are given on the command line.
+static const auto default_queue_depths = std::vector<unsigned>{1, 2, 4, 8, 16, 32};
+
+struct driver_options
+{
+	// Glob patterns for the names of the engines to run. If this is empty,
+	// then the engines that are enabled by default are run.
+	std::vector<std::string> engines;
+	// The kinds of engines to run. If this is empty, all kinds are run.
+	std::vector<engine_kind> kinds;
+	std::vector<size_t> block_sizes{default_block_sizes};
+	// Queue depths used by the queued engines.
+	std::vector<unsigned> queue_depths{default_queue_depths};
+	// Placements of the buffers and threads of the double-buffer engines.
+	// Every selected engine is run once for each placement.
+	std::vector<placement> placements{placement{}};
+	// Sizes of the files produced by the write engines.
+	std::vector<size_t> file_sizes;
+	// Files consumed by the read and copy engines.
+	std::vector<const char*> inputs;
+	// If not empty, the read engines are instead run on this many of the
+	// inputs at once, and the write and copy engines are not run.
+	std::vector<unsigned> streams;
+	// Stages run by the read engines on each block. Every selected read
+	// engine is run once for each stage.
+	std::vector<consumer_stage> consumers{consumer_stage{}};
+	// File produced by the write and copy engines.
+	const char* output{"data/test.bin"};
+	// If not null, a trace of every IO is written to this file.
+	const char* trace{nullptr};
+	bool list{false};
+};
+
+static engine_registry
+make_registry()
+{
+	auto r = engine_registry{};
+	register_read_engines(r);
+	register_write_engines(r);
+	register_copy_engines(r);
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	register_uring_engines(r);
+#endif
+	return r;
+}
+
+static bool
+selected(const driver_options& o, engine_kind k)
+{
+	return o.kinds.empty() ||
+		std::find(o.kinds.begin(), o.kinds.end(), k) != o.kinds.end();
+}
+
+/*
+** Runs each selected engine of kind `k` once for every block size (or just
+** once, if the engine is not blocked) and every queue depth (if the engine is
+** queued) on a file of the given size, or on `streams` files at once if it is
+** nonzero. When tracing, each configuration is given its own engine ID, and the
+** IO done between configurations is traced under the ID `setup`.
+*/
+template <class Test>
+static void
+run_kind(
+	const std::vector<const engine*>& es,
+	const driver_options& o,
+	engine_kind k,
+	off_t file_size,
+	const Test& test,
+	unsigned streams = 0
+)
+{
+	auto run = [&](const engine& e, size_t bs, unsigned qd) {
+		if (o.trace != nullptr) {
+			auto l = config_label(e.name.c_str(), bs, qd);
+			if (streams != 0) {
+				l += " " + std::to_string(streams) + " streams";
+			}
+			l += context_label();
+			l += ", " + format_size(file_size);
+			current_trace_engine = io_trace.engine_id(l);
+		}
+		test(e, bs, qd);
+		current_trace_engine = 0;
+	};
+
+	for (const auto& e : es) {
+		if (e->kind != k) { continue; }
+		if (!e->blocked) {
+			run(*e, 0, 0);
+			continue;
+		}
+		for (const auto& bs : o.block_sizes) {
+			if (off_t(bs) > file_size) { continue; }
+			if (!e->queued) {
+				run(*e, bs, 0);
+				continue;
+			}
+			for (const auto& qd : o.queue_depths) { run(*e, bs, qd); }
+		}
+	}
+}
+
+/*
+** Runs the selected read engines on the first `n` inputs at once, for each
+** number of streams `n`. Block sizes larger than the smallest of these files
+** are skipped.
+*/
+static void
+run_streams(const std::vector<const engine*>& es, const driver_options& o)
+{
+	auto counts = std::vector<off_t>{};
+	auto sizes = std::vector<off_t>{};
+	for (const auto& path : o.inputs) {
+		auto fd = safe_open(path, O_RDONLY).get();
+		sizes.push_back(file_size(fd).get());
+		safe_close(fd).get();
+		counts.push_back(check(path));
+	}
+	purge_cache().get();
+
+	for (const auto& n : o.streams) {
+		if (n > o.inputs.size()) {
+			cc::errln("Warning: skipping $ streams, since only $ files "
+				"were given.", n, o.inputs.size());
+			continue;
+		}
+		auto c = std::vector<off_t>(counts.begin(), counts.begin() + n);
+		auto fs = std::vector<off_t>(sizes.begin(), sizes.begin() + n);
+		auto min_size = *std::min_element(fs.begin(), fs.end());
+
+		run_kind(es, o, engine_kind::read, min_size,
+			[&](const engine& e, size_t bs, unsigned qd) {
+				test_streams([&](size_t i) {
+					auto j = engine_job{o.inputs[i], nullptr, bs, 0, qd};
+					return e.run(j);
+				}, e.name.c_str(), bs, qd, c, fs);
+			}, n);
+	}
+}
+
+/*
+** Runs the selected engines with the current placement. The read engines are
+** run once for each consumer stage.
+*/
+static void
+run_placement(const std::vector<const engine*>& es, const driver_options& o)
+{
+	for (const auto& c : o.consumers) {
+		current_consumer = c;
+		if (!o.streams.empty()) {
+			run_streams(es, o);
+			continue;
+		}
+		if (!selected(o, engine_kind::read)) { break; }
+
+		for (const auto& path : o.inputs) {
+			auto fd = safe_open(path, O_RDONLY).get();
+			auto fs = file_size(fd).get();
+			safe_close(fd).get();
+
+			auto count = check(path);
+			purge_cache().get();
+
+			run_kind(es, o, engine_kind::read, fs,
+				[&](const engine& e, size_t bs, unsigned qd) {
+					auto j = engine_job{path, nullptr, bs, 0, qd};
+					test_read([&]() { return e.run(j); },
+						e.name.c_str(), bs, qd, count, fs);
+				});
+		}
+	}
+	current_consumer = consumer_stage{};
+	if (!o.streams.empty()) { return; }
+
+	if (selected(o, engine_kind::write)) {
+		for (const auto& count : o.file_sizes) {
+			// Dummy write to create the file.
+			write_plain(o.output, 4096, count);
+
+			run_kind(es, o, engine_kind::write, count,
+				[&](const engine& e, size_t bs, unsigned qd) {
+					auto j = engine_job{nullptr, o.output, bs, count, qd};
+					test_write([&]() { e.run(j); }, e.name.c_str(),
+						bs, qd, count);
+				});
+		}
+	}
+
+	if (selected(o, engine_kind::copy)) {
+		for (const auto& path : o.inputs) {
+			auto fd = safe_open(path, O_RDONLY).get();
+			auto fs = file_size(fd).get();
+			safe_close(fd).get();
+
+			run_kind(es, o, engine_kind::copy, fs,
+				[&](const engine& e, size_t bs, unsigned qd) {
+					auto j = engine_job{path, o.output, bs, 0, qd};
+					test_write([&]() { e.run(j); }, e.name.c_str(),
+						bs, qd, fs);
+				});
+		}
+	}
+}
+
+static void
+run_engines(const engine_registry& r, const driver_options& o)
+{
+	auto es = r.select(o.engines);
+	auto paths = o.inputs;
+	if (selected(o, engine_kind::write) || selected(o, engine_kind::copy)) {
+		paths.push_back(o.output);
+	}
+	begin_report(capture_environment(paths),
+		o.streams.empty() ? result_kind::io : result_kind::streams);
+
+	if (o.trace != nullptr) {
+		io_trace.start(o.trace);
+		current_trace_engine = io_trace.engine_id("setup");
+	}
+
+	for (const auto& p : o.placements) {
+		current_placement = p;
+		run_placement(es, o);
+	}
+	current_placement = placement{};
+	end_report();
+
+	if (o.trace != nullptr) {
+		auto r = io_trace.finish();
+		cc::errln("Wrote $ trace records to \"$\".", r.first, o.trace);
+		if (r.second != 0) {
+			cc::errln("Warning: dropped $ trace records.", r.second);
+		}
+	}
+}
+
+static void
+print_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] [file ...]\n"
+"\n"
+"Runs the selected engines on each file (read and copy engines), and for each\n"
+"file size (write engines).\n"
+"\n"
+"Options:\n"
+"  -e, --engines GLOB[,GLOB...]  Engines to run (default: all enabled engines).\n"
+"  -k, --kinds KIND[,KIND...]    Kinds of engines to run: read, write, copy.\n"
+"  -b, --block-sizes LIST        Block sizes, e.g. 4K,64K,1M or 4K-1M or 4K-64K+4K.\n"
+"  -q, --queue-depths LIST       Queue depths for queued engines, e.g. 1-32.\n"
+"                                For read_window, the window in blocks; for\n"
+"                                write_records_*, the records per batch.\n"
+"  -P, --placements SPEC[,SPEC]  NUMA nodes of the buffers, IO thread, and consumer\n"
+"                                thread of the double-buffer engines, as B:I:C\n"
+"                                (e.g. 0:0:1 or *:1:*), or \"sweep\" for all. The\n"
+"                                threads can instead be pinned to CPUs that are\n"
+"                                SMT siblings (smt), share an L3 cache (l3), or\n"
+"                                are on different sockets (socket); \"topology\"\n"
+"                                runs all three.\n"
+"  -N, --streams LIST            Instead, run the read engines on N of the files\n"
+"                                at once, one thread per file, for each N.\n"
+"  -C, --consumers LIST          Work done by the read engines on each block:\n"
+"                                count (default), crc32c, hash, copy, or burn:N\n"
+"                                for about N cycles per byte.\n"
+"  -s, --file-sizes LIST         Sizes of the files written by write engines.\n"
+"  -o, --output PATH             File written by write and copy engines.\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"  -T, --trace PATH              Write a trace of every IO to PATH; see\n"
+"                                analyze_trace.\n"
+"  -n, --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --warmup N                Number of untimed warm-up trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"      --ci-width FRACTION       Target width of the CI relative to the median.\n"
+"  -l, --list                    List the engines that would be run and exit.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+/*
+** Parses the command-line arguments into `o` and `sampler`. Returns false if
+** the program should exit.
+*/
+static bool
+parse_options(int argc, char** argv, driver_options& o)
+{
+	for (auto i = 1; i < argc; ++i) {
+		auto a = argv[i];
+		auto value = [&]() { return option_value(argc, argv, i); };
+
+		if (is_option(a, "-h", "--help")) {
+			print_usage(argv[0]);
+			return false;
+		}
+		else if (is_option(a, "-l", "--list")) {
+			o.list = true;
+		}
+		else if (is_option(a, "-e", "--engines")) {
+			auto g = split(value(), ',');
+			o.engines.insert(o.engines.end(), g.begin(), g.end());
+		}
+		else if (is_option(a, "-k", "--kinds")) {
+			for (const auto& k : split(value(), ',')) {
+				o.kinds.push_back(parse_kind(k));
+			}
+		}
+		else if (is_option(a, "-b", "--block-sizes")) {
+			o.block_sizes = parse_size_list(value());
+		}
+		else if (is_option(a, "-q", "--queue-depths")) {
+			o.queue_depths = parse_depth_list(value());
+		}
+		else if (is_option(a, "-P", "--placements")) {
+			o.placements = parse_placements(value());
+		}
+		else if (is_option(a, "-N", "--streams")) {
+			for (const auto& n : split(value(), ',')) {
+				o.streams.push_back(parse_count(n.c_str()));
+			}
+		}
+		else if (is_option(a, "-C", "--consumers")) {
+			o.consumers.clear();
+			for (const auto& c : split(value(), ',')) {
+				o.consumers.push_back(parse_consumer(c));
+			}
+		}
+		else if (is_option(a, "-s", "--file-sizes")) {
+			o.file_sizes = parse_size_list(value());
+		}
+		else if (is_option(a, "-o", "--output")) {
+			o.output = value();
+		}
+		else if (is_option(a, "-f", "--format")) {
+			auto f = std::string{value()};
+			if      (f == "csv")  { output_format = report_format::csv; }
+			else if (f == "json") { output_format = report_format::json; }
+			else {
+				throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+			}
+		}
+		else if (is_option(a, "-T", "--trace")) {
+			o.trace = value();
+		}
+		else if (is_option(a, "-n", "--trials")) {
+			sampler.min_trials = sampler.max_trials = parse_count(value());
+		}
+		else if (is_option(a, nullptr, "--min-trials")) {
+			sampler.min_trials = parse_count(value());
+		}
+		else if (is_option(a, nullptr, "--max-trials")) {
+			sampler.max_trials = parse_count(value());
+		}
+		else if (is_option(a, nullptr, "--warmup")) {
+			auto s = value();
+			sampler.warmup_trials = std::strcmp(s, "0") == 0 ? 0 : parse_count(s);
+		}
+		else if (is_option(a, nullptr, "--budget")) {
+			sampler.time_budget = 1000 * parse_real(value());
+		}
+		else if (is_option(a, nullptr, "--ci-width")) {
+			sampler.target_ci_width = parse_real(value());
+		}
+		else if (a[0] == '-' && a[1] != '\0') {
+			throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+		}
+		else {
+			o.inputs.push_back(a);
+		}
+	}
+
+	if (sampler.min_trials > sampler.max_trials) {
+		throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+	}
+	if (!o.streams.empty()) {
+		for (const auto& k : o.kinds) {
+			if (k != engine_kind::read) {
+				throw std::invalid_argument{"--streams only applies to read engines"};
+			}
+		}
+		o.kinds = {engine_kind::read};
+	}
+	return true;
+}
+
+/*
+** Runs the driver on the engines in `r`, so that a program can add engines of
+** its own to those of `make_registry`.
+*/
+static int
+driver_main(int argc, char** argv, const engine_registry& r)
+{
+	auto o = driver_options{};
+	try {
+		if (!parse_options(argc, argv, o)) { return EXIT_SUCCESS; }
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	if (o.list) {
+		for (const auto& e : r.select(o.engines)) {
+			if (!selected(o, e->kind)) { continue; }
+			cc::println(e->name);
+		}
+		return EXIT_SUCCESS;
+	}
+
+	try {
+		run_engines(r, o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+static int
+driver_main(int argc, char** argv)
+{ return driver_main(argc, argv, make_registry()); }
+
+#endif
@@ -0,0 +1,273 @@
+/*
+** File Name:	environment.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Captures the properties of the system that affect the results of the
+** benchmarks, so that results taken on different machines (or before and after
+** a kernel or filesystem upgrade) can be told apart. Properties that cannot be
+** determined are reported as "unknown".
+*/
+
+#ifndef Z10FFD284_9724_44B5_996E_D71E0FA1EB52
+#define Z10FFD284_9724_44B5_996E_D71E0FA1EB52
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ccbase/platform.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <sys/stat.h>
+	#include <sys/sysmacros.h>
+	#include <sys/utsname.h>
+	#include <unistd.h>
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	#include <sys/mount.h>
+	#include <sys/param.h>
+	#include <sys/stat.h>
+	#include <sys/sysctl.h>
+	#include <sys/utsname.h>
+	#include <unistd.h>
+#else
+	#error "Unsupported kernel."
+#endif
+
+// An ordered list of properties, in the order in which they are reported.
+using property_list = std::vector<std::pair<std::string, std::string>>;
+
+struct environment
+{
+	// Properties of the machine and the operating system.
+	property_list system;
+	// Properties of the filesystem and device backing each file used by
+	// the benchmarks.
+	std::vector<property_list> files;
+};
+
+static std::string
+read_line(const char* path)
+{
+	auto s = std::string{};
+	auto is = std::ifstream{path};
+	if (!is || !std::getline(is, s) || s.empty()) { return "unknown"; }
+	return s;
+}
+
+/*
+** Returns the value of the first line of the form `key : value` in the file at
+** `path`, as used by `/proc/cpuinfo` and `/proc/meminfo`.
+*/
+static std::string
+read_field(const char* path, const char* key)
+{
+	auto s = std::string{};
+	auto is = std::ifstream{path};
+	auto n = std::strlen(key);
+
+	while (std::getline(is, s)) {
+		if (s.compare(0, n, key) != 0) { continue; }
+		auto i = s.find(':', n);
+		if (i == std::string::npos) { continue; }
+		i = s.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos) { return "unknown"; }
+		return s.substr(i);
+	}
+	return "unknown";
+}
+
+/*
+** Returns the path itself if it exists, and otherwise the directory that would
+** contain it.
+*/
+static std::string
+existing_path(const char* path)
+{
+	using stat = struct stat;
+	auto st = stat{};
+	if (::stat(path, &st) == 0) { return path; }
+
+	auto s = std::string{path};
+	auto i = s.rfind('/');
+	if (i == std::string::npos) { return "."; }
+	if (i == 0) { return "/"; }
+	return s.substr(0, i);
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+/*
+** Returns the contents of the file `name` in the sysfs directory of the block
+** device `dev`. If the device is a partition, then the file is looked up in the
+** directory of the parent device.
+*/
+static std::string
+read_block_attribute(dev_t dev, const char* name)
+{
+	auto base = "/sys/dev/block/" + std::to_string(major(dev)) + ":" +
+		std::to_string(minor(dev));
+	auto s = read_line((base + "/" + name).c_str());
+	if (s != "unknown") { return s; }
+	return read_line((base + "/../" + name).c_str());
+}
+
+/*
+** Extracts the active scheduler from a line of the form `mq-deadline [none]`.
+*/
+static std::string
+active_scheduler(const std::string& s)
+{
+	auto f = s.find('[');
+	auto l = s.find(']');
+	if (f == std::string::npos || l == std::string::npos || l < f) { return s; }
+	return s.substr(f + 1, l - f - 1);
+}
+
+static property_list
+file_environment(const char* path)
+{
+	using stat = struct stat;
+	auto r = property_list{{"path", path}};
+	auto st = stat{};
+	if (::stat(existing_path(path).c_str(), &st) == -1) { return r; }
+
+	// Each line of `/proc/self/mountinfo` has the form
+	//   id parent major:minor root mount-point options [tags] - type source super-options
+	// We use the last entry for the device, since later mounts hide
+	// earlier ones.
+	auto id = std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev));
+	auto mount_point = std::string{"unknown"};
+	auto options = std::string{"unknown"};
+	auto type = std::string{"unknown"};
+	auto source = std::string{"unknown"};
+	auto is = std::ifstream{"/proc/self/mountinfo"};
+	auto s = std::string{};
+
+	while (std::getline(is, s)) {
+		auto f = std::vector<std::string>{};
+		auto i = size_t{0};
+		while (i < s.size()) {
+			auto j = s.find(' ', i);
+			if (j == std::string::npos) { j = s.size(); }
+			f.push_back(s.substr(i, j - i));
+			i = j + 1;
+		}
+		if (f.size() < 10 || f[2] != id) { continue; }
+
+		auto k = size_t{6};
+		while (k < f.size() && f[k] != "-") { ++k; }
+		if (k + 2 >= f.size()) { continue; }
+
+		mount_point = f[4];
+		options = f[5];
+		if (k + 3 < f.size()) { options += "," + f[k + 3]; }
+		type = f[k + 1];
+		source = f[k + 2];
+	}
+
+	r.emplace_back("filesystem", type);
+	r.emplace_back("mount_point", mount_point);
+	r.emplace_back("mount_options", options);
+	r.emplace_back("device", source);
+	r.emplace_back("device_model", read_block_attribute(st.st_dev, "device/model"));
+	r.emplace_back("rotational", read_block_attribute(st.st_dev, "queue/rotational"));
+	r.emplace_back("scheduler", active_scheduler(
+		read_block_attribute(st.st_dev, "queue/scheduler")));
+	r.emplace_back("read_ahead_kb", read_block_attribute(st.st_dev, "queue/read_ahead_kb"));
+	return r;
+}
+
+static property_list
+system_environment()
+{
+	using utsname = struct utsname;
+	auto u = utsname{};
+	::uname(&u);
+
+	// An empty list means that no CPUs are isolated.
+	auto isolated = read_line("/sys/devices/system/cpu/isolated");
+	if (isolated == "unknown") { isolated = "none"; }
+
+	return {
+		{"hostname",  u.nodename},
+		{"kernel",    std::string{u.sysname} + " " + u.release},
+		{"kernel_version", u.version},
+		{"machine",   u.machine},
+		{"cpu",       read_field("/proc/cpuinfo", "model name")},
+		{"cpus",      std::to_string(::sysconf(_SC_NPROCESSORS_ONLN))},
+		{"memory",    read_field("/proc/meminfo", "MemTotal")},
+		{"governor",  read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor")},
+		{"dirty_ratio", read_line("/proc/sys/vm/dirty_ratio")},
+		{"dirty_background_ratio", read_line("/proc/sys/vm/dirty_background_ratio")},
+		{"isolated_cpus", isolated}
+	};
+}
+
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+
+static std::string
+sysctl_string(const char* name)
+{
+	auto buf = std::array<char, 256>{};
+	auto n = buf.size();
+	if (::sysctlbyname(name, buf.data(), &n, nullptr, 0) == -1) {
+		return "unknown";
+	}
+	return buf.data();
+}
+
+static property_list
+file_environment(const char* path)
+{
+	using statfs_type = struct statfs;
+	auto r = property_list{{"path", path}};
+	auto st = statfs_type{};
+	if (::statfs(existing_path(path).c_str(), &st) == -1) { return r; }
+
+	auto options = std::string{st.f_flags & MNT_RDONLY ? "ro" : "rw"};
+	if (st.f_flags & MNT_NOATIME) { options += ",noatime"; }
+	if (st.f_flags & MNT_JOURNALED) { options += ",journaled"; }
+
+	r.emplace_back("filesystem", st.f_fstypename);
+	r.emplace_back("mount_point", st.f_mntonname);
+	r.emplace_back("mount_options", options);
+	r.emplace_back("device", st.f_mntfromname);
+	return r;
+}
+
+static property_list
+system_environment()
+{
+	using utsname = struct utsname;
+	auto u = utsname{};
+	::uname(&u);
+
+	return {
+		{"hostname",  u.nodename},
+		{"kernel",    std::string{u.sysname} + " " + u.release},
+		{"kernel_version", u.version},
+		{"machine",   u.machine},
+		{"cpu",       sysctl_string("machdep.cpu.brand_string")},
+		{"cpus",      std::to_string(::sysconf(_SC_NPROCESSORS_ONLN))},
+		{"memory",    std::to_string(::sysconf(_SC_PHYS_PAGES) *
+			::sysconf(_SC_PAGESIZE) / 1024) + " kB"}
+	};
+}
+
+#endif
+
+static environment
+capture_environment(const std::vector<const char*>& paths)
+{
+	auto e = environment{system_environment(), {}};
+	for (const auto& p : paths) {
+		e.files.push_back(file_environment(p));
+	}
+	return e;
+}
+
+#endif
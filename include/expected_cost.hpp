@@ -0,0 +1,404 @@
+/*
+** File Name:	expected_cost.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures the cost per call of returning the result of `full_read` through
+** `cc::expected` (which holds a `std::exception_ptr` on error) and through
+** `cc::errno_expected` (which holds an `int`), against that of checking the
+** return value of `pread` directly. At small block sizes, the loops in the
+** engines call `full_read` millions of times.
+**
+** Each variant is run both on a file (which is read once beforehand, so that
+** it is in the page cache) and on a buffer in memory, for which `pread` is
+** replaced by `memcpy`. The latter leaves out the system call, and so shows the
+** overhead of the wrapper itself. The variants are kept out of line, so that
+** each one returns its result as a real function would. The cost of the error
+** path is measured by reading from a null buffer.
+**
+** Before anything is timed, `check_errno_expected` makes sure that both paths
+** of `cc::errno_expected` behave as documented; `--check` runs only these
+** checks.
+*/
+
+#ifndef Z4E0D4167_52AC_4B63_94CE_5DEADA8EE045
+#define Z4E0D4167_52AC_4B63_94CE_5DEADA8EE045
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ratio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <ccbase/error.hpp>
+#include <ccbase/format.hpp>
+#include <ccbase/platform.hpp>
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <test.hpp>
+
+struct expected_options
+{
+	std::vector<size_t> block_sizes{4096};
+	// Number of calls per trial.
+	size_t calls{1000000};
+	// If not null, the file on which the variants that call `pread` are
+	// run.
+	const char* path{nullptr};
+	// Whether to only check the behavior of `cc::errno_expected`.
+	bool check{false};
+};
+
+/*
+** Stands in for `pread` on a file whose contents are the buffer `src` of `n`
+** bytes, without making a system call. A null `src` behaves like a bad file
+** descriptor.
+*/
+struct memory_source
+{
+	const uint8_t* src;
+	size_t n;
+
+	ssize_t operator()(uint8_t* buf, size_t count, off_t off) const noexcept
+	{
+		if (src == nullptr) {
+			errno = EBADF;
+			return -1;
+		}
+		count = std::min(count, n - size_t(off));
+		std::memcpy(buf, src + off, count);
+		return ssize_t(count);
+	}
+};
+
+struct file_source
+{
+	int fd;
+
+	ssize_t operator()(uint8_t* buf, size_t count, off_t off) const noexcept
+	{ return ::pread(fd, buf, count, off); }
+};
+
+/*
+** The loop of `full_read`, returning errors as `cc::expected` did before
+** `cc::errno_expected` was introduced. The exception is wrapped in a
+** `std::exception_ptr` here, since the constructor of `cc::expected` that
+** takes the exception itself can throw, and is declared `noexcept`.
+*/
+template <class Source>
+CC_NEVER_INLINE static cc::expected<ssize_t>
+exception_full_read(const Source& s, uint8_t* buf, size_t count, off_t offset)
+{
+	auto c = size_t{0};
+	do {
+		auto r = s(buf + c, count - c, offset + c);
+		if (r > 0) {
+			c += r;
+		}
+		else if (r == 0) {
+			return ssize_t(c);
+		}
+		else {
+			if (errno == EINTR) { continue; }
+			return std::make_exception_ptr(current_system_error());
+		}
+	}
+	while (c < count);
+	return ssize_t(c);
+}
+
+/*
+** The loop of `full_read` as it is in `io_common.hpp`.
+*/
+template <class Source>
+CC_NEVER_INLINE static cc::errno_expected<ssize_t>
+errno_full_read(const Source& s, uint8_t* buf, size_t count, off_t offset)
+{
+	auto c = size_t{0};
+	do {
+		auto r = s(buf + c, count - c, offset + c);
+		if (r > 0) {
+			c += r;
+		}
+		else if (r == 0) {
+			return c;
+		}
+		else {
+			if (errno == EINTR) { continue; }
+			return cc::current_errno();
+		}
+	}
+	while (c < count);
+	return c;
+}
+
+template <class Source>
+CC_NEVER_INLINE static ssize_t
+raw_read(const Source& s, uint8_t* buf, size_t count, off_t offset)
+{ return s(buf, count, offset); }
+
+/*
+** Times `calls` calls to `f(off)`, cycling through the blocks of a source of
+** `n` bytes, and reports the rate of calls under `name`.
+*/
+template <class Function>
+static void
+time_calls(
+	const std::string& name,
+	size_t bs,
+	size_t n,
+	size_t calls,
+	const Function& f
+)
+{
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	auto blocks = std::max(n / bs, size_t{1});
+	auto sink = size_t{0};
+	auto s = sample_trials(
+		[&]() {
+			auto t1 = high_resolution_clock::now();
+			for (auto i = size_t{0}; i != calls; ++i) {
+				sink += f(off_t((i % blocks) * bs));
+			}
+			auto t2 = high_resolution_clock::now();
+			return duration_cast<milliseconds>(t2 - t1).count();
+		},
+		[]() {}
+	);
+	if (sink == 1) { std::abort(); }
+	report_rate(name.c_str(), bs, 1, calls, calls, s);
+}
+
+/*
+** Runs the three variants on the source `src`, which holds `n` bytes.
+*/
+template <class Source>
+static void
+time_variants(
+	const char* what,
+	const Source& src,
+	size_t n,
+	size_t bs,
+	size_t calls
+)
+{
+	auto buf = allocate_aligned(4096, bs);
+	auto p = buf.get();
+
+	time_calls(std::string{"raw "} + what, bs, n, calls, [&](off_t off) {
+		auto r = raw_read(src, p, bs, off);
+		if (r == -1) { throw current_system_error(); }
+		return size_t(r);
+	});
+	time_calls(std::string{"expected "} + what, bs, n, calls, [&](off_t off) {
+		return size_t(exception_full_read(src, p, bs, off).get());
+	});
+	time_calls(std::string{"errno_expected "} + what, bs, n, calls, [&](off_t off) {
+		return size_t(errno_full_read(src, p, bs, off).get());
+	});
+}
+
+/*
+** Checks the value and error paths of `cc::errno_expected`, both as returned
+** by `errno_full_read` and by the helpers in `io_common.hpp`, and throws a
+** `std::runtime_error` describing the first one that fails.
+*/
+static void
+check_errno_expected()
+{
+	auto check = [](bool c, const char* what) {
+		if (!c) { throw std::runtime_error{what}; }
+	};
+
+	auto n = size_t{8192};
+	auto mem = allocate_aligned(4096, n);
+	for (auto i = size_t{0}; i != n; ++i) { mem[i] = uint8_t(i % 251); }
+	auto buf = allocate_aligned(4096, n);
+
+	// A full read, and a read cut short by the end of the source.
+	auto r1 = errno_full_read(memory_source{mem.get(), n}, buf.get(), 4096, 4096);
+	check(r1.valid() && r1.code() == 0 && !r1.error(),
+		"a successful read is not valid");
+	check(r1.get() == 4096, "a successful read returned the wrong count");
+	check(std::memcmp(buf.get(), mem.get() + 4096, 4096) == 0,
+		"a successful read returned the wrong data");
+	auto r2 = errno_full_read(memory_source{mem.get(), n}, buf.get(), 4096, 6144);
+	check(r2.valid() && r2.get() == 2048, "a short read returned the wrong count");
+
+	// A failed read keeps `errno`, and `get` throws it.
+	auto r3 = errno_full_read(memory_source{nullptr, n}, buf.get(), 4096, 0);
+	check(!r3.valid() && r3.code() == EBADF, "a failed read has the wrong code");
+	check(r3.error() == std::errc::bad_file_descriptor,
+		"a failed read has the wrong error");
+	auto thrown = false;
+	try { r3.get(); }
+	catch (const std::system_error& e) {
+		thrown = e.code().value() == EBADF;
+	}
+	check(thrown, "get() did not throw the code of a failed read");
+
+	// The same, through the system calls.
+	auto r4 = full_read(-1, buf.get(), 4096, 0);
+	check(!r4.valid() && r4.code() == EBADF, "full_read on a bad descriptor is valid");
+	auto r5 = safe_close(-1);
+	check(!r5.valid() && r5.code() == EBADF, "safe_close on a bad descriptor is valid");
+}
+
+static void
+run_expected(const expected_options& o)
+{
+	for (const auto& bs : o.block_sizes) {
+		// Large enough that the copies are not all from the L1 cache.
+		auto n = std::max(bs, size_t{1} << 20);
+		auto mem = allocate_aligned(4096, n);
+		std::memset(mem.get(), 1, n);
+		time_variants("memory", memory_source{mem.get(), n}, n, bs, o.calls);
+
+		// The error path, on which `cc::expected` allocates an
+		// exception for each call.
+		auto bad = memory_source{nullptr, n};
+		auto buf = allocate_aligned(4096, bs);
+		time_calls("expected error", bs, n, o.calls, [&](off_t off) {
+			return size_t(exception_full_read(bad, buf.get(), bs, off).valid());
+		});
+		time_calls("errno_expected error", bs, n, o.calls, [&](off_t off) {
+			return size_t(errno_full_read(bad, buf.get(), bs, off).valid());
+		});
+
+		if (o.path == nullptr) { continue; }
+		auto fd = safe_open(o.path, O_RDONLY).get();
+		auto fs = size_t(file_size(fd).get());
+		if (fs < bs) {
+			safe_close(fd).get();
+			continue;
+		}
+		// Bring the file into the page cache.
+		for (auto off = size_t{0}; off + bs <= fs; off += bs) {
+			full_read(fd, buf.get(), bs, off).get();
+		}
+		time_variants("file", file_source{fd}, fs, bs, o.calls);
+		safe_close(fd).get();
+	}
+}
+
+static void
+print_expected_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] [file]\n"
+"\n"
+"Measures the cost per call of returning the result of full_read through\n"
+"cc::expected and cc::errno_expected, on a buffer in memory and, if given, on\n"
+"a file in the page cache.\n"
+"\n"
+"Options:\n"
+"  -b, --block-sizes LIST        Block sizes (default: 4K).\n"
+"  -c, --calls N                 Calls per trial (default: 1M).\n"
+"      --check                   Only check the behavior of cc::errno_expected.\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"      --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+expected_main(int argc, char** argv)
+{
+	auto o = expected_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_expected_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-b", "--block-sizes")) {
+				o.block_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-c", "--calls")) {
+				o.calls = parse_size(value());
+			}
+			else if (is_option(a, nullptr, "--check")) {
+				o.check = true;
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, nullptr, "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else if (o.path != nullptr) {
+				throw std::invalid_argument{"more than one file given"};
+			}
+			else {
+				o.path = a;
+			}
+		}
+
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	try {
+		check_errno_expected();
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: cc::errno_expected check failed: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	if (o.check) { return EXIT_SUCCESS; }
+
+	auto paths = std::vector<const char*>{};
+	if (o.path != nullptr) { paths.push_back(o.path); }
+	begin_report(capture_environment(paths), result_kind::metadata);
+	try {
+		run_expected(o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	end_report();
+	return EXIT_SUCCESS;
+}
+
+#endif
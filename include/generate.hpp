@@ -0,0 +1,373 @@
+/*
+** File Name:	generate.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Generates the test files used by the benchmarks. The file is divided into
+** blocks that are filled and written by a pool of threads, so that files that
+** are much larger than main memory can be generated at close to the write
+** bandwidth of the device. The contents of each block only depend on the seed
+** and the index of the block, so the output does not depend on the number of
+** threads.
+*/
+
+#ifndef ZB40E239D_B27D_4F12_9B8D_7B889CA9A38F
+#define ZB40E239D_B27D_4F12_9B8D_7B889CA9A38F
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <ccbase/format.hpp>
+
+#include <configuration.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+
+enum class content
+{
+	// Uniformly random bytes.
+	random,
+	// Random bytes in which `needle` occurs with a fixed density.
+	needles,
+	zeros,
+	// Pages that are partially random and partially zero.
+	compressible
+};
+
+struct generator_options
+{
+	content kind{content::random};
+	// Fraction of the bytes that are equal to `needle` when `kind` is
+	// `content::needles`.
+	double needle_density{1.0 / 4096};
+	// Approximate compression ratio when `kind` is `content::compressible`.
+	double compress_ratio{2};
+	// Amount of data filled and written at a time by each thread. This must
+	// be a multiple of the direct IO alignment of the file when `direct` is
+	// set.
+	size_t block_size{4 << 20};
+	unsigned threads{std::max(1u, std::thread::hardware_concurrency())};
+	uint64_t seed{0};
+	// Whether to allocate the extents of the file before writing it.
+	bool preallocate{false};
+	// Whether to bypass the page cache.
+	bool direct{true};
+};
+
+static uint64_t
+splitmix64(uint64_t& x)
+{
+	auto z = (x += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+/*
+** The xoshiro256** generator by Blackman and Vigna. It produces eight bytes
+** per step, which is several times faster than drawing bytes from
+** `std::mt19937`.
+*/
+class xoshiro256
+{
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int k)
+	{ return (x << k) | (x >> (64 - k)); }
+public:
+	explicit xoshiro256(uint64_t seed) noexcept
+	{
+		for (auto& x : s) { x = splitmix64(seed); }
+	}
+
+	uint64_t operator()() noexcept
+	{
+		auto r = rotl(s[1] * 5, 7) * 9;
+		auto t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return r;
+	}
+};
+
+static void
+fill_random(uint8_t* p, size_t n, xoshiro256& gen)
+{
+	auto i = size_t{0};
+	for (; i + 8 <= n; i += 8) {
+		auto x = gen();
+		std::memcpy(p + i, &x, 8);
+	}
+	if (i != n) {
+		auto x = gen();
+		std::memcpy(p + i, &x, n - i);
+	}
+}
+
+/*
+** Fills the `index`th block of the file, and returns the number of occurrences
+** of `needle` in it.
+*/
+static off_t
+fill_block(uint8_t* p, size_t n, uint64_t index, const generator_options& o)
+{
+	static constexpr auto page_size = size_t{4096};
+	auto seed = o.seed ^ (index * 0xD1B54A32D192ED03);
+	auto gen = xoshiro256{seed};
+
+	switch (o.kind) {
+	case content::random:
+		fill_random(p, n, gen);
+		break;
+	case content::needles: {
+		fill_random(p, n, gen);
+		std::replace(p, p + n, needle, uint8_t(needle - 1));
+
+		// Divide the block into `k` equal segments, and put one needle
+		// at a random position in each one. This gives exactly `k`
+		// needles that are spread evenly throughout the block.
+		auto k = size_t(std::llround(o.needle_density * n));
+		for (auto i = size_t{0}; i != k; ++i) {
+			auto f = i * n / k;
+			auto l = (i + 1) * n / k;
+			p[f + gen() % (l - f)] = needle;
+		}
+		return k;
+	}
+	case content::zeros:
+		std::memset(p, 0, n);
+		return needle == 0 ? n : 0;
+	case content::compressible: {
+		auto m = size_t(page_size / std::max(o.compress_ratio, 1.0));
+		for (auto i = size_t{0}; i < n; i += page_size) {
+			auto c = std::min(page_size, n - i);
+			auto r = std::min(m, c);
+			fill_random(p + i, r, gen);
+			std::memset(p + i + r, 0, c - r);
+		}
+		break;
+	}
+	}
+	return std::count(p, p + n, needle);
+}
+
+/*
+** Writes `count` bytes to the file at `path`, and returns the number of
+** occurrences of `needle` in the file.
+*/
+static off_t
+generate_file(const char* path, size_t count, const generator_options& o)
+{
+	// The file is truncated once the block size has been checked against
+	// the alignment, so that an existing file is left alone on error.
+	auto flags = O_WRONLY | O_CREAT;
+	auto align = direct_alignment{};
+	align.offset = 1;
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	auto fd = -1;
+	if (o.direct) {
+		auto f = open_direct(path, flags);
+		fd = f.fd;
+		align = f.align;
+	}
+	else {
+		fd = safe_open(path, flags).get();
+	}
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	auto fd = safe_open(path, flags).get();
+	if (o.direct) {
+		disable_cache(fd);
+		align.offset = 4096;
+	}
+#endif
+	if (o.block_size % align.offset != 0) {
+		::close(fd);
+		throw std::invalid_argument{cc::format("block size must be a multiple "
+			"of $ unless --buffered is given", align.offset)};
+	}
+	truncate(fd, off_t{0});
+	// Writes that are not a multiple of the alignment can only occur at
+	// the end of the file, and are issued through a second descriptor
+	// that does not bypass the cache.
+	auto tail_fd = safe_open(path, O_WRONLY).get();
+
+	if (o.preallocate && count > 0) { preallocate(fd, count); }
+
+	auto blocks = (count + o.block_size - 1) / o.block_size;
+	std::atomic<uint64_t> next{0};
+	std::atomic<off_t> total{0};
+	auto errors = std::vector<std::exception_ptr>(o.threads);
+
+	auto work = [&](unsigned t) {
+		try {
+			auto buf = allocate_aligned(align.memory, o.block_size);
+			auto sum = off_t{0};
+			for (;;) {
+				auto i = next.fetch_add(1, std::memory_order_relaxed);
+				if (i >= blocks) { break; }
+
+				auto off = off_t(i * o.block_size);
+				auto n = std::min(o.block_size, count - size_t(off));
+				sum += fill_block(buf.get(), n, i, o);
+
+				auto m = n - n % align.offset;
+				if (m > 0) { full_write(fd, buf.get(), m, off).get(); }
+				if (m < n) { full_write(tail_fd, buf.get() + m, n - m, off + m).get(); }
+			}
+			total.fetch_add(sum, std::memory_order_relaxed);
+		}
+		catch (...) {
+			errors[t] = std::current_exception();
+		}
+	};
+
+	auto ts = std::vector<std::thread>{};
+	for (auto t = 1u; t < o.threads; ++t) { ts.emplace_back(work, t); }
+	work(0);
+	for (auto& t : ts) { t.join(); }
+
+	for (const auto& e : errors) {
+		if (e) { std::rethrow_exception(e); }
+	}
+
+	// Preallocation may have extended the file beyond `count` bytes.
+	truncate(fd, count);
+	safe_close(tail_fd).get();
+	safe_close(fd).get();
+	return total.load();
+}
+
+static void
+print_generate_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] path size\n"
+"\n"
+"Creates a test file of the given size (e.g. 512M or 100G).\n"
+"\n"
+"Options:\n"
+"  -c, --content KIND        One of random, needles, zeros, compressible.\n"
+"  -d, --density FRACTION    Fraction of bytes equal to the needle (needles).\n"
+"  -r, --ratio RATIO         Approximate compression ratio (compressible).\n"
+"  -b, --block-size SIZE     Amount written at a time by each thread.\n"
+"  -t, --threads N           Number of threads.\n"
+"  -s, --seed N              Seed for the random number generator.\n"
+"  -p, --preallocate         Allocate the extents of the file before writing.\n"
+"      --buffered            Write through the page cache.\n"
+"  -h, --help                Print this message.\n",
+	prog);
+}
+
+static int
+generate_main(int argc, char** argv)
+{
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	auto o = generator_options{};
+	auto args = std::vector<const char*>{};
+	auto count = size_t{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_generate_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-c", "--content")) {
+				auto v = std::string{value()};
+				if      (v == "random")       { o.kind = content::random; }
+				else if (v == "needles")      { o.kind = content::needles; }
+				else if (v == "zeros")        { o.kind = content::zeros; }
+				else if (v == "compressible") { o.kind = content::compressible; }
+				else {
+					throw std::invalid_argument{cc::format("invalid content \"$\"", v)};
+				}
+			}
+			else if (is_option(a, "-d", "--density")) {
+				o.needle_density = parse_real(value());
+				if (o.needle_density > 1) {
+					throw std::invalid_argument{"density must be at most one"};
+				}
+			}
+			else if (is_option(a, "-r", "--ratio")) {
+				o.compress_ratio = parse_real(value());
+			}
+			else if (is_option(a, "-b", "--block-size")) {
+				o.block_size = parse_size(value());
+				if (o.block_size == 0) {
+					throw std::invalid_argument{"block size must be positive"};
+				}
+			}
+			else if (is_option(a, "-t", "--threads")) {
+				o.threads = parse_count(value());
+			}
+			else if (is_option(a, "-s", "--seed")) {
+				o.seed = parse_size(value());
+			}
+			else if (is_option(a, "-p", "--preallocate")) {
+				o.preallocate = true;
+			}
+			else if (is_option(a, nullptr, "--buffered")) {
+				o.direct = false;
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else {
+				args.push_back(a);
+			}
+		}
+
+		if (args.size() < 2) {
+			throw std::invalid_argument{"too few arguments"};
+		}
+		else if (args.size() > 2) {
+			throw std::invalid_argument{"too many arguments"};
+		}
+		count = parse_size(args[1]);
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	auto t1 = steady_clock::now();
+	auto needles = off_t{};
+	try {
+		needles = generate_file(args[0], count, o);
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to write \"$\": $.", args[0], e.what());
+		return EXIT_FAILURE;
+	}
+	auto t2 = steady_clock::now();
+	auto ms = duration_cast<milliseconds>(t2 - t1).count();
+
+	cc::println("Wrote $ bytes to \"$\" in $ ms ($ MB/s); $ needles.",
+		count, args[0], ms, count / 1048576.0 / (ms / 1000), needles);
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+** File Name:	glob.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Compares the rate at which `cc::glob_matcher` and `cc::compiled_glob` match
+** file names against glob patterns, both for single patterns and for a set of
+** patterns (`cc::glob_set`, against trying each `cc::glob_matcher` in turn).
+** The names are generated in memory, in the style of an object store
+** (`obj_1f3a09c2_k.jpg`), so that only the cost of matching is measured.
+*/
+
+#ifndef ZC826ADB6_1745_44DA_B55E_32ED324D5540
+#define ZC826ADB6_1745_44DA_B55E_32ED324D5540
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <ratio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/filesystem/compiled_glob.hpp>
+#include <ccbase/filesystem/glob_matcher.hpp>
+
+#include <configuration.hpp>
+#include <environment.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <test.hpp>
+
+struct glob_options
+{
+	size_t names{1000000};
+	std::vector<std::string> patterns{
+		"*.jpg", "obj_0*", "*_k*.txt", "obj_????????_*.json", "*[0123]?.log",
+		"*tmp*"
+	};
+	uint64_t seed{0};
+};
+
+/*
+** A list of null-terminated names, stored contiguously.
+*/
+struct name_list
+{
+	std::vector<char> chars;
+	std::vector<size_t> offsets;
+
+	const char* operator[](size_t i) const
+	{ return chars.data() + offsets[i]; }
+
+	size_t size() const
+	{ return offsets.size(); }
+};
+
+static name_list
+make_names(size_t n, uint64_t seed)
+{
+	static constexpr const char* exts[] = {
+		"jpg", "png", "txt", "dat", "json", "tmp", "log", "bin"
+	};
+	auto gen = std::mt19937_64{seed};
+	auto r = name_list{};
+	auto buf = std::array<char, 64>{};
+
+	for (auto i = size_t{0}; i != n; ++i) {
+		auto x = gen();
+		auto len = std::snprintf(buf.data(), buf.size(), "obj_%08x_%c.%s",
+			unsigned(x), char('a' + (x >> 32) % 26), exts[(x >> 40) % 8]);
+		r.offsets.push_back(r.chars.size());
+		r.chars.insert(r.chars.end(), buf.data(), buf.data() + len + 1);
+	}
+	return r;
+}
+
+/*
+** Times how long it takes for `f` to be called on every name, and reports
+** the result under `name`. The number of names for which `f` returns true is
+** returned.
+*/
+template <class Function>
+static size_t
+time_matcher(const char* name, const name_list& names, const Function& f)
+{
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	auto count = size_t{0};
+	auto s = sample_trials(
+		[&]() {
+			auto c = size_t{0};
+			auto t1 = high_resolution_clock::now();
+			for (auto i = size_t{0}; i != names.size(); ++i) {
+				c += f(names[i]);
+			}
+			auto t2 = high_resolution_clock::now();
+			count = c;
+			return duration_cast<milliseconds>(t2 - t1).count();
+		},
+		[]() {}
+	);
+	report_rate(name, 0, 1, names.size(), names.size(), s);
+	return count;
+}
+
+/*
+** Times each matcher on the same names, and returns false if any two matchers
+** disagree on the number of names that match a pattern. All of the patterns
+** are timed even after a disagreement, so that every one of them is reported.
+*/
+static bool
+run_globs(const glob_options& o)
+{
+	auto names = make_names(o.names, o.seed);
+	auto ok = true;
+
+	auto check = [&](const std::string& what, size_t a, size_t b) {
+		if (a != b) {
+			cc::errln("Error: for $, glob_matcher matched $ names, and "
+				"compiled_glob matched $.", what, a, b);
+			ok = false;
+		}
+	};
+
+	for (const auto& p : o.patterns) {
+		auto m1 = cc::glob_matcher{p.c_str()};
+		auto m2 = cc::compiled_glob{p.c_str()};
+		auto a = time_matcher(("glob_matcher " + p).c_str(), names,
+			[&](const char* s) { return m1(s); });
+		auto b = time_matcher(("compiled_glob " + p).c_str(), names,
+			[&](const char* s) { return m2(s); });
+		check("\"" + p + "\"", a, b);
+	}
+
+	auto ms = std::vector<cc::glob_matcher>{};
+	for (const auto& p : o.patterns) { ms.emplace_back(p.c_str()); }
+	auto set = cc::glob_set{o.patterns};
+
+	auto a = time_matcher("glob_matcher any", names, [&](const char* s) {
+		for (const auto& m : ms) {
+			if (m(s)) { return true; }
+		}
+		return false;
+	});
+	auto b = time_matcher("glob_set", names, [&](const char* s) { return set(s); });
+	check("the set of patterns", a, b);
+	return ok;
+}
+
+static void
+print_glob_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options]\n"
+"\n"
+"Measures the rate at which file names are matched against glob patterns by\n"
+"cc::glob_matcher and cc::compiled_glob.\n"
+"\n"
+"Options:\n"
+"  -n, --names N                 Number of names to generate (default: 1M).\n"
+"  -p, --patterns GLOB[,GLOB...] Patterns to match.\n"
+"  -s, --seed N                  Seed for the names.\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"      --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+glob_main(int argc, char** argv)
+{
+	auto o = glob_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_glob_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-n", "--names")) {
+				o.names = parse_size(value());
+			}
+			else if (is_option(a, "-p", "--patterns")) {
+				o.patterns = split(value(), ',');
+				for (const auto& p : o.patterns) {
+					if (p.empty()) {
+						throw std::invalid_argument{"empty pattern"};
+					}
+				}
+			}
+			else if (is_option(a, "-s", "--seed")) {
+				o.seed = parse_size(value());
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, nullptr, "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+		}
+
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+		for (const auto& p : o.patterns) { cc::compiled_glob{p.c_str()}; }
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	begin_report(capture_environment({}), result_kind::metadata);
+	auto ok = run_globs(o);
+	end_report();
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -8,14 +8,22 @@
 #ifndef Z3BD34381_B22E_4963_8FB9_A5B89E9AFB9A
 #define Z3BD34381_B22E_4963_8FB9_A5B89E9AFB9A
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <memory>
 #include <system_error>
 #include <ccbase/error.hpp>
+#include <ccbase/platform.hpp>
+#include <trace.hpp>
 
 #if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX || \
     PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
 	#include <sys/types.h>
 	#include <sys/stat.h>
 	#include <sys/mman.h>
+	#include <sys/uio.h>
 	#include <unistd.h>
 	#include <fcntl.h>
 	#include <aio.h>
@@ -23,16 +31,33 @@
 	#error "Unsupported kernel."
 #endif
 
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <sys/ioctl.h>
+	#include <sys/statfs.h>
+	#include <sys/sysmacros.h>
+
+	#ifndef BLKSSZGET
+		#define BLKSSZGET _IO(0x12, 104)
+	#endif
+#endif
+
 static std::system_error
 current_system_error()
 { return std::system_error{errno, std::system_category()}; }
 
-static cc::expected<ssize_t>
+/*
+** The helpers below are called once per block in the IO loops, so they return
+** `cc::errno_expected`, which is as cheap to return as the value itself.
+*/
+
+static cc::errno_expected<ssize_t>
 full_read(int fd, uint8_t* buf, size_t count, off_t offset)
 {
 	auto c = size_t{0};
 	do {
+		auto t = trace_begin();
 		auto r = ::pread(fd, buf + c, count - c, offset + c);
+		trace_end(trace_op::read, offset + c, count - c, t, r);
 		if (r > 0) {
 			c += r;
 		}
@@ -41,19 +66,21 @@ full_read(int fd, uint8_t* buf, size_t count, off_t offset)
 		}
 		else {
 			if (errno == EINTR) { continue; }
-			return current_system_error();
+			return cc::current_errno();
 		}
 	}
 	while (c < count);
 	return c;
 }
 
-static cc::expected<ssize_t>
+static cc::errno_expected<ssize_t>
 full_write(int fd, uint8_t* buf, size_t count, off_t offset)
 {
 	auto c = size_t{0};
 	do {
+		auto t = trace_begin();
 		auto r = ::pwrite(fd, buf + c, count - c, offset + c);
+		trace_end(trace_op::write, offset + c, count - c, t, r);
 		if (r > 0) {
 			c += r;
 		}
@@ -62,14 +89,54 @@ full_write(int fd, uint8_t* buf, size_t count, off_t offset)
 		}
 		else {
 			if (errno == EINTR) { continue; }
-			return current_system_error();
+			return cc::current_errno();
 		}
 	}
 	while (c < count);
 	return c;
 }
 
-static cc::expected<int>
+/*
+** Writes the buffers described by the `n` entries of `iov` contiguously at
+** `offset`, in calls of at most `IOV_MAX` entries. After a short write, the
+** entries are adjusted to describe what remains, so their contents are
+** unspecified afterwards.
+*/
+static cc::errno_expected<ssize_t>
+full_pwritev(int fd, iovec* iov, int n, off_t offset)
+{
+	auto c = size_t{0};
+	while (n > 0) {
+		auto m = std::min(n, IOV_MAX);
+		auto len = size_t{0};
+		for (auto i = 0; i != m; ++i) { len += iov[i].iov_len; }
+
+		auto t = trace_begin();
+		auto r = ::pwritev(fd, iov, m, offset + c);
+		trace_end(trace_op::write, offset + c, len, t, r);
+		if (r == -1) {
+			if (errno == EINTR) { continue; }
+			return cc::current_errno();
+		}
+		if (r == 0 && len != 0) { return c; }
+
+		// Skip the entries that were written completely.
+		c += r;
+		auto k = size_t(r);
+		while (n > 0 && k >= iov->iov_len) {
+			k -= iov->iov_len;
+			++iov;
+			--n;
+		}
+		if (k > 0) {
+			iov->iov_base = (uint8_t*)iov->iov_base + k;
+			iov->iov_len -= k;
+		}
+	}
+	return c;
+}
+
+static cc::errno_expected<int>
 safe_open(const char* path, int flags)
 {
 	auto r = int{};
@@ -78,31 +145,31 @@ safe_open(const char* path, int flags)
 	}
 	while (r == -1 && errno == EINTR);
 
-	if (r == -1) { return current_system_error(); }
+	if (r == -1) { return cc::current_errno(); }
 	return r;
 }
 
-static cc::expected<void>
+static cc::errno_expected<void>
 safe_close(int fd)
 {
 	auto r = ::close(fd);
 	if (r == 0) { return true; }
-	if (errno != EINTR) { return current_system_error(); }
+	if (errno != EINTR) { return cc::current_errno(); }
 
 	for (;;) {
 		r = ::close(fd);
 		if (errno == EBADF) { return true; }
-		if (errno != EINTR) { return current_system_error(); }
+		if (errno != EINTR) { return cc::current_errno(); }
 	}
 }
 
-static cc::expected<off_t>
+static cc::errno_expected<off_t>
 file_size(int fd)
 {
 	using stat = struct stat;
 	auto st = stat{};
 	auto r = ::fstat(fd, &st);
-	if (r == -1) { return current_system_error(); }
+	if (r == -1) { return cc::current_errno(); }
 	return st.st_size;
 }
 
@@ -135,6 +202,31 @@ truncate(int fd, off_t fs)
 	}
 }
 
+/*
+** Cancels the POSIX AIO requests `cbs[0..n)` that may still be in flight (null
+** entries are skipped), and waits for each of them to finish. This must be done
+** before the control blocks or buffers of the requests are freed, e.g. when an
+** exception unwinds past them, since glibc's helper threads write into them
+** until the requests complete.
+*/
+static void
+drain_aio(struct aiocb* const* cbs, size_t n) noexcept
+{
+	auto e = errno;
+	for (auto i = size_t{0}; i != n; ++i) {
+		if (cbs[i] != nullptr) { ::aio_cancel(cbs[i]->aio_fildes, cbs[i]); }
+	}
+	for (auto i = size_t{0}; i != n; ++i) {
+		if (cbs[i] == nullptr) { continue; }
+		const struct aiocb* l[] = {cbs[i]};
+		while (::aio_error(cbs[i]) == EINPROGRESS) {
+			::aio_suspend(l, 1, nullptr);
+		}
+		::aio_return(cbs[i]);
+	}
+	errno = e;
+}
+
 #if PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
 
 static inline cc::expected<void>
@@ -226,6 +318,105 @@ truncate(int fd, size_t count)
 	}
 }
 
+/*
+** The alignment required for IO on a file opened with `O_DIRECT`.
+*/
+struct direct_alignment
+{
+	// Alignment of the buffers. This is at least the page size.
+	size_t memory{4096};
+	// Alignment of the file offsets and lengths. This is zero if the file
+	// does not support `O_DIRECT`, and one if it was opened without it.
+	size_t offset{4096};
+
+	size_t round(size_t n) const noexcept
+	{ return (n + offset - 1) / offset * offset; }
+};
+
+/*
+** Determines the alignment required for direct IO on `fd`. This is reported
+** by `statx` with `STATX_DIOALIGN` on Linux 6.1 and later. Otherwise, the
+** logical sector size of the device that holds the file is used (which can
+** only be queried by a user who can open the device), and failing that the
+** block size of the file system.
+*/
+static direct_alignment
+direct_io_alignment(int fd)
+{
+	auto a = direct_alignment{};
+
+#ifdef STATX_DIOALIGN
+	using statx_type = struct statx;
+	auto sx = statx_type{};
+	if (
+		::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &sx) == 0 &&
+		(sx.stx_mask & STATX_DIOALIGN) != 0
+	) {
+		a.memory = std::max(a.memory, size_t(sx.stx_dio_mem_align));
+		a.offset = sx.stx_dio_offset_align;
+		return a;
+	}
+#endif
+
+	using stat = struct stat;
+	auto st = stat{};
+	if (::fstat(fd, &st) == -1) { throw current_system_error(); }
+
+	auto ss = int{};
+	if (S_ISBLK(st.st_mode)) {
+		if (::ioctl(fd, BLKSSZGET, &ss) == 0 && ss > 0) { a.offset = ss; }
+		return a;
+	}
+
+	char dev[64];
+	std::snprintf(dev, sizeof(dev), "/dev/block/%u:%u", major(st.st_dev),
+		minor(st.st_dev));
+	auto bd = ::open(dev, O_RDONLY);
+	if (bd != -1) {
+		auto r = ::ioctl(bd, BLKSSZGET, &ss);
+		::close(bd);
+		if (r == 0 && ss > 0) {
+			a.offset = ss;
+			return a;
+		}
+	}
+
+	using statfs_type = struct statfs;
+	auto fs = statfs_type{};
+	if (::fstatfs(fd, &fs) == 0 && fs.f_bsize > 0) { a.offset = fs.f_bsize; }
+	return a;
+}
+
+struct direct_file
+{
+	int fd;
+	direct_alignment align;
+};
+
+/*
+** Opens `path` with `O_DIRECT` in addition to `flags`, and determines the
+** alignment required for its IOs. If the file system does not support
+** `O_DIRECT`, then the file is opened without it, so that the direct engines
+** can still be run (through the page cache) on any file.
+*/
+static direct_file
+open_direct(const char* path, int flags)
+{
+	auto fd = safe_open(path, flags | O_DIRECT);
+	if (fd.valid()) {
+		auto a = direct_io_alignment(fd.get());
+		if (a.offset != 0) { return {fd.get(), a}; }
+		::close(fd.get());
+	}
+	else if (fd.code() != EINVAL) {
+		fd.get();
+	}
+
+	auto a = direct_alignment{};
+	a.offset = 1;
+	return {safe_open(path, flags).get(), a};
+}
+
 #endif
 
 #endif
@@ -0,0 +1,320 @@
+/*
+** File Name:	kernel_aio.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Linux native AIO (`io_setup`, `io_submit`, and `io_getevents`), called
+** through `syscall` so that `libaio` is not needed. Unlike POSIX AIO, which
+** glibc implements with a pool of threads that call `pread`, the requests are
+** queued in the kernel. They only complete asynchronously for files opened with
+** `O_DIRECT`; for other files, `io_submit` does the IO before it returns.
+**
+** The loops below keep a fixed number of requests in flight, and reissue each
+** request as soon as it completes. Completions are handled in the order in
+** which they are reported, which may differ from the order of the offsets. They
+** are the baselines against which `coro_io.hpp` is compared.
+*/
+
+#ifndef Z4B49FE0D_8DD8_4764_8743_CEEA7723FFAD
+#define Z4B49FE0D_8DD8_4764_8743_CEEA7723FFAD
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <system_error>
+#include <vector>
+#include <linux/aio_abi.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <configuration.hpp>
+#include <consumer.hpp>
+#include <io_common.hpp>
+#include <registry.hpp>
+#include <trace.hpp>
+#include <write_common.hpp>
+
+/*
+** Owns an AIO context that can hold `depth` requests, along with room for as
+** many completions.
+*/
+class aio_context
+{
+	aio_context_t m_ctx{0};
+	std::vector<io_event> m_events;
+public:
+	explicit aio_context(unsigned depth) : m_events(depth)
+	{
+		if (::syscall(SYS_io_setup, depth, &m_ctx) == -1) {
+			throw current_system_error();
+		}
+	}
+
+	aio_context(const aio_context&) = delete;
+	aio_context& operator=(const aio_context&) = delete;
+
+	~aio_context()
+	{ ::syscall(SYS_io_destroy, m_ctx); }
+
+	const io_event* events() const noexcept
+	{ return m_events.data(); }
+
+	/*
+	** Submits the `n` requests at `cbs`.
+	*/
+	void submit(iocb** cbs, size_t n)
+	{
+		while (n != 0) {
+			auto r = ::syscall(SYS_io_submit, m_ctx, long(n), cbs);
+			if (r == -1) {
+				if (errno == EINTR || errno == EAGAIN) { continue; }
+				throw current_system_error();
+			}
+			cbs += r;
+			n -= r;
+		}
+	}
+
+	/*
+	** Waits for at least one request to complete, and returns the number
+	** of completions, which are then given by `events`.
+	*/
+	size_t wait()
+	{ return get_events(1, nullptr); }
+
+	/*
+	** Like `wait`, but returns zero instead of waiting if no request has
+	** completed.
+	*/
+	size_t reap()
+	{
+		auto t = timespec{0, 0};
+		return get_events(0, &t);
+	}
+private:
+	size_t get_events(long min, timespec* t)
+	{
+		for (;;) {
+			auto r = ::syscall(SYS_io_getevents, m_ctx, min,
+				long(m_events.size()), m_events.data(), t);
+			if (r == -1) {
+				if (errno == EINTR) { continue; }
+				throw current_system_error();
+			}
+			return size_t(r);
+		}
+	}
+};
+
+static void
+prepare_iocb(
+	iocb& cb,
+	uint16_t op,
+	int fd,
+	uint8_t* buf,
+	size_t n,
+	off_t off,
+	uint64_t data
+)
+{
+	cb = iocb{};
+	cb.aio_data = data;
+	cb.aio_lio_opcode = op;
+	cb.aio_fildes = uint32_t(fd);
+	cb.aio_buf = uint64_t(uintptr_t(buf));
+	cb.aio_nbytes = n;
+	cb.aio_offset = off;
+}
+
+/*
+** Records the completion `e` of `cb`, which was issued at `t`, in the trace.
+*/
+static void
+trace_iocb(const iocb& cb, const io_event& e, uint64_t t)
+{
+	auto op = cb.aio_lio_opcode == IOCB_CMD_PREAD ?
+		trace_op::aio_read : trace_op::write;
+	if (e.res < 0) { errno = int(-e.res); }
+	trace_end(op, cb.aio_offset, cb.aio_nbytes, t, e.res < 0 ? -1 : e.res);
+}
+
+/*
+** Throws if the request that completed with `e` failed.
+*/
+static void
+check_event(const io_event& e)
+{
+	if (e.res < 0) {
+		throw std::system_error{int(-e.res), std::system_category()};
+	}
+}
+
+/*
+** Calls `f(buf, n, off)` for each block of at most `buf_size` bytes of the
+** file of size `fs`, keeping `depth` reads in flight. The buffer `buf` must
+** hold `depth * buf_size` bytes.
+*/
+template <class Function>
+static void
+kernel_aio_read(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	off_t fs,
+	const Function& f
+)
+{
+	aio_context ctx{depth};
+	auto cbs = std::vector<iocb>(depth);
+	auto times = std::vector<uint64_t>(depth);
+	auto batch = std::vector<iocb*>{};
+	batch.reserve(depth);
+	auto off = off_t{0};
+	auto pending = 0u;
+
+	auto issue = [&](unsigned i) {
+		prepare_iocb(cbs[i], IOCB_CMD_PREAD, fd, buf + i * buf_size,
+			buf_size, off, i);
+		times[i] = trace_begin();
+		batch.push_back(&cbs[i]);
+		off += buf_size;
+		++pending;
+	};
+
+	for (auto i = 0u; i != depth && off < fs; ++i) { issue(i); }
+
+	while (pending != 0) {
+		ctx.submit(batch.data(), batch.size());
+		batch.clear();
+
+		auto n = ctx.wait();
+		for (auto j = size_t{0}; j != n; ++j) {
+			const auto& e = ctx.events()[j];
+			auto i = unsigned(e.data);
+			--pending;
+			trace_iocb(cbs[i], e, times[i]);
+			check_event(e);
+			f(buf + i * buf_size, size_t(e.res), off_t(cbs[i].aio_offset));
+			if (off < fs) { issue(i); }
+		}
+	}
+}
+
+/*
+** Writes `count` bytes to `fd` in blocks of `buf_size`, keeping `depth` writes
+** in flight. The buffer `buf` must hold `depth * buf_size` bytes, and is
+** written as it is. If `fd` was opened with `O_DIRECT`, then `align` is the
+** alignment required for the lengths of the writes: the last block is padded
+** to it, and the file is then truncated to `count` bytes.
+*/
+static void
+kernel_aio_write(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	size_t count,
+	size_t align = 1
+)
+{
+	aio_context ctx{depth};
+	auto cbs = std::vector<iocb>(depth);
+	auto times = std::vector<uint64_t>(depth);
+	auto batch = std::vector<iocb*>{};
+	batch.reserve(depth);
+	auto off = size_t{0};
+	auto pending = 0u;
+
+	auto issue = [&](unsigned i) {
+		auto n = std::min(buf_size, count - off);
+		auto m = (n + align - 1) / align * align;
+		prepare_iocb(cbs[i], IOCB_CMD_PWRITE, fd, buf + i * buf_size, m,
+			off_t(off), i);
+		times[i] = trace_begin();
+		batch.push_back(&cbs[i]);
+		off += n;
+		++pending;
+	};
+
+	for (auto i = 0u; i != depth && off < count; ++i) { issue(i); }
+
+	while (pending != 0) {
+		ctx.submit(batch.data(), batch.size());
+		batch.clear();
+
+		auto n = ctx.wait();
+		for (auto j = size_t{0}; j != n; ++j) {
+			const auto& e = ctx.events()[j];
+			auto i = unsigned(e.data);
+			--pending;
+			trace_iocb(cbs[i], e, times[i]);
+			check_event(e);
+			assert(size_t(e.res) == cbs[i].aio_nbytes);
+			if (off < count) { issue(i); }
+		}
+	}
+	if (count % align != 0) { truncate(fd, off_t(count)); }
+}
+
+static auto
+kaio_read_plain(const char* path, size_t buf_size, unsigned depth)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	auto count = off_t{0};
+	kernel_aio_read(fd, buf.get(), buf_size, depth, fs,
+		[&](const uint8_t* p, size_t n, off_t) { count += consume(p, n); });
+	::close(fd);
+	return count;
+}
+
+static auto
+kaio_read_direct(const char* path, size_t buf_size, unsigned depth)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto fs = file_size(f.fd).get();
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	auto count = off_t{0};
+	kernel_aio_read(f.fd, buf.get(), bs, depth, fs,
+		[&](const uint8_t* p, size_t n, off_t) { count += consume(p, n); });
+	::close(f.fd);
+	return count;
+}
+
+static auto
+kaio_write_plain(const char* path, size_t buf_size, size_t count, unsigned depth)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	fill_buffer(buf.get(), depth * buf_size);
+	kernel_aio_write(fd, buf.get(), buf_size, depth, count);
+	::close(fd);
+}
+
+static auto
+kaio_write_direct(const char* path, size_t buf_size, size_t count, unsigned depth)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	fill_buffer(buf.get(), depth * bs);
+	kernel_aio_write(f.fd, buf.get(), bs, depth, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+register_kernel_aio_engines(engine_registry& r)
+{
+	r.read_queued("kaio_read_plain", kaio_read_plain);
+	r.read_queued("kaio_read_direct", kaio_read_direct);
+	r.write_queued("kaio_write_plain", kaio_write_plain);
+	r.write_queued("kaio_write_direct", kaio_write_direct);
+}
+
+#endif
@@ -0,0 +1,744 @@
+/*
+** File Name:	metadata.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures the rates of metadata operations (creating, opening, inspecting,
+** renaming, and removing files) and the throughput of listing a directory, for
+** directories with many entries. Listing is done with `cc::directory_iterator`
+** and `cc::prefetching_directory_iterator` at several buffer sizes, with
+** `readdir`, and with `std::filesystem` when the program is compiled as C++17.
+** Every operation refers to its file relative to a descriptor for the
+** directory (`openat`, `fstatat`, and so on), so that the cost of resolving the
+** path to the directory is not included.
+**
+** The files are empty, and are named `f000000000`, `f000000001`, and so on. By
+** default, the dentry and inode caches are warm, since this is the usual state
+** of a busy directory; `--cold` drops them before every trial.
+**
+** With `--walk`, an existing tree is instead walked recursively, once on one
+** thread with `cc::directory_iterator`, and then with `cc::parallel_walker` for
+** each number of threads.
+*/
+
+#ifndef Z9036FA10_6C5F_4B20_82E8_DD022904BFD7
+#define Z9036FA10_6C5F_4B20_82E8_DD022904BFD7
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <ratio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ccbase/format.hpp>
+#include <ccbase/filesystem/directory_iterator.hpp>
+#include <ccbase/filesystem/glob_matcher.hpp>
+#include <ccbase/filesystem/parallel_walker.hpp>
+#include <ccbase/filesystem/prefetching_directory_iterator.hpp>
+
+#if __cplusplus >= 201703L && __has_include(<filesystem>)
+	#include <filesystem>
+	#define METADATA_HAS_FILESYSTEM
+#endif
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <test.hpp>
+
+struct metadata_options
+{
+	// Numbers of entries in the directory.
+	std::vector<size_t> entries{1000, 10000, 100000};
+	std::vector<unsigned> threads{1, std::max(1u, std::thread::hardware_concurrency())};
+	// Sizes of the buffers used by `cc::directory_iterator` and
+	// `cc::prefetching_directory_iterator`. Zero selects the size chosen by
+	// the iterator itself.
+	std::vector<size_t> buffer_sizes{0, 4 << 10, 64 << 10, 1 << 20};
+	// Globs that select the methods to run. All methods are run if this is
+	// empty.
+	std::vector<std::string> methods;
+	// Directory in which the test directories are created.
+	const char* directory{"data/metadata"};
+	// Whether to drop the page, dentry, and inode caches before each trial.
+	bool cold{false};
+	// If not null, the tree to walk instead of running the methods above.
+	const char* walk{nullptr};
+};
+
+using entry_name = std::array<char, 16>;
+
+static entry_name
+file_name(unsigned i)
+{
+	auto r = entry_name{};
+	std::snprintf(r.data(), r.size(), "f%09u", i);
+	return r;
+}
+
+static entry_name
+renamed_file_name(unsigned i)
+{
+	auto r = entry_name{};
+	std::snprintf(r.data(), r.size(), "r%09u", i);
+	return r;
+}
+
+static void
+create_entry(int dfd, unsigned i)
+{
+	auto fd = ::openat(dfd, file_name(i).data(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (fd == -1) { throw current_system_error(); }
+	safe_close(fd).get();
+}
+
+static void
+open_entry(int dfd, unsigned i)
+{
+	auto fd = ::openat(dfd, file_name(i).data(), O_RDONLY);
+	if (fd == -1) { throw current_system_error(); }
+	safe_close(fd).get();
+}
+
+static void
+fstat_entry(int dfd, unsigned i)
+{
+	auto fd = ::openat(dfd, file_name(i).data(), O_RDONLY);
+	if (fd == -1) { throw current_system_error(); }
+
+	struct stat s;
+	auto r = ::fstat(fd, &s);
+	safe_close(fd).get();
+	if (r == -1) { throw current_system_error(); }
+}
+
+static void
+stat_entry(int dfd, unsigned i)
+{
+	struct stat s;
+	if (::fstatat(dfd, file_name(i).data(), &s, 0) == -1) {
+		throw current_system_error();
+	}
+}
+
+#ifdef STATX_BASIC_STATS
+
+static void
+statx_entry(int dfd, unsigned i)
+{
+	struct statx s;
+	if (::statx(dfd, file_name(i).data(), 0, STATX_BASIC_STATS, &s) == -1) {
+		throw current_system_error();
+	}
+}
+
+#endif
+
+static void
+rename_entry(int dfd, unsigned i)
+{
+	if (::renameat(dfd, file_name(i).data(), dfd, renamed_file_name(i).data()) == -1) {
+		throw current_system_error();
+	}
+}
+
+static void
+unrename_entry(int dfd, unsigned i)
+{
+	if (::renameat(dfd, renamed_file_name(i).data(), dfd, file_name(i).data()) == -1) {
+		throw current_system_error();
+	}
+}
+
+static void
+unlink_entry(int dfd, unsigned i)
+{
+	if (::unlinkat(dfd, file_name(i).data(), 0) == -1) {
+		throw current_system_error();
+	}
+}
+
+/*
+** An operation that is applied to every entry of the directory once per trial.
+*/
+struct metadata_op
+{
+	const char* name;
+	// Whether the entries must exist before the operation is run.
+	bool needs_entries;
+	void (*run)(int dfd, unsigned i);
+	// Restores the entry after the operation, or null if there is nothing
+	// to restore. This is not timed.
+	void (*undo)(int dfd, unsigned i);
+};
+
+static bool
+is_dot(const char* s)
+{ return s[0] == '.' && (s[1] == '\0' || (s[1] == '.' && s[2] == '\0')); }
+
+/*
+** Returns the number of entries in `dir`, other than `.` and `..`, using a
+** `cc::directory_iterator` with a buffer of `buf_size` bytes.
+*/
+static size_t
+list_iterator(const char* dir, size_t buf_size)
+{
+	auto n = size_t{0};
+	auto end = cc::directory_iterator{};
+	for (auto it = cc::directory_iterator{dir, buf_size}; it != end; ++it) {
+		if (!is_dot((*it).name())) { ++n; }
+	}
+	return n;
+}
+
+/*
+** Like `list_iterator`, but using `cc::prefetching_directory_iterator`, which
+** has two buffers of `buf_size` bytes each.
+*/
+static size_t
+list_prefetch(const char* dir, size_t buf_size)
+{
+	auto n = size_t{0};
+	auto end = cc::prefetching_directory_iterator{};
+	for (cc::prefetching_directory_iterator it{dir, buf_size}; it != end; ++it) {
+		if (!is_dot((*it).name())) { ++n; }
+	}
+	return n;
+}
+
+static size_t
+list_readdir(const char* dir, size_t)
+{
+	auto d = ::opendir(dir);
+	if (d == nullptr) { throw current_system_error(); }
+
+	auto n = size_t{0};
+	errno = 0;
+	while (auto e = ::readdir(d)) {
+		if (!is_dot(e->d_name)) { ++n; }
+	}
+	auto err = errno;
+	::closedir(d);
+	if (err != 0) { throw std::system_error{err, std::system_category()}; }
+	return n;
+}
+
+#ifdef METADATA_HAS_FILESYSTEM
+
+static size_t
+list_filesystem(const char* dir, size_t)
+{
+	auto n = size_t{0};
+	for (const auto& e : std::filesystem::directory_iterator{dir}) {
+		(void)e;
+		++n;
+	}
+	return n;
+}
+
+#endif
+
+/*
+** A method of listing the directory. The buffer size is only used by the
+** methods for which `buffered` is set.
+*/
+struct listing_method
+{
+	const char* name;
+	bool buffered;
+	size_t (*run)(const char* dir, size_t buf_size);
+};
+
+static std::vector<metadata_op>
+metadata_ops()
+{
+	return {
+		{"create", false, create_entry, unlink_entry},
+		{"open", true, open_entry, nullptr},
+		{"fstat", true, fstat_entry, nullptr},
+		{"stat", true, stat_entry, nullptr},
+	#ifdef STATX_BASIC_STATS
+		{"statx", true, statx_entry, nullptr},
+	#endif
+		{"rename", true, rename_entry, unrename_entry},
+		{"unlink", true, unlink_entry, create_entry}
+	};
+}
+
+static std::vector<listing_method>
+listing_methods()
+{
+	return {
+		{"list_iterator", true, list_iterator},
+		{"list_prefetch", true, list_prefetch},
+		{"list_readdir", false, list_readdir},
+	#ifdef METADATA_HAS_FILESYSTEM
+		{"list_filesystem", false, list_filesystem},
+	#endif
+	};
+}
+
+/*
+** Calls `f(t)` on `threads` threads, for `t` from zero to `threads - 1`, and
+** rethrows the first exception thrown by any of them.
+*/
+template <class Function>
+static void
+run_threads(unsigned threads, const Function& f)
+{
+	auto errors = std::vector<std::exception_ptr>(threads);
+	auto work = [&](unsigned t) {
+		try { f(t); }
+		catch (...) { errors[t] = std::current_exception(); }
+	};
+
+	auto ts = std::vector<std::thread>{};
+	for (auto t = 1u; t < threads; ++t) { ts.emplace_back(work, t); }
+	work(0);
+	for (auto& t : ts) { t.join(); }
+
+	for (const auto& e : errors) {
+		if (e) { std::rethrow_exception(e); }
+	}
+}
+
+/*
+** Applies `f` to each of the `n` entries, with the entries divided into
+** contiguous ranges, one per thread.
+*/
+static void
+for_each_entry(int dfd, unsigned n, unsigned threads, void (*f)(int, unsigned))
+{
+	run_threads(threads, [&](unsigned t) {
+		auto l = unsigned(uint64_t(n) * (t + 1) / threads);
+		for (auto i = unsigned(uint64_t(n) * t / threads); i != l; ++i) {
+			f(dfd, i);
+		}
+	});
+}
+
+static bool
+method_selected(const metadata_options& o, const char* name)
+{
+	if (o.methods.empty()) { return true; }
+	for (const auto& g : o.methods) {
+		if (cc::glob_matcher{g.c_str()}(name)) { return true; }
+	}
+	return false;
+}
+
+template <class Function>
+static double
+time_ms(const Function& f)
+{
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	auto t1 = high_resolution_clock::now();
+	f();
+	auto t2 = high_resolution_clock::now();
+	return duration_cast<milliseconds>(t2 - t1).count();
+}
+
+/*
+** Creates the directory `path` if it does not exist, and otherwise removes the
+** files in it.
+*/
+static void
+make_empty_directory(const char* path)
+{
+	if (::mkdir(path, 0755) == 0) { return; }
+	if (errno != EEXIST) { throw current_system_error(); }
+
+	auto dfd = safe_open(path, O_RDONLY | O_DIRECTORY).get();
+	auto names = std::vector<std::string>{};
+	auto end = cc::directory_iterator{};
+	for (auto it = cc::directory_iterator{path}; it != end; ++it) {
+		if (!is_dot((*it).name())) { names.emplace_back((*it).name()); }
+	}
+	for (const auto& s : names) {
+		if (::unlinkat(dfd, s.c_str(), 0) == -1) { throw current_system_error(); }
+	}
+	safe_close(dfd).get();
+}
+
+/*
+** Returns the file type of the entry `d`, calling `lstat` only if the file
+** system did not provide it.
+*/
+static cc::file_type
+entry_type(const cc::directory_entry& d)
+{
+	if (d.type() != cc::file_type::unknown) { return d.type(); }
+
+	struct stat s;
+	if (::lstat(d.path(), &s) == -1) { throw current_system_error(); }
+	return S_ISDIR(s.st_mode) ? cc::file_type::directory : cc::file_type::regular;
+}
+
+/*
+** Returns the number of entries in the tree below `root`, walking it on one
+** thread with `cc::directory_iterator`. Like `cc::parallel_walker`, this skips
+** subdirectories that cannot be opened.
+*/
+static size_t
+walk_serial(const char* root, size_t buf_size)
+{
+	auto n = size_t{0};
+	auto dirs = std::vector<std::string>{root};
+	auto end = cc::directory_iterator{};
+
+	for (auto first = true; !dirs.empty(); first = false) {
+		auto dir = std::move(dirs.back());
+		dirs.pop_back();
+		try {
+			for (auto it = cc::directory_iterator{dir.c_str(), buf_size}; it != end; ++it) {
+				auto d = *it;
+				if (is_dot(d.name())) { continue; }
+				if (entry_type(d) == cc::file_type::directory) {
+					dirs.emplace_back(d.path());
+				}
+				++n;
+			}
+		}
+		catch (const std::system_error& e) {
+			auto v = e.code().value();
+			if (first || (v != EACCES && v != ENOENT && v != ENOTDIR)) { throw; }
+		}
+	}
+	return n;
+}
+
+static size_t
+walk_parallel(const char* root, size_t buf_size, unsigned threads)
+{
+	auto o = cc::walk_options{};
+	o.threads = threads;
+	o.buffer_size = buf_size;
+
+	auto n = size_t{0};
+	cc::parallel_walker w{root, o};
+	w.for_each([&](const cc::walk_entry&) { ++n; });
+	return n;
+}
+
+static void
+run_walk(const metadata_options& o)
+{
+	auto drop = [&]() { if (o.cold) { purge_cache().get(); } };
+	auto n = walk_serial(o.walk, 0);
+
+	for (const auto& bs : o.buffer_sizes) {
+		if (method_selected(o, "walk_serial")) {
+			drop();
+			auto s = sample_trials(
+				[&]() {
+					return time_ms([&]() {
+						if (walk_serial(o.walk, bs) != n) {
+							throw std::runtime_error{"mismatching count"};
+						}
+					});
+				},
+				drop
+			);
+			report_rate("walk_serial", bs, 1, n, n, s);
+		}
+
+		if (!method_selected(o, "walk_parallel")) { continue; }
+		for (const auto& t : o.threads) {
+			drop();
+			auto s = sample_trials(
+				[&]() {
+					return time_ms([&]() {
+						if (walk_parallel(o.walk, bs, t) != n) {
+							throw std::runtime_error{"mismatching count"};
+						}
+					});
+				},
+				drop
+			);
+			report_rate("walk_parallel", bs, t, n, n, s);
+		}
+	}
+}
+
+static void
+run_metadata(const metadata_options& o)
+{
+	auto drop = [&]() { if (o.cold) { purge_cache().get(); } };
+
+	for (const auto& n : o.entries) {
+		auto path = std::string{o.directory} + "/" + std::to_string(n);
+		auto dir = path.c_str();
+		make_empty_directory(dir);
+		auto dfd = safe_open(dir, O_RDONLY | O_DIRECTORY).get();
+		auto populated = false;
+
+		// Brings the directory into the state required by the next
+		// method. This is done with all threads, since creating
+		// millions of files is slow.
+		auto prepare = [&](bool needs_entries) {
+			if (populated == needs_entries) { return; }
+			for_each_entry(dfd, n, o.threads.back(),
+				needs_entries ? create_entry : unlink_entry);
+			populated = needs_entries;
+		};
+
+		for (const auto& t : o.threads) {
+			for (const auto& op : metadata_ops()) {
+				if (!method_selected(o, op.name)) { continue; }
+				prepare(op.needs_entries);
+				drop();
+
+				auto s = sample_trials(
+					[&]() {
+						return time_ms([&]() {
+							for_each_entry(dfd, n, t, op.run);
+						});
+					},
+					[&]() {
+						if (op.undo != nullptr) {
+							for_each_entry(dfd, n, t, op.undo);
+						}
+						drop();
+					}
+				);
+				report_rate(op.name, 0, t, n, n, s);
+			}
+
+			// Each thread lists the whole directory, as would separate
+			// processes that scan the same directory.
+			for (const auto& m : listing_methods()) {
+				if (!method_selected(o, m.name)) { continue; }
+				prepare(true);
+				drop();
+
+				auto sizes = m.buffered ? o.buffer_sizes : std::vector<size_t>{0};
+				for (const auto& bs : sizes) {
+					auto s = sample_trials(
+						[&]() {
+							return time_ms([&]() {
+								run_threads(t, [&](unsigned) {
+									if (m.run(dir, bs) != n) {
+										throw std::runtime_error{"mismatching count"};
+									}
+								});
+							});
+						},
+						drop
+					);
+					report_rate(m.name, bs, t, n, n * t, s);
+				}
+			}
+		}
+
+		prepare(false);
+		safe_close(dfd).get();
+		if (::rmdir(dir) == -1) { throw current_system_error(); }
+	}
+}
+
+static void
+print_metadata_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options]\n"
+"\n"
+"Measures the rates of metadata operations and the throughput of directory\n"
+"listing in directories with the given numbers of entries.\n"
+"\n"
+"Options:\n"
+"  -n, --entries LIST            Numbers of entries, e.g. 1000,10000,1000000.\n"
+"  -t, --threads LIST            Numbers of threads, e.g. 1,4,16.\n"
+"  -b, --buffer-sizes LIST       Buffer sizes of the ccbase directory iterators,\n"
+"                                e.g. 4K-1M. Zero uses the size chosen by the\n"
+"                                iterator.\n"
+"  -m, --methods GLOB[,GLOB...]  Methods to run (default: all).\n"
+"  -d, --directory PATH          Where to create the test directories.\n"
+"  -c, --cold                    Drop the caches before each trial (needs root).\n"
+"  -w, --walk PATH               Walk the tree at PATH instead, serially and with\n"
+"                                cc::parallel_walker.\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"      --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --warmup N                Number of untimed warm-up trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"      --ci-width FRACTION       Target width of the CI relative to the median.\n"
+"  -l, --list                    List the methods and exit.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+metadata_main(int argc, char** argv)
+{
+	auto o = metadata_options{};
+	auto list = false;
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_metadata_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-l", "--list")) {
+				list = true;
+			}
+			else if (is_option(a, "-n", "--entries")) {
+				o.entries = parse_size_list(value());
+				for (const auto& n : o.entries) {
+					if (n == 0 || n > 1000000000) {
+						throw std::invalid_argument{cc::format(
+							"invalid number of entries \"$\"", n)};
+					}
+				}
+			}
+			else if (is_option(a, "-t", "--threads")) {
+				o.threads.clear();
+				for (const auto& t : split(value(), ',')) {
+					o.threads.push_back(parse_count(t.c_str()));
+				}
+			}
+			else if (is_option(a, "-b", "--buffer-sizes")) {
+				// Zero, which uses the size chosen by the iterator,
+				// can be given as an element of the list.
+				o.buffer_sizes.clear();
+				for (const auto& b : split(value(), ',')) {
+					auto v = b == "0" ? std::vector<size_t>{0} :
+						parse_size_list(b.c_str());
+					o.buffer_sizes.insert(o.buffer_sizes.end(), v.begin(), v.end());
+				}
+			}
+			else if (is_option(a, "-m", "--methods")) {
+				auto g = split(value(), ',');
+				o.methods.insert(o.methods.end(), g.begin(), g.end());
+			}
+			else if (is_option(a, "-d", "--directory")) {
+				o.directory = value();
+			}
+			else if (is_option(a, "-c", "--cold")) {
+				o.cold = true;
+			}
+			else if (is_option(a, "-w", "--walk")) {
+				o.walk = value();
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, nullptr, "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--warmup")) {
+				auto s = value();
+				sampler.warmup_trials = std::strcmp(s, "0") == 0 ? 0 : parse_count(s);
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else if (is_option(a, nullptr, "--ci-width")) {
+				sampler.target_ci_width = parse_real(value());
+			}
+			else {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+		}
+
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	if (list && o.walk != nullptr) {
+		for (const auto& m : {"walk_serial", "walk_parallel"}) {
+			if (method_selected(o, m)) { cc::println(m); }
+		}
+		return EXIT_SUCCESS;
+	}
+	if (list) {
+		for (const auto& op : metadata_ops()) {
+			if (method_selected(o, op.name)) { cc::println(op.name); }
+		}
+		for (const auto& m : listing_methods()) {
+			if (method_selected(o, m.name)) { cc::println(m.name); }
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Sort the thread counts so that the largest one, which is used to
+	// populate the directories, is last.
+	std::sort(o.threads.begin(), o.threads.end());
+	o.threads.erase(std::unique(o.threads.begin(), o.threads.end()), o.threads.end());
+
+	if (o.walk != nullptr) {
+		begin_report(capture_environment({o.walk}), result_kind::metadata);
+		try {
+			run_walk(o);
+		}
+		catch (const std::system_error& e) {
+			cc::errln("Error: failed to walk \"$\": $.", o.walk, e.what());
+			return EXIT_FAILURE;
+		}
+		catch (const std::runtime_error& e) {
+			cc::errln("Error: failed to walk \"$\": $.", o.walk, e.what());
+			return EXIT_FAILURE;
+		}
+		end_report();
+		return EXIT_SUCCESS;
+	}
+
+	if (::mkdir(o.directory, 0755) == -1 && errno != EEXIST) {
+		cc::errln("Error: failed to create \"$\".", o.directory);
+		return EXIT_FAILURE;
+	}
+	begin_report(capture_environment({o.directory}), result_kind::metadata);
+	try {
+		run_metadata(o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to benchmark \"$\": $.", o.directory, e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: failed to benchmark \"$\": $.", o.directory, e.what());
+		return EXIT_FAILURE;
+	}
+	end_report();
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,711 @@
+/*
+** File Name:	notify.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Compares the ways in which a thread can learn that its asynchronous reads
+** have completed. Each mode reads the file in blocks, keeping a fixed number of
+** reads in flight, and records the time from the submission of each read to
+** the point at which the thread notices its completion, along with the CPU
+** time used by the process (including the threads that glibc creates for POSIX
+** AIO).
+**
+** With Linux native AIO (see `kernel_aio.hpp`):
+**
+**   - `kaio_block`: `io_getevents` waits for at least one completion.
+**   - `kaio_poll`: `io_getevents` is called with a zero timeout in a loop.
+**   - `kaio_eventfd`: each request is submitted with `IOCB_FLAG_RESFD`, so that
+**     the kernel signals an `eventfd` when it completes, and the thread waits
+**     for the `eventfd` in `epoll_wait`, as an event loop that serves sockets
+**     would.
+**
+** With POSIX AIO:
+**
+**   - `posix_suspend`: `aio_suspend` on the reads in flight.
+**   - `posix_poll`: `aio_error` is called on the reads in flight in a loop.
+**   - `posix_thread`: `SIGEV_THREAD`, with a callback that signals an
+**     `eventfd` that the thread waits for in `epoll_wait`.
+**   - `posix_signal`: `SIGEV_SIGNAL`, with a real-time signal that is blocked
+**     and read from a `signalfd` that the thread waits for in `epoll_wait`.
+**
+** The completion signals are directed at the process, and can be delivered to
+** any thread that does not block them, including the ones that glibc creates
+** for POSIX AIO. Since a thread inherits the signal mask of its creator,
+** `block_notify_signal` blocks the signal before any thread is created, and it
+** stays blocked for the life of the process: a signal can still be queued for
+** a read after `aio_error` has reported that the read is done, and its default
+** action would terminate the process.
+**
+** After a POSIX mode wakes up, the reads in flight are checked with `aio_error`
+** to find the ones that have completed. Native AIO only completes
+** asynchronously on files opened with `O_DIRECT`, which is used by default.
+*/
+
+#ifndef ZD1CFB296_184B_4828_9882_4445A787BD29
+#define ZD1CFB296_184B_4828_9882_4445A787BD29
+
+#include <aio.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <ccbase/format.hpp>
+
+#include <consumer.hpp>
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <kernel_aio.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <statistics.hpp>
+#include <test.hpp>
+
+enum class notify_mode
+{
+	kaio_block,
+	kaio_poll,
+	kaio_eventfd,
+	posix_suspend,
+	posix_poll,
+	posix_thread,
+	posix_signal
+};
+
+static const auto all_notify_modes = std::vector<notify_mode>{
+	notify_mode::kaio_block, notify_mode::kaio_poll,
+	notify_mode::kaio_eventfd, notify_mode::posix_suspend,
+	notify_mode::posix_poll, notify_mode::posix_thread,
+	notify_mode::posix_signal
+};
+
+static const char*
+notify_mode_name(notify_mode m)
+{
+	switch (m) {
+	case notify_mode::kaio_block:    return "kaio_block";
+	case notify_mode::kaio_poll:     return "kaio_poll";
+	case notify_mode::kaio_eventfd:  return "kaio_eventfd";
+	case notify_mode::posix_suspend: return "posix_suspend";
+	case notify_mode::posix_poll:    return "posix_poll";
+	case notify_mode::posix_thread:  return "posix_thread";
+	case notify_mode::posix_signal:  return "posix_signal";
+	}
+	return "unknown";
+}
+
+static notify_mode
+parse_notify_mode(const std::string& s)
+{
+	for (const auto& m : all_notify_modes) {
+		if (s == notify_mode_name(m)) { return m; }
+	}
+	throw std::invalid_argument{cc::format("invalid mode \"$\"", s)};
+}
+
+struct notify_options
+{
+	std::vector<notify_mode> modes{all_notify_modes};
+	std::vector<size_t> block_sizes{4096, 65536};
+	std::vector<unsigned> queue_depths{1, 8, 32};
+	// Whether to read the file through the page cache instead of with
+	// `O_DIRECT`.
+	bool buffered{false};
+	const char* path{nullptr};
+};
+
+namespace detail {
+
+static uint64_t
+now_ns() noexcept
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
+
+// The CPU time used by the process so far, in seconds.
+static double
+process_cpu_time()
+{
+	auto r = rusage{};
+	if (::getrusage(RUSAGE_SELF, &r) == -1) { throw current_system_error(); }
+	auto s = [](const timeval& t) { return t.tv_sec + t.tv_usec / 1e6; };
+	return s(r.ru_utime) + s(r.ru_stime);
+}
+
+/*
+** An `epoll` instance that waits for a single descriptor to become readable.
+*/
+class epoll_waiter
+{
+	int m_ep;
+public:
+	explicit epoll_waiter(int fd)
+	{
+		m_ep = ::epoll_create1(EPOLL_CLOEXEC);
+		if (m_ep == -1) { throw current_system_error(); }
+		auto e = epoll_event{};
+		e.events = EPOLLIN;
+		e.data.fd = fd;
+		if (::epoll_ctl(m_ep, EPOLL_CTL_ADD, fd, &e) == -1) {
+			throw current_system_error();
+		}
+	}
+
+	epoll_waiter(const epoll_waiter&) = delete;
+	epoll_waiter& operator=(const epoll_waiter&) = delete;
+
+	~epoll_waiter()
+	{ ::close(m_ep); }
+
+	void wait()
+	{
+		auto e = epoll_event{};
+		while (::epoll_wait(m_ep, &e, 1, -1) == -1) {
+			if (errno != EINTR) { throw current_system_error(); }
+		}
+	}
+};
+
+static int
+make_eventfd()
+{
+	auto fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd == -1) { throw current_system_error(); }
+	return fd;
+}
+
+// Resets the counter of the `eventfd` `fd`.
+static void
+drain_eventfd(int fd)
+{
+	auto c = uint64_t{};
+	if (::read(fd, &c, sizeof(c)) == -1 && errno != EAGAIN) {
+		throw current_system_error();
+	}
+}
+
+/*
+** The state shared with the `SIGEV_THREAD` callbacks: the `eventfd` that they
+** signal, and the number of callbacks that have yet to finish, which must reach
+** zero before the `eventfd` is closed.
+*/
+struct notify_callbacks
+{
+	int fd;
+	std::atomic<unsigned> pending{0};
+
+	void wait() const noexcept
+	{
+		while (pending.load(std::memory_order_acquire) != 0) {
+			std::this_thread::yield();
+		}
+	}
+};
+
+// The callback for `SIGEV_THREAD`, which runs on a thread created by glibc.
+static void
+signal_eventfd(sigval v)
+{
+	auto c = static_cast<notify_callbacks*>(v.sival_ptr);
+	auto one = uint64_t{1};
+	(void)::write(c->fd, &one, sizeof(one));
+	// The state may be destroyed as soon as this is seen.
+	c->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static int
+notify_signal() noexcept
+{ return SIGRTMIN; }
+
+}
+
+/*
+** Blocks the completion signal of `posix_signal` in the calling thread, and so
+** in every thread that it creates afterwards. This must be called before any
+** thread is created.
+*/
+static void
+block_notify_signal()
+{
+	auto sigs = sigset_t{};
+	sigemptyset(&sigs);
+	sigaddset(&sigs, detail::notify_signal());
+	auto r = ::pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+	if (r != 0) { throw std::system_error{r, std::system_category()}; }
+}
+
+/*
+** Reads the file of size `fs` with native AIO, keeping `depth` reads of
+** `buf_size` bytes in flight, and appends the latency of each read to `lat`.
+*/
+static off_t
+kaio_notify_read(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	off_t fs,
+	notify_mode m,
+	std::vector<double>& lat
+)
+{
+	aio_context ctx{depth};
+	auto cbs = std::vector<iocb>(depth);
+	auto times = std::vector<uint64_t>(depth);
+	auto batch = std::vector<iocb*>{};
+	batch.reserve(depth);
+	auto off = off_t{0};
+	auto pending = 0u;
+	auto count = off_t{0};
+
+	auto efd = -1;
+	auto ep = std::unique_ptr<detail::epoll_waiter>{};
+	if (m == notify_mode::kaio_eventfd) {
+		efd = detail::make_eventfd();
+		ep.reset(new detail::epoll_waiter{efd});
+	}
+
+	auto issue = [&](unsigned i) {
+		prepare_iocb(cbs[i], IOCB_CMD_PREAD, fd, buf + i * buf_size,
+			buf_size, off, i);
+		if (efd != -1) {
+			cbs[i].aio_flags = IOCB_FLAG_RESFD;
+			cbs[i].aio_resfd = uint32_t(efd);
+		}
+		times[i] = detail::now_ns();
+		batch.push_back(&cbs[i]);
+		off += buf_size;
+		++pending;
+	};
+
+	for (auto i = 0u; i != depth && off < fs; ++i) { issue(i); }
+
+	while (pending != 0) {
+		ctx.submit(batch.data(), batch.size());
+		batch.clear();
+
+		auto n = size_t{0};
+		switch (m) {
+		case notify_mode::kaio_poll:
+			while ((n = ctx.reap()) == 0) {}
+			break;
+		case notify_mode::kaio_eventfd:
+			ep->wait();
+			detail::drain_eventfd(efd);
+			n = ctx.reap();
+			break;
+		default:
+			n = ctx.wait();
+		}
+
+		auto t = detail::now_ns();
+		for (auto j = size_t{0}; j != n; ++j) {
+			const auto& e = ctx.events()[j];
+			auto i = unsigned(e.data);
+			--pending;
+			lat.push_back((t - times[i]) / 1e3);
+			check_event(e);
+			count += consume(buf + i * buf_size, size_t(e.res));
+			if (off < fs) { issue(i); }
+		}
+	}
+
+	if (efd != -1) { ::close(efd); }
+	return count;
+}
+
+/*
+** Like `kaio_notify_read`, but with POSIX AIO. For `posix_signal`,
+** `block_notify_signal` must have been called first.
+*/
+static off_t
+posix_notify_read(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	off_t fs,
+	notify_mode m,
+	std::vector<double>& lat
+)
+{
+	using aiocb = struct aiocb;
+	auto cbs = std::vector<aiocb>(depth);
+	auto times = std::vector<uint64_t>(depth);
+	// The control block of each read in flight, or null.
+	auto live = std::vector<aiocb*>(depth);
+	auto list = std::vector<const aiocb*>(depth);
+	auto off = off_t{0};
+	auto pending = 0u;
+	auto count = off_t{0};
+
+	// The descriptor that the thread waits for in `epoll_wait`, if any.
+	auto wfd = -1;
+	auto ep = std::unique_ptr<detail::epoll_waiter>{};
+	detail::notify_callbacks callbacks{-1};
+	auto signo = detail::notify_signal();
+
+	if (m == notify_mode::posix_thread) {
+		wfd = detail::make_eventfd();
+		callbacks.fd = wfd;
+	}
+	else if (m == notify_mode::posix_signal) {
+		auto sigs = sigset_t{};
+		auto r = ::pthread_sigmask(SIG_BLOCK, nullptr, &sigs);
+		if (r != 0) { throw std::system_error{r, std::system_category()}; }
+		if (sigismember(&sigs, signo) != 1) {
+			throw std::logic_error{"The completion signal is not blocked."};
+		}
+		sigemptyset(&sigs);
+		sigaddset(&sigs, signo);
+		wfd = ::signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+		if (wfd == -1) { throw current_system_error(); }
+	}
+
+	// Reads the signals queued so far, which may include some for reads
+	// that have already been reaped.
+	auto drain_signals = [&]() {
+		auto si = signalfd_siginfo{};
+		while (::read(wfd, &si, sizeof(si)) == sizeof(si)) {}
+	};
+
+	auto issue = [&](unsigned i) {
+		cbs[i] = aiocb{};
+		cbs[i].aio_fildes = fd;
+		cbs[i].aio_buf = buf + i * buf_size;
+		cbs[i].aio_nbytes = buf_size;
+		cbs[i].aio_offset = off;
+		if (m == notify_mode::posix_thread) {
+			cbs[i].aio_sigevent.sigev_notify = SIGEV_THREAD;
+			cbs[i].aio_sigevent.sigev_notify_function = detail::signal_eventfd;
+			cbs[i].aio_sigevent.sigev_value.sival_ptr = &callbacks;
+		}
+		else if (m == notify_mode::posix_signal) {
+			cbs[i].aio_sigevent.sigev_notify = SIGEV_SIGNAL;
+			cbs[i].aio_sigevent.sigev_signo = signo;
+		}
+		if (m == notify_mode::posix_thread) {
+			callbacks.pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		times[i] = detail::now_ns();
+		if (::aio_read(&cbs[i]) == -1) {
+			if (m == notify_mode::posix_thread) {
+				callbacks.pending.fetch_sub(1, std::memory_order_relaxed);
+			}
+			throw current_system_error();
+		}
+		live[i] = &cbs[i];
+		off += buf_size;
+		++pending;
+	};
+
+	try {
+		if (wfd != -1) { ep.reset(new detail::epoll_waiter{wfd}); }
+		for (auto i = 0u; i != depth && off < fs; ++i) { issue(i); }
+
+		while (pending != 0) {
+			switch (m) {
+			case notify_mode::posix_suspend: {
+				auto n = 0;
+				for (auto i = 0u; i != depth; ++i) {
+					if (live[i] != nullptr) { list[n++] = live[i]; }
+				}
+				if (::aio_suspend(list.data(), n, nullptr) == -1 &&
+					errno != EINTR && errno != EAGAIN)
+				{
+					throw current_system_error();
+				}
+				break;
+			}
+			case notify_mode::posix_thread:
+				ep->wait();
+				detail::drain_eventfd(wfd);
+				break;
+			case notify_mode::posix_signal:
+				ep->wait();
+				drain_signals();
+				break;
+			default:
+				break;
+			}
+
+			auto t = detail::now_ns();
+			for (auto i = 0u; i != depth; ++i) {
+				if (live[i] == nullptr) { continue; }
+				auto e = ::aio_error(&cbs[i]);
+				if (e == EINPROGRESS) { continue; }
+				live[i] = nullptr;
+				--pending;
+				lat.push_back((t - times[i]) / 1e3);
+				auto n = ::aio_return(&cbs[i]);
+				if (e != 0) { throw std::system_error{e, std::system_category()}; }
+				count += consume(buf + i * buf_size, size_t(n));
+				if (off < fs) { issue(i); }
+			}
+		}
+	}
+	catch (...) {
+		// The reads in flight write into `cbs` and `buf`, and their
+		// callbacks use `callbacks` and `wfd`.
+		drain_aio(live.data(), live.size());
+		callbacks.wait();
+		if (wfd != -1) { ::close(wfd); }
+		throw;
+	}
+
+	// A callback can still be running, or a signal can still be queued,
+	// after `aio_error` has reported that its read is done.
+	callbacks.wait();
+	if (m == notify_mode::posix_signal) { drain_signals(); }
+	if (wfd != -1) { ::close(wfd); }
+	return count;
+}
+
+struct notify_trial
+{
+	// Wall-clock and CPU time, in milliseconds.
+	double time;
+	double cpu;
+	std::vector<double> latencies;
+};
+
+static notify_trial
+run_notify_trial(
+	const notify_options& o,
+	notify_mode m,
+	size_t buf_size,
+	unsigned depth
+)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto r = notify_trial{};
+	auto in = open_direct(o.path, O_RDONLY | O_NOATIME);
+	if (o.buffered) {
+		::close(in.fd);
+		in.fd = safe_open(o.path, O_RDONLY | O_NOATIME).get();
+		in.align = direct_alignment{};
+		in.align.offset = 1;
+	}
+	auto fs = file_size(in.fd).get();
+	auto bs = in.align.round(buf_size);
+	auto buf = allocate_aligned(in.align.memory, depth * bs);
+
+	auto c1 = detail::process_cpu_time();
+	auto t1 = clock::now();
+	switch (m) {
+	case notify_mode::kaio_block:
+	case notify_mode::kaio_poll:
+	case notify_mode::kaio_eventfd:
+		kaio_notify_read(in.fd, buf.get(), bs, depth, fs, m, r.latencies);
+		break;
+	default:
+		posix_notify_read(in.fd, buf.get(), bs, depth, fs, m, r.latencies);
+	}
+	r.time = std::chrono::duration<double, std::milli>{clock::now() - t1}.count();
+	r.cpu = 1000 * (detail::process_cpu_time() - c1);
+	::close(in.fd);
+	return r;
+}
+
+/*
+** Times the mode `m` with the given block size and queue depth, and reports the
+** results. The CPU time and latencies are taken over the timed trials.
+*/
+static void
+run_notify_config(
+	const notify_options& o,
+	notify_mode m,
+	size_t bs,
+	unsigned depth,
+	off_t fs
+)
+{
+	auto trials = std::vector<notify_trial>{};
+	auto s = sample_trials(
+		[&]() {
+			trials.push_back(run_notify_trial(o, m, bs, depth));
+			return trials.back().time;
+		},
+		[]() { purge_cache().get(); }
+	);
+
+	auto time = 0.0;
+	auto cpu = 0.0;
+	auto lat = std::vector<double>{};
+	for (auto i = trials.size() - s.times.size(); i != trials.size(); ++i) {
+		time += trials[i].time;
+		cpu += trials[i].cpu;
+		lat.insert(lat.end(), trials[i].latencies.begin(),
+			trials[i].latencies.end());
+	}
+	std::sort(lat.begin(), lat.end());
+	auto q = [&](double p) { return sorted_quantile(lat.begin(), lat.end(), p); };
+
+	report_result(notify_mode_name(m), bs, depth, fs, s, {
+		{"cpu_pct", 100 * cpu / time},
+		{"cpu_per_io_us", 1000 * cpu / lat.size()},
+		{"p50_us", q(0.5)},
+		{"p90_us", q(0.9)},
+		{"p99_us", q(0.99)},
+		{"p999_us", q(0.999)},
+		{"max_us", lat.back()}
+	});
+}
+
+static void
+run_notify(const notify_options& o)
+{
+	auto fd = safe_open(o.path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	safe_close(fd).get();
+	if (fs == 0) { throw std::runtime_error{"the file is empty"}; }
+
+	begin_report(capture_environment({o.path}), result_kind::io, {"CPU (%)",
+		"CPU/IO (us)", "p50 (us)", "p90 (us)", "p99 (us)", "p99.9 (us)",
+		"Max (us)"});
+
+	for (const auto& m : o.modes) {
+		for (const auto& bs : o.block_sizes) {
+			for (const auto& qd : o.queue_depths) {
+				run_notify_config(o, m, bs, qd, fs);
+			}
+		}
+	}
+	end_report();
+}
+
+static void
+print_notify_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] file\n"
+"\n"
+"Reads the file asynchronously with each way of learning that the reads have\n"
+"completed, and reports the latency from submission to notification along with\n"
+"the CPU time used.\n"
+"\n"
+"Options:\n"
+"  -m, --modes MODE[,MODE...]    Notification modes: kaio_block, kaio_poll,\n"
+"                                kaio_eventfd, posix_suspend, posix_poll,\n"
+"                                posix_thread, posix_signal (default: all).\n"
+"  -b, --block-sizes LIST        Block sizes (default: 4K,64K).\n"
+"  -q, --queue-depths LIST       Reads in flight (default: 1,8,32).\n"
+"      --buffered                Read through the page cache instead of with\n"
+"                                O_DIRECT.\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"  -n, --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+notify_main(int argc, char** argv)
+{
+	auto o = notify_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_notify_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-m", "--modes")) {
+				o.modes.clear();
+				for (const auto& m : split(value(), ',')) {
+					o.modes.push_back(parse_notify_mode(m));
+				}
+			}
+			else if (is_option(a, "-b", "--block-sizes")) {
+				o.block_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-q", "--queue-depths")) {
+				o.queue_depths = parse_depth_list(value());
+			}
+			else if (is_option(a, nullptr, "--buffered")) {
+				o.buffered = true;
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, "-n", "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else if (o.path != nullptr) {
+				throw std::invalid_argument{"more than one file given"};
+			}
+			else {
+				o.path = a;
+			}
+		}
+
+		if (o.path == nullptr) {
+			throw std::invalid_argument{"no file given"};
+		}
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	// No thread has been created yet, so the signal is blocked in all of
+	// them.
+	block_notify_signal();
+	try {
+		run_notify(o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to read \"$\": $.", o.path, e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
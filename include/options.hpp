@@ -0,0 +1,180 @@
+/*
+** File Name:	options.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Helpers for parsing command-line arguments. The parsing functions throw
+** `std::invalid_argument` with a message that is suitable for printing.
+*/
+
+#ifndef Z388208F6_27E1_4F6D_912B_44FBA41CCD73
+#define Z388208F6_27E1_4F6D_912B_44FBA41CCD73
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <ccbase/format.hpp>
+
+/*
+** Parses a size with an optional `K`, `M`, or `G` suffix (powers of 1024).
+*/
+static size_t
+parse_size(const char* s)
+{
+	auto end = (char*)nullptr;
+	errno = 0;
+	auto n = std::strtoull(s, &end, 10);
+	if (end == s || errno != 0) {
+		throw std::invalid_argument{cc::format("invalid size \"$\"", s)};
+	}
+
+	switch (*end) {
+	case '\0':                                 return n;
+	case 'k': case 'K': n <<= 10; ++end; break;
+	case 'm': case 'M': n <<= 20; ++end; break;
+	case 'g': case 'G': n <<= 30; ++end; break;
+	}
+	if (*end == 'B' || *end == 'b') { ++end; }
+	if (*end != '\0') {
+		throw std::invalid_argument{cc::format("invalid size \"$\"", s)};
+	}
+	return n;
+}
+
+/*
+** Parses a comma-separated list of sizes. Each element is either a single
+** size, a range `a-b` that doubles from `a` up to `b`, or a range `a-b+s`
+** that counts from `a` up to `b` in steps of `s`. Sizes of zero are rejected.
+*/
+static std::vector<size_t>
+parse_size_list(const char* s)
+{
+	auto r = std::vector<size_t>{};
+	auto list = std::string{s};
+	auto pos = size_t{0};
+
+	for (;;) {
+		auto comma = list.find(',', pos);
+		auto tok = list.substr(pos, comma - pos);
+		auto dash = tok.find('-');
+
+		if (dash == std::string::npos) {
+			auto n = parse_size(tok.c_str());
+			if (n == 0) {
+				throw std::invalid_argument{cc::format("invalid size \"$\"", tok)};
+			}
+			r.push_back(n);
+		}
+		else {
+			auto plus = tok.find('+', dash);
+			auto lo = parse_size(tok.substr(0, dash).c_str());
+			auto hi = parse_size(tok.substr(dash + 1, plus - dash - 1).c_str());
+			auto step = plus == std::string::npos ? size_t{0} :
+				parse_size(tok.substr(plus + 1).c_str());
+
+			if (lo == 0 || lo > hi) {
+				throw std::invalid_argument{cc::format("invalid range \"$\"", tok)};
+			}
+			// The checks before each increment keep `x` from
+			// overflowing when `hi` is close to the maximum.
+			for (auto x = lo;;) {
+				r.push_back(x);
+				if ((step == 0 ? x : step) > hi - x) { break; }
+				x = step == 0 ? 2 * x : x + step;
+			}
+		}
+
+		if (comma == std::string::npos) { break; }
+		pos = comma + 1;
+	}
+	return r;
+}
+
+/*
+** Parses a list of queue depths, in the same format as `parse_size_list`.
+*/
+static std::vector<unsigned>
+parse_depth_list(const char* s)
+{
+	auto r = std::vector<unsigned>{};
+	for (const auto& n : parse_size_list(s)) {
+		if (n == 0 || n > 1024) {
+			throw std::invalid_argument{cc::format("invalid queue depth \"$\"", n)};
+		}
+		r.push_back(n);
+	}
+	return r;
+}
+
+static std::vector<std::string>
+split(const char* s, char c)
+{
+	auto r = std::vector<std::string>{};
+	auto f = s;
+	for (;;) {
+		auto l = std::strchr(f, c);
+		if (l == nullptr) {
+			r.emplace_back(f);
+			return r;
+		}
+		r.emplace_back(f, l);
+		f = l + 1;
+	}
+}
+
+static std::string
+format_size(size_t n)
+{
+	if (n % 1024 == 0) { return cc::format("$ KB", n / 1024); }
+	return cc::format("$ B", n);
+}
+
+static unsigned
+parse_count(const char* s)
+{
+	auto end = (char*)nullptr;
+	auto n = std::strtoul(s, &end, 10);
+	if (end == s || *end != '\0' || n == 0) {
+		throw std::invalid_argument{cc::format("invalid count \"$\"", s)};
+	}
+	return n;
+}
+
+static double
+parse_real(const char* s)
+{
+	auto end = (char*)nullptr;
+	auto x = std::strtod(s, &end);
+	if (end == s || *end != '\0' || x <= 0) {
+		throw std::invalid_argument{cc::format("invalid number \"$\"", s)};
+	}
+	return x;
+}
+
+/*
+** Checks whether the argument `a` is the option with the short name `s` (which
+** may be null) or the long name `l`.
+*/
+static bool
+is_option(const char* a, const char* s, const char* l)
+{
+	return (s != nullptr && std::strcmp(a, s) == 0) || std::strcmp(a, l) == 0;
+}
+
+/*
+** Returns the value of the option at `argv[i]`, and advances `i` past it.
+*/
+static const char*
+option_value(int argc, char** argv, int& i)
+{
+	if (i + 1 == argc) {
+		throw std::invalid_argument{cc::format("missing value for \"$\"", argv[i])};
+	}
+	return argv[++i];
+}
+
+#endif
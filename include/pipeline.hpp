@@ -0,0 +1,784 @@
+/*
+** File Name:	pipeline.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures a staged read, transform, and write pipeline, of the kind run by ETL
+** jobs. Reader threads read the blocks of the input into buffers taken from a
+** pool, worker threads run a consumer stage (see `consumer.hpp`) on each block,
+** and writer threads write the blocks to the output and return the buffers to
+** the pool. The stages are connected by bounded lock-free queues of buffer
+** indices.
+**
+** The readers number the blocks as they take them, and block `i` is written by
+** writer `i mod W`, which writes its blocks in order and holds back the ones
+** that arrive early. A reader only takes the number of the next block once it
+** holds a buffer, so the earliest block that has not been written always has
+** one, and the pipeline cannot deadlock however the queues fill up.
+**
+** The time of the threads of each stage is split into the time spent on the
+** work itself (busy), waiting for input (starved), and waiting for room in the
+** next queue or for a free buffer (blocked). The time for which a stage is
+** blocked is the back-pressure exerted on it by the stages after it.
+**
+** The stages do their IO in one of the following ways:
+**
+**   - `pread` and `pwrite`: through the page cache.
+**   - `direct`: with `O_DIRECT`, with the block size rounded up to the
+**     alignment required by the input and output. The last block written is
+**     padded, and the output is then truncated.
+**   - `splice` (writers only, on Linux): each block is given to a pipe with
+**     `vmsplice`, and the pipe is spliced into the output. The readers cannot
+**     use `splice`, since the workers need the data in memory.
+**
+** The results are written through `report.hpp`, under names such as
+** `pread_pwrite 1 readers 2 workers 1 writers`, with the fractions of time of
+** the stages as extra statistics.
+*/
+
+#ifndef ZE27688B8_ABE2_4730_A09A_80258AA61BF0
+#define ZE27688B8_ABE2_4730_A09A_80258AA61BF0
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/platform.hpp>
+
+#include <configuration.hpp>
+#include <consumer.hpp>
+#include <copy_common.hpp>
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <test.hpp>
+#include <trace.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <sys/uio.h>
+#endif
+
+enum class pipeline_io
+{
+	pread,
+	pwrite,
+	direct,
+	splice
+};
+
+static const char*
+pipeline_io_name(pipeline_io m)
+{
+	switch (m) {
+	case pipeline_io::pread:  return "pread";
+	case pipeline_io::pwrite: return "pwrite";
+	case pipeline_io::direct: return "direct";
+	case pipeline_io::splice: return "splice";
+	}
+	return "unknown";
+}
+
+static pipeline_io
+parse_read_io(const std::string& s)
+{
+	if (s == "pread")  { return pipeline_io::pread; }
+	if (s == "direct") { return pipeline_io::direct; }
+	throw std::invalid_argument{cc::format("invalid read mode \"$\"", s)};
+}
+
+static pipeline_io
+parse_write_io(const std::string& s)
+{
+	if (s == "pwrite") { return pipeline_io::pwrite; }
+	if (s == "direct") { return pipeline_io::direct; }
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	if (s == "splice") { return pipeline_io::splice; }
+#endif
+	throw std::invalid_argument{cc::format("invalid write mode \"$\"", s)};
+}
+
+struct pipeline_options
+{
+	std::vector<pipeline_io> read_modes{pipeline_io::pread};
+	std::vector<pipeline_io> write_modes{pipeline_io::pwrite};
+	std::vector<consumer_stage> consumers{consumer_stage{consumer_kind::crc32c}};
+	std::vector<size_t> block_sizes{1 << 20};
+	// Capacity of each queue between two stages.
+	std::vector<unsigned> queue_depths{4};
+	std::vector<unsigned> readers{1};
+	std::vector<unsigned> workers{1, 2, 4};
+	std::vector<unsigned> writers{1};
+	const char* input{nullptr};
+	const char* output{"data/pipeline.bin"};
+};
+
+struct pipeline_config
+{
+	pipeline_io read_mode;
+	pipeline_io write_mode;
+	size_t block_size;
+	unsigned queue_depth;
+	unsigned readers;
+	unsigned workers;
+	unsigned writers;
+};
+
+/*
+** The time spent by the threads of a stage, in seconds, or as a fraction of
+** the total time of the threads once divided by it.
+*/
+struct stage_times
+{
+	double busy{0};
+	double starved{0};
+	double blocked{0};
+
+	stage_times& operator+=(const stage_times& rhs) noexcept
+	{
+		busy += rhs.busy;
+		starved += rhs.starved;
+		blocked += rhs.blocked;
+		return *this;
+	}
+
+	stage_times& operator/=(double x) noexcept
+	{
+		busy /= x;
+		starved /= x;
+		blocked /= x;
+		return *this;
+	}
+};
+
+struct pipeline_stats
+{
+	// Duration of the trial, in milliseconds.
+	double time;
+	stage_times read;
+	stage_times transform;
+	stage_times write;
+};
+
+/*
+** A bounded multi-producer, multi-consumer queue of buffer indices, after the
+** design of Dmitry Vyukov. Each cell carries a sequence number that tells
+** whether it is ready to be written or read at the current position, so that
+** `try_push` and `try_pop` each take a single compare-and-swap on a shared
+** position, and fail instead of waiting if the queue is full or empty.
+*/
+class index_queue
+{
+	struct cell
+	{
+		std::atomic<size_t> seq;
+		unsigned value;
+	};
+
+	std::unique_ptr<cell[]> m_cells;
+	size_t m_capacity;
+	// The positions are kept on separate cache lines. Padding is used
+	// instead of `alignas`, since the queues are allocated with `new`.
+	char m_pad1[cache_line_size];
+	std::atomic<size_t> m_head{0};
+	char m_pad2[cache_line_size];
+	std::atomic<size_t> m_tail{0};
+	char m_pad3[cache_line_size];
+public:
+	explicit index_queue(size_t capacity) :
+	m_cells{new cell[capacity]}, m_capacity{capacity}
+	{
+		assert(capacity != 0);
+		for (auto i = size_t{0}; i != capacity; ++i) {
+			m_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	index_queue(const index_queue&) = delete;
+	index_queue& operator=(const index_queue&) = delete;
+
+	bool try_push(unsigned v) noexcept
+	{
+		auto pos = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& c = m_cells[pos % m_capacity];
+			auto seq = c.seq.load(std::memory_order_acquire);
+			auto d = ptrdiff_t(seq - pos);
+			if (d == 0) {
+				if (m_tail.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				{
+					c.value = v;
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (d < 0) {
+				return false;
+			}
+			else {
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop(unsigned& v) noexcept
+	{
+		auto pos = m_head.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& c = m_cells[pos % m_capacity];
+			auto seq = c.seq.load(std::memory_order_acquire);
+			auto d = ptrdiff_t(seq - (pos + 1));
+			if (d == 0) {
+				if (m_head.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+				{
+					v = c.value;
+					c.seq.store(pos + m_capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (d < 0) {
+				return false;
+			}
+			else {
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+/*
+** The input or output of the pipeline, along with the alignment required for
+** the buffers and for the offsets and lengths of its IOs.
+*/
+struct stage_file
+{
+	int fd;
+	size_t memory_align;
+	size_t offset_align;
+};
+
+static stage_file
+open_stage_file(const char* path, int flags, pipeline_io m)
+{
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	if (m == pipeline_io::direct) {
+		auto f = open_direct(path, flags);
+		return {f.fd, f.align.memory, f.align.offset};
+	}
+#endif
+	auto f = stage_file{safe_open(path, flags).get(), 1, 1};
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	if (m == pipeline_io::direct) {
+		disable_cache(f.fd);
+		f.memory_align = 4096;
+	}
+#endif
+	return f;
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+/*
+** Writes the `n` bytes at `p` to `fd` at offset `off` through the pipe whose
+** ends are `pipe_r` and `pipe_w`. The pipe is drained after each call to
+** `vmsplice`, so once this returns the data has been copied into the page
+** cache, and the buffer can be reused.
+*/
+static void
+splice_write(int fd, int pipe_r, int pipe_w, uint8_t* p, size_t n, off_t off)
+{
+	while (n != 0) {
+		auto iov = iovec{p, n};
+		auto t = trace_begin();
+		auto r = ::vmsplice(pipe_w, &iov, 1, 0);
+		trace_end(trace_op::splice, off, n, t, r);
+		if (r == -1) {
+			if (errno == EINTR) { continue; }
+			throw current_system_error();
+		}
+
+		for (auto c = ssize_t{0}; c < r;) {
+			auto o = off;
+			t = trace_begin();
+			auto s = ::splice(pipe_r, nullptr, fd, &off, r - c, SPLICE_F_MOVE);
+			trace_end(trace_op::splice, o, r - c, t, s);
+			if (s == -1) {
+				if (errno == EINTR) { continue; }
+				throw current_system_error();
+			}
+			c += s;
+		}
+		p += r;
+		n -= r;
+	}
+}
+
+#endif
+
+namespace detail {
+
+/*
+** Calls `f` until it returns true, yielding in between, and adds the time
+** spent waiting to `t`. Returns false if `failed` is set in the meantime.
+*/
+template <class Function>
+static bool
+wait_until(const Function& f, double& t, const std::atomic<bool>& failed)
+{
+	using clock = std::chrono::steady_clock;
+
+	if (f()) { return true; }
+	auto t1 = clock::now();
+	while (!f()) {
+		if (failed.load(std::memory_order_relaxed)) { return false; }
+		std::this_thread::yield();
+	}
+	t += std::chrono::duration<double>{clock::now() - t1}.count();
+	return true;
+}
+
+}
+
+/*
+** Runs the pipeline once, copying `src` to `dst` with `current_consumer` as
+** the transform.
+*/
+static pipeline_stats
+run_pipeline(const pipeline_config& c, const char* src, const char* dst)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto seconds = [](clock::time_point t1) {
+		return std::chrono::duration<double>{clock::now() - t1}.count();
+	};
+
+	auto in = open_stage_file(src, O_RDONLY, c.read_mode);
+	auto out = open_stage_file(dst, O_RDWR | O_CREAT | O_TRUNC, c.write_mode);
+	auto fs = file_size(in.fd).get();
+
+	// The alignments are powers of two, so the larger is a multiple of the
+	// smaller.
+	auto align = std::max(in.offset_align, out.offset_align);
+	auto bs = (c.block_size + align - 1) / align * align;
+	auto blocks = size_t((fs + bs - 1) / bs);
+
+	// Enough buffers for each thread to hold one, and for every queue to
+	// be full.
+	auto buffers = c.readers + c.workers + c.writers +
+		(1 + c.writers) * c.queue_depth;
+	auto pool = allocate_aligned(std::max({in.memory_align,
+		out.memory_align, size_t{4096}}), buffers * bs);
+	auto buf = [&](unsigned b) { return pool.get() + size_t(b) * bs; };
+	auto lengths = std::vector<size_t>(buffers);
+	auto seqs = std::vector<size_t>(buffers);
+
+	index_queue free_q{buffers};
+	for (auto b = 0u; b != buffers; ++b) { free_q.try_push(b); }
+	index_queue read_q{c.queue_depth};
+	auto write_qs = std::vector<std::unique_ptr<index_queue>>{};
+	for (auto w = 0u; w != c.writers; ++w) {
+		write_qs.emplace_back(new index_queue{c.queue_depth});
+	}
+
+	std::atomic<size_t> next_read{0};
+	std::atomic<size_t> next_transform{0};
+	std::atomic<bool> failed{false};
+
+	auto threads = c.readers + c.workers + c.writers;
+	auto times = std::vector<stage_times>(threads);
+	auto errors = std::vector<std::exception_ptr>(threads);
+
+	auto read = [&](unsigned t) {
+		auto& st = times[t];
+		for (;;) {
+			auto b = 0u;
+			if (!detail::wait_until([&] { return free_q.try_pop(b); },
+				st.blocked, failed)) { return; }
+
+			auto i = next_read.fetch_add(1, std::memory_order_relaxed);
+			if (i >= blocks) {
+				free_q.try_push(b);
+				return;
+			}
+
+			auto t1 = clock::now();
+			lengths[b] = full_read(in.fd, buf(b), bs, off_t(i * bs)).get();
+			seqs[b] = i;
+			st.busy += seconds(t1);
+
+			if (!detail::wait_until([&] { return read_q.try_push(b); },
+				st.blocked, failed)) { return; }
+		}
+	};
+
+	auto transform = [&](unsigned t) {
+		auto& st = times[t];
+		while (next_transform.fetch_add(1, std::memory_order_relaxed) < blocks) {
+			auto b = 0u;
+			if (!detail::wait_until([&] { return read_q.try_pop(b); },
+				st.starved, failed)) { return; }
+
+			auto t1 = clock::now();
+			consume(buf(b), lengths[b]);
+			st.busy += seconds(t1);
+
+			auto& q = *write_qs[seqs[b] % c.writers];
+			if (!detail::wait_until([&] { return q.try_push(b); },
+				st.blocked, failed)) { return; }
+		}
+	};
+
+	auto write = [&](unsigned t, unsigned w) {
+		auto& st = times[t];
+		auto& q = *write_qs[w];
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		auto pipe_r = -1;
+		auto pipe_w = -1;
+		if (c.write_mode == pipeline_io::splice) {
+			std::tie(pipe_r, pipe_w) = make_pipe().get();
+			// Larger pipes take fewer calls per block, but may not be
+			// permitted.
+			::fcntl(pipe_w, F_SETPIPE_SZ, int(std::min(bs, size_t{1} << 20)));
+		}
+	#endif
+
+		// The blocks that arrived before their turn, indexed by their
+		// position among the blocks of this writer. There are only
+		// `buffers` blocks in flight, so this never wraps around.
+		auto early = std::vector<int>(buffers, -1);
+		auto slot = [&](size_t i) { return (i / c.writers) % buffers; };
+
+		for (auto i = size_t{w}; i < blocks; i += c.writers) {
+			while (early[slot(i)] == -1) {
+				auto b = 0u;
+				if (!detail::wait_until([&] { return q.try_pop(b); },
+					st.starved, failed)) { return; }
+				early[slot(seqs[b])] = int(b);
+			}
+			auto b = unsigned(early[slot(i)]);
+			early[slot(i)] = -1;
+
+			auto t1 = clock::now();
+			auto n = lengths[b];
+			auto off = off_t(i * bs);
+			switch (c.write_mode) {
+			case pipeline_io::direct: {
+				auto m = (n + out.offset_align - 1) / out.offset_align *
+					out.offset_align;
+				std::memset(buf(b) + n, 0, m - n);
+				full_write(out.fd, buf(b), m, off).get();
+				break;
+			}
+		#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+			case pipeline_io::splice:
+				splice_write(out.fd, pipe_r, pipe_w, buf(b), n, off);
+				break;
+		#endif
+			default:
+				full_write(out.fd, buf(b), n, off).get();
+			}
+			st.busy += seconds(t1);
+
+			auto r = free_q.try_push(b);
+			assert(r);
+			(void)r;
+		}
+
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		if (pipe_r != -1) {
+			::close(pipe_r);
+			::close(pipe_w);
+		}
+	#endif
+	};
+
+	auto guard = [&](unsigned t, auto f) {
+		try { f(); }
+		catch (...) {
+			errors[t] = std::current_exception();
+			failed.store(true, std::memory_order_relaxed);
+		}
+	};
+
+	auto start = clock::now();
+	auto ts = std::vector<std::thread>{};
+	auto t = 0u;
+	for (auto i = 0u; i != c.readers; ++i, ++t) {
+		ts.emplace_back([&, t] { guard(t, [&] { read(t); }); });
+	}
+	for (auto i = 0u; i != c.workers; ++i, ++t) {
+		ts.emplace_back([&, t] { guard(t, [&] { transform(t); }); });
+	}
+	for (auto i = 0u; i != c.writers; ++i, ++t) {
+		ts.emplace_back([&, t, i] { guard(t, [&] { write(t, i); }); });
+	}
+	for (auto& th : ts) { th.join(); }
+	auto wall = seconds(start);
+
+	for (const auto& e : errors) {
+		if (e) { std::rethrow_exception(e); }
+	}
+	if (out.offset_align != 1) { truncate(out.fd, fs); }
+	safe_close(in.fd).get();
+	safe_close(out.fd).get();
+
+	auto r = pipeline_stats{1000 * wall, {}, {}, {}};
+	auto sum = [&](unsigned first, unsigned n) {
+		auto s = stage_times{};
+		for (auto i = first; i != first + n; ++i) { s += times[i]; }
+		s /= n * wall;
+		return s;
+	};
+	r.read = sum(0, c.readers);
+	r.transform = sum(c.readers, c.workers);
+	r.write = sum(c.readers + c.workers, c.writers);
+	return r;
+}
+
+/*
+** Returns the name under which the results for the configuration `c` are
+** reported. The block size, queue depth, and consumer stage are added to it by
+** `report_result`.
+*/
+static std::string
+pipeline_config_name(const pipeline_config& c)
+{
+	return std::string{pipeline_io_name(c.read_mode)} + "_" +
+		pipeline_io_name(c.write_mode) + " " + std::to_string(c.readers) +
+		" readers " + std::to_string(c.workers) + " workers " +
+		std::to_string(c.writers) + " writers";
+}
+
+/*
+** Times the pipeline with the configuration `c`, and reports the results. The
+** fractions of time reported for the stages are the means over the timed
+** trials.
+*/
+static void
+run_pipeline_config(const pipeline_options& o, const pipeline_config& c)
+{
+	auto fd = safe_open(o.input, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	safe_close(fd).get();
+
+	auto stats = std::vector<pipeline_stats>{};
+	auto s = sample_trials(
+		[&]() {
+			stats.push_back(run_pipeline(c, o.input, o.output));
+			return stats.back().time;
+		},
+		[]() { purge_cache().get(); }
+	);
+
+	auto mean = pipeline_stats{s.median, {}, {}, {}};
+	auto n = double(s.times.size());
+	for (auto i = stats.size() - s.times.size(); i != stats.size(); ++i) {
+		mean.read += stats[i].read;
+		mean.transform += stats[i].transform;
+		mean.write += stats[i].write;
+	}
+	mean.read /= n;
+	mean.transform /= n;
+	mean.write /= n;
+
+	auto name = pipeline_config_name(c);
+	report_result(name.c_str(), c.block_size, c.queue_depth, fs, s, {
+		{"read_busy", mean.read.busy},
+		{"read_blocked", mean.read.blocked},
+		{"transform_busy", mean.transform.busy},
+		{"transform_starved", mean.transform.starved},
+		{"transform_blocked", mean.transform.blocked},
+		{"write_busy", mean.write.busy},
+		{"write_starved", mean.write.starved}
+	});
+}
+
+static void
+run_pipelines(const pipeline_options& o)
+{
+	begin_report(capture_environment({o.input, o.output}), result_kind::io,
+		{"Read Busy", "Read Blocked", "Transform Busy", "Transform Starved",
+		"Transform Blocked", "Write Busy", "Write Starved"});
+
+	for (const auto& con : o.consumers) {
+		current_consumer = con;
+		for (const auto& rm : o.read_modes) {
+		for (const auto& wm : o.write_modes) {
+		for (const auto& bs : o.block_sizes) {
+		for (const auto& qd : o.queue_depths) {
+		for (const auto& r : o.readers) {
+		for (const auto& t : o.workers) {
+		for (const auto& w : o.writers) {
+			run_pipeline_config(o, {rm, wm, bs, qd, r, t, w});
+		}}}}}}}
+	}
+	current_consumer = consumer_stage{};
+	end_report();
+}
+
+static void
+print_pipeline_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] file\n"
+"\n"
+"Copies the file through a pipeline of reader, worker, and writer threads, and\n"
+"reports the throughput along with the fractions of time for which each stage\n"
+"was busy, starved for input, and blocked by the stages after it.\n"
+"\n"
+"Options:\n"
+"  -r, --read-modes MODE[,MODE]  How the readers read: pread, direct.\n"
+"  -w, --write-modes MODE[,MODE] How the writers write: pwrite, direct, splice.\n"
+"  -C, --consumers LIST          Work done by the workers on each block: count,\n"
+"                                crc32c (default), hash, copy, or burn:N.\n"
+"  -b, --block-sizes LIST        Block sizes (default: 1M).\n"
+"  -q, --queue-depths LIST       Capacity of the queues between the stages\n"
+"                                (default: 4).\n"
+"  -R, --readers N[,N...]        Numbers of reader threads (default: 1).\n"
+"  -t, --workers N[,N...]        Numbers of worker threads (default: 1,2,4).\n"
+"  -W, --writers N[,N...]        Numbers of writer threads (default: 1).\n"
+"  -o, --output PATH             File written by the pipeline\n"
+"                                (default: data/pipeline.bin).\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"  -n, --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static std::vector<unsigned>
+parse_thread_counts(const char* s)
+{
+	auto r = std::vector<unsigned>{};
+	for (const auto& n : split(s, ',')) {
+		auto x = parse_count(n.c_str());
+		if (x == 0) {
+			throw std::invalid_argument{"number of threads must be positive"};
+		}
+		r.push_back(x);
+	}
+	return r;
+}
+
+static int
+pipeline_main(int argc, char** argv)
+{
+	auto o = pipeline_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_pipeline_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-r", "--read-modes")) {
+				o.read_modes.clear();
+				for (const auto& m : split(value(), ',')) {
+					o.read_modes.push_back(parse_read_io(m));
+				}
+			}
+			else if (is_option(a, "-w", "--write-modes")) {
+				o.write_modes.clear();
+				for (const auto& m : split(value(), ',')) {
+					o.write_modes.push_back(parse_write_io(m));
+				}
+			}
+			else if (is_option(a, "-C", "--consumers")) {
+				o.consumers.clear();
+				for (const auto& c : split(value(), ',')) {
+					o.consumers.push_back(parse_consumer(c));
+				}
+			}
+			else if (is_option(a, "-b", "--block-sizes")) {
+				o.block_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-q", "--queue-depths")) {
+				o.queue_depths = parse_depth_list(value());
+			}
+			else if (is_option(a, "-R", "--readers")) {
+				o.readers = parse_thread_counts(value());
+			}
+			else if (is_option(a, "-t", "--workers")) {
+				o.workers = parse_thread_counts(value());
+			}
+			else if (is_option(a, "-W", "--writers")) {
+				o.writers = parse_thread_counts(value());
+			}
+			else if (is_option(a, "-o", "--output")) {
+				o.output = value();
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, "-n", "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else if (o.input != nullptr) {
+				throw std::invalid_argument{"more than one file given"};
+			}
+			else {
+				o.input = a;
+			}
+		}
+
+		if (o.input == nullptr) {
+			throw std::invalid_argument{"no input file given"};
+		}
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	try {
+		run_pipelines(o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to copy \"$\" to \"$\": $.", o.input, o.output,
+			e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,387 @@
+/*
+** File Name:	placement.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Controls where the buffers and threads of the double-buffer engines
+** (`async_read_loop`, `async_write_loop`, and `async_copy_loop`) are placed.
+** On a multi-socket machine, handing a buffer that was filled on one socket to
+** a thread on another adds the cost of moving it across the interconnect, and
+** the latency of each handoff through `cv1` and `cv2` depends on whether the
+** two threads share a core, an L3 cache, or neither. None of this is visible
+** unless the placement is fixed. Memory is bound with the `mbind` system call
+** directly, so libnuma is not required. On OS X, which has neither a NUMA API
+** nor thread affinity, all placements are ignored.
+*/
+
+#ifndef Z200C6611_9620_4E68_8765_DF4ED676DB62
+#define Z200C6611_9620_4E68_8765_DF4ED676DB62
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/platform.hpp>
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	#include <sched.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+/*
+** A placement of the buffers and threads of an engine. A node of -1 means
+** that the corresponding resource is left to the kernel.
+*/
+struct placement
+{
+	// Label used in the results. Empty for the default placement.
+	std::string name;
+	// Node to which the buffers are bound.
+	int buffer_node{-1};
+	// Node of the worker thread spawned by the engine, which issues IO.
+	int io_node{-1};
+	// Node of the thread that runs the engine. For read engines, this is
+	// the thread that consumes the data; for write engines, the one that
+	// produces it.
+	int consumer_node{-1};
+	// CPUs of the two threads. These take precedence over the nodes.
+	int io_cpu{-1};
+	int consumer_cpu{-1};
+};
+
+// The placement used by the engines. This is set by the driver while it
+// sweeps over placements.
+static auto current_placement = placement{};
+
+/*
+** Parses a list of the form `0-3,5` (as used in sysfs) into its elements.
+*/
+static std::vector<int>
+parse_cpu_list(const std::string& s)
+{
+	auto r = std::vector<int>{};
+	if (s == "unknown" || s.empty()) { return r; }
+
+	for (const auto& tok : split(s.c_str(), ',')) {
+		auto dash = tok.find('-');
+		auto lo = std::stoi(tok.substr(0, dash));
+		auto hi = dash == std::string::npos ? lo : std::stoi(tok.substr(dash + 1));
+		for (auto i = lo; i <= hi; ++i) { r.push_back(i); }
+	}
+	return r;
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+static unsigned
+numa_node_count()
+{
+	auto v = parse_cpu_list(read_line("/sys/devices/system/node/online"));
+	return v.empty() ? 1 : v.back() + 1;
+}
+
+static std::vector<int>
+node_cpus(int node)
+{
+	auto path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+	return parse_cpu_list(read_line(path.c_str()));
+}
+
+/*
+** Binds the pages that lie entirely within `[p, p + n)` to `node` if it is
+** nonnegative, and moves any of them that have already been touched. Since
+** buffers allocated with `new` need not be page-aligned, the partial pages at
+** either end are left alone.
+**
+** The buffers come from the heap, which keeps the memory mapped after they are
+** freed, so the policy would otherwise apply to later allocations as well. When
+** the object is destroyed, which must happen before the buffer is freed, the
+** pages are released and the range is given the default policy again.
+*/
+class buffer_binding
+{
+	static constexpr auto mpol_default  = 0;
+	static constexpr auto mpol_bind     = 2;
+	static constexpr auto mpol_mf_move  = 1 << 1;
+	static constexpr auto mask_bits     = 1024;
+
+	uintptr_t m_first{0};
+	uintptr_t m_last{0};
+public:
+	explicit buffer_binding(uint8_t* p, size_t n, int node)
+	{
+		if (node < 0) { return; }
+		if (node >= mask_bits) { throw std::invalid_argument{"invalid NUMA node"}; }
+
+		auto ps = uintptr_t(::sysconf(_SC_PAGESIZE));
+		auto f = (uintptr_t(p) + ps - 1) / ps * ps;
+		auto l = (uintptr_t(p) + n) / ps * ps;
+		if (f >= l) { return; }
+
+		auto mask = std::array<unsigned long, mask_bits / (8 * sizeof(unsigned long))>{};
+		mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+
+		// The kernel ignores the last bit of the mask, hence the + 1.
+		if (::syscall(SYS_mbind, f, l - f, mpol_bind, mask.data(),
+			mask_bits + 1, mpol_mf_move) == -1)
+		{
+			throw current_system_error();
+		}
+		m_first = f;
+		m_last = l;
+	}
+
+	buffer_binding(const buffer_binding&) = delete;
+	buffer_binding& operator=(const buffer_binding&) = delete;
+
+	~buffer_binding()
+	{
+		if (m_first == m_last) { return; }
+		// The pages that were placed on the node are dropped, so that
+		// the next allocation to reuse the range faults in new ones.
+		::madvise((void*)m_first, m_last - m_first, MADV_DONTNEED);
+		::syscall(SYS_mbind, m_first, m_last - m_first, mpol_default,
+			nullptr, 0, 0);
+	}
+};
+
+static std::vector<int>
+online_cpus()
+{ return parse_cpu_list(read_line("/sys/devices/system/cpu/online")); }
+
+/*
+** Returns the CPUs excluded from the scheduler with the `isolcpus` boot
+** parameter. These are the natural choice for pinned IO threads.
+*/
+static std::vector<int>
+isolated_cpus()
+{ return parse_cpu_list(read_line("/sys/devices/system/cpu/isolated")); }
+
+static std::string
+cpu_attribute(int cpu, const std::string& name)
+{
+	auto path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/" + name;
+	return read_line(path.c_str());
+}
+
+static std::vector<int>
+smt_siblings(int cpu)
+{ return parse_cpu_list(cpu_attribute(cpu, "topology/thread_siblings_list")); }
+
+static std::vector<int>
+l3_siblings(int cpu)
+{
+	for (auto i = 0; i != 8; ++i) {
+		auto dir = "cache/index" + std::to_string(i) + "/";
+		if (cpu_attribute(cpu, dir + "level") == "3") {
+			return parse_cpu_list(cpu_attribute(cpu, dir + "shared_cpu_list"));
+		}
+	}
+	return {};
+}
+
+/*
+** Restricts the calling thread to `cpu` if it is nonnegative, and otherwise to
+** the CPUs of `node` if it is nonnegative. The previous affinity is restored
+** when the object is destroyed.
+*/
+class thread_binding
+{
+	cpu_set_t m_old;
+	bool m_bound{false};
+public:
+	explicit thread_binding(int cpu, int node)
+	{
+		if (cpu < 0 && node < 0) { return; }
+
+		auto cpus = cpu >= 0 ? std::vector<int>{cpu} : node_cpus(node);
+		if (cpus.empty()) { throw std::invalid_argument{"invalid NUMA node"}; }
+
+		auto s = cpu_set_t{};
+		CPU_ZERO(&s);
+		for (const auto& c : cpus) { CPU_SET(c, &s); }
+
+		if (::sched_getaffinity(0, sizeof(m_old), &m_old) == -1) {
+			throw current_system_error();
+		}
+		if (::sched_setaffinity(0, sizeof(s), &s) == -1) {
+			throw current_system_error();
+		}
+		m_bound = true;
+	}
+
+	thread_binding(const thread_binding&) = delete;
+	thread_binding& operator=(const thread_binding&) = delete;
+
+	~thread_binding()
+	{ if (m_bound) { ::sched_setaffinity(0, sizeof(m_old), &m_old); } }
+};
+
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+
+static unsigned
+numa_node_count()
+{ return 1; }
+
+static std::vector<int>
+online_cpus()
+{ return {}; }
+
+static std::vector<int>
+isolated_cpus()
+{ return {}; }
+
+static std::vector<int>
+smt_siblings(int)
+{ return {}; }
+
+static std::vector<int>
+l3_siblings(int)
+{ return {}; }
+
+static std::string
+cpu_attribute(int, const std::string&)
+{ return "unknown"; }
+
+class buffer_binding
+{
+public:
+	explicit buffer_binding(uint8_t*, size_t, int) {}
+	buffer_binding(const buffer_binding&) = delete;
+	buffer_binding& operator=(const buffer_binding&) = delete;
+};
+
+class thread_binding
+{
+public:
+	explicit thread_binding(int, int) {}
+	thread_binding(const thread_binding&) = delete;
+	thread_binding& operator=(const thread_binding&) = delete;
+};
+
+#endif
+
+/*
+** Finds a pair of CPUs `(c, i)` for the consumer and IO threads that are in the
+** relation named by `kind`:
+**
+**   - `smt`: SMT siblings on the same core.
+**   - `l3`: different cores that share an L3 cache.
+**   - `socket`: different packages.
+**
+** Isolated CPUs are preferred if there are at least two of them.
+*/
+static placement
+topology_placement(const std::string& kind)
+{
+	auto cpus = isolated_cpus();
+	if (cpus.size() < 2) { cpus = online_cpus(); }
+
+	auto contains = [](const std::vector<int>& v, int x) {
+		return std::find(v.begin(), v.end(), x) != v.end();
+	};
+	auto related = [&](int c, int i) {
+		if (kind == "smt") { return contains(smt_siblings(c), i); }
+		if (kind == "l3") {
+			return contains(l3_siblings(c), i) && !contains(smt_siblings(c), i);
+		}
+		return cpu_attribute(c, "topology/physical_package_id") !=
+			cpu_attribute(i, "topology/physical_package_id");
+	};
+
+	for (const auto& c : cpus) {
+		for (const auto& i : cpus) {
+			if (c == i || !related(c, i)) { continue; }
+			auto p = placement{};
+			p.consumer_cpu = c;
+			p.io_cpu = i;
+			p.name = kind + "-c" + std::to_string(c) + "-i" + std::to_string(i);
+			return p;
+		}
+	}
+	throw std::invalid_argument{cc::format("no pair of CPUs for placement \"$\"", kind)};
+}
+
+static std::string
+placement_name(const placement& p)
+{
+	auto node = [](int n) { return n < 0 ? std::string{"*"} : std::to_string(n); };
+	return "b" + node(p.buffer_node) + "-i" + node(p.io_node) + "-c" +
+		node(p.consumer_node);
+}
+
+/*
+** Parses a comma-separated list of placements. Each element is one of:
+**
+**   - `B:I:C`, giving the nodes of the buffers, the IO thread, and the consumer
+**   thread. Each node is either a number or `*`.
+**   - `sweep`, which expands to every combination of nodes on this machine.
+**   - `smt`, `l3`, or `socket`, which pin the two threads to a pair of CPUs in
+**   the given relation (see `topology_placement`).
+**   - `topology`, which expands to those of `smt`, `l3`, and `socket` that
+**   exist on this machine.
+*/
+static std::vector<placement>
+parse_placements(const char* s)
+{
+	auto r = std::vector<placement>{};
+	auto n = int(numa_node_count());
+	auto add = [&](int b, int i, int c) {
+		auto p = placement{"", b, i, c};
+		p.name = placement_name(p);
+		r.push_back(p);
+	};
+	auto node = [&](const std::string& t) {
+		if (t == "*") { return -1; }
+		auto x = int(parse_size(t.c_str()));
+		if (x >= n) {
+			throw std::invalid_argument{cc::format("invalid NUMA node \"$\"", t)};
+		}
+		return x;
+	};
+
+	for (const auto& tok : split(s, ',')) {
+		if (tok == "sweep") {
+			for (auto b = 0; b != n; ++b) {
+				for (auto i = 0; i != n; ++i) {
+					for (auto c = 0; c != n; ++c) { add(b, i, c); }
+				}
+			}
+			continue;
+		}
+		if (tok == "smt" || tok == "l3" || tok == "socket") {
+			r.push_back(topology_placement(tok));
+			continue;
+		}
+		if (tok == "topology") {
+			auto added = r.size();
+			for (const auto& k : {"smt", "l3", "socket"}) {
+				try { r.push_back(topology_placement(k)); }
+				catch (const std::invalid_argument&) {}
+			}
+			if (r.size() == added) {
+				throw std::invalid_argument{"no CPU placements on this machine"};
+			}
+			continue;
+		}
+
+		auto f = split(tok.c_str(), ':');
+		if (f.size() != 3) {
+			throw std::invalid_argument{cc::format("invalid placement \"$\"", tok)};
+		}
+		add(node(f[0]), node(f[1]), node(f[2]));
+	}
+	return r;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+** File Name:	profile.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** A tuning profile records the fastest configuration found by `out/tune.run`
+** for each kind of operation and file size on one machine. The profile is a
+** text file with one configuration per line, of the form
+**
+**   kind file_size engine block_size queue_depth median_ms throughput_mbps
+**
+** preceded by comment lines beginning with `#` that describe the environment in
+** which it was measured.
+*/
+
+#ifndef ZC5AD4AA5_6859_423B_B2D3_60C76589340A
+#define ZC5AD4AA5_6859_423B_B2D3_60C76589340A
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <registry.hpp>
+#include <report.hpp>
+
+struct profile_entry
+{
+	engine_kind kind;
+	off_t       file_size;
+	std::string engine;
+	// Zero if the engine is not blocked.
+	size_t      block_size;
+	// Zero if the engine is not queued.
+	unsigned    queue_depth;
+	double      median_ms;
+	double      throughput_mbps;
+};
+
+using tuning_profile = std::vector<profile_entry>;
+
+static void
+write_profile(const char* path, const environment& e, const tuning_profile& p)
+{
+	auto f = std::fopen(path, "w");
+	if (f == nullptr) { throw current_system_error(); }
+
+	std::fprintf(f, "# Tuning profile written by tune.run. Each line has the form\n"
+		"#   kind file_size engine block_size queue_depth median_ms throughput_mbps\n");
+	print_environment(f, e);
+	for (const auto& x : p) {
+		std::fprintf(f, "%s %jd %s %zu %u %f %f\n", kind_name(x.kind),
+			(intmax_t)x.file_size, x.engine.c_str(), x.block_size,
+			x.queue_depth, x.median_ms, x.throughput_mbps);
+	}
+
+	if (std::fclose(f) != 0) { throw current_system_error(); }
+}
+
+static tuning_profile
+read_profile(const char* path)
+{
+	auto is = std::ifstream{path};
+	if (!is) {
+		throw std::runtime_error{"Failed to open profile \"" +
+			std::string{path} + "\"."};
+	}
+
+	auto p = tuning_profile{};
+	auto s = std::string{};
+	auto line = 0u;
+
+	while (std::getline(is, s)) {
+		++line;
+		if (s.empty() || s[0] == '#') { continue; }
+
+		auto ss = std::istringstream{s};
+		auto x = profile_entry{};
+		auto k = std::string{};
+		auto fs = intmax_t{};
+		ss >> k >> fs >> x.engine >> x.block_size >> x.queue_depth >>
+			x.median_ms >> x.throughput_mbps;
+		if (!ss) {
+			throw std::runtime_error{"Malformed line " +
+				std::to_string(line) + " in profile \"" +
+				std::string{path} + "\"."};
+		}
+		x.kind = parse_kind(k);
+		x.file_size = fs;
+		p.push_back(std::move(x));
+	}
+	return p;
+}
+
+#endif
@@ -8,11 +8,18 @@
 #ifndef Z7FE6A1BA_51C8_492E_97C4_983095F7E88E
 #define Z7FE6A1BA_51C8_492E_97C4_983095F7E88E
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 #include <io_common.hpp>
 #include <configuration.hpp>
+#include <consumer.hpp>
+#include <placement.hpp>
+#include <reader.hpp>
+#include <registry.hpp>
 
 static auto
 read_loop(int fd, uint8_t* buf, size_t buf_size)
@@ -22,8 +29,7 @@ read_loop(int fd, uint8_t* buf, size_t buf_size)
 
 	for (;;) {
 		auto n = (size_t)full_read(fd, buf, buf_size, off).get();
-		count += std::count_if(buf, buf + n,
-			[](auto x) { return x == needle; });
+		count += consume(buf, n);
 		if (n < buf_size) { break; }
 		off += n;
 	}
@@ -43,10 +49,10 @@ aio_read_loop(int fd, uint8_t* buf1, uint8_t* buf2, size_t buf_size)
 	auto count = off_t{0};
 
 	auto buf1_active = true;
+	auto t = uint64_t{};
 	auto n = full_read(fd, buf1, buf_size, off).get();
 	if (size_t(n) < buf_size) {
-		return (off_t)std::count_if(buf1, buf1 + n,
-			[](auto x) { return x == needle; });
+		return (off_t)consume(buf1, n);
 	}
 	off += buf_size;
 
@@ -54,34 +60,33 @@ aio_read_loop(int fd, uint8_t* buf1, uint8_t* buf2, size_t buf_size)
 		if (buf1_active) {
 			cb.aio_buf = buf2;
 			cb.aio_offset = off;
+			t = trace_begin();
 			if (::aio_read(&cb) == -1) { throw current_system_error(); }
 
-			count += std::count_if(buf1, buf1 + buf_size,
-				[](auto x) { return x == needle; });
+			count += consume(buf1, buf_size);
 		}
 		else {
 			cb.aio_buf = buf1;
 			cb.aio_offset = off;
+			t = trace_begin();
 			if (::aio_read(&cb) == -1) { throw current_system_error(); }
 
-			count += std::count_if(buf2, buf2 + buf_size,
-				[](auto x) { return x == needle; });
+			count += consume(buf2, buf_size);
 		}
 
 		buf1_active = !buf1_active;
 		if (::aio_suspend(l.data(), 1, nullptr) == -1) { throw current_system_error(); }
 		if (::aio_error(&cb) == -1) { throw current_system_error(); }
 		n = ::aio_return(&cb);
+		trace_end(trace_op::aio_read, off, buf_size, t, n);
 		if (n == -1) { throw current_system_error(); }
 
 		if (size_t(n) < buf_size) {
 			if (buf1_active) {
-				count += std::count_if(buf1, buf1 + n,
-					[](auto x) { return x == needle; });
+				count += consume(buf1, n);
 			}
 			else {
-				count += std::count_if(buf2, buf2 + n,
-					[](auto x) { return x == needle; });
+				count += consume(buf2, n);
 			}
 			return count;
 		}
@@ -89,6 +94,22 @@ aio_read_loop(int fd, uint8_t* buf1, uint8_t* buf2, size_t buf_size)
 	}
 }
 
+/*
+** Like `aio_read_loop`, but keeps `depth` reads of `buf_size` bytes in flight
+** at once, so that the device sees a deeper queue. The buffer `buf` must hold
+** `depth * buf_size` bytes.
+*/
+static auto
+aio_queue_read_loop(int fd, uint8_t* buf, size_t buf_size, unsigned depth)
+{
+	auto count = off_t{0};
+	queued_read(fd, buf, buf_size, depth,
+		[&](const uint8_t* p, size_t n, off_t) {
+			count += consume(p, n);
+		});
+	return count;
+}
+
 static void
 read_worker(
 	int fd,
@@ -99,6 +120,7 @@ read_worker(
 	std::atomic<int>& cv2
 )
 {
+	thread_binding b{current_placement.io_cpu, current_placement.io_node};
 	auto r = int{};
 	auto off = off_t(buf_size);
 	auto buf1_active = true;
@@ -123,14 +145,18 @@ read_worker(
 static auto
 async_read_loop(int fd, uint8_t* buf1, uint8_t* buf2, size_t buf_size)
 {
+	thread_binding b{current_placement.consumer_cpu,
+		current_placement.consumer_node};
+	buffer_binding bb1{buf1, buf_size, current_placement.buffer_node};
+	buffer_binding bb2{buf2, buf_size, current_placement.buffer_node};
+
 	auto r = full_read(fd, buf1, buf_size, 0).get();
 	if (size_t(r) < buf_size) {
-		return (off_t)std::count_if(buf1, buf1 + r,
-			[](auto x) { return x == needle; });
+		return (off_t)consume(buf1, r);
 	}
 
-	std::atomic<int> cv1(buf_size);
-	std::atomic<int> cv2{-1};
+	alignas(cache_line_size) std::atomic<int> cv1(buf_size);
+	alignas(cache_line_size) std::atomic<int> cv2{-1};
 	auto count = off_t{0};
 	auto buf1_active = true;
 	auto t = std::thread(read_worker, fd, buf1, buf2, buf_size,
@@ -140,16 +166,14 @@ async_read_loop(int fd, uint8_t* buf1, uint8_t* buf2, size_t buf_size)
 		if (buf1_active) {
 			while (cv1.load(std::memory_order_acquire) == -1) {}
 			r = cv1.load(std::memory_order_relaxed);
-			count += std::count_if(buf1, buf1 + r,
-				[](auto x) { return x == needle; });
+			count += consume(buf1, r);
 			if (size_t(r) < buf_size) { goto exit; }
 			cv1.store(-1, std::memory_order_release);
 		}
 		else {
 			while (cv2.load(std::memory_order_acquire) == -1) {}
 			r = cv2.load(std::memory_order_relaxed);
-			count += std::count_if(buf2, buf2 + r,
-				[](auto x) { return x == needle; });
+			count += consume(buf2, r);
 			if (size_t(r) < buf_size) { goto exit; }
 			cv2.store(-1, std::memory_order_release);
 		}
@@ -160,9 +184,28 @@ exit:
 	return count;
 }
 
+/*
+** Reads the file using `file_reader` with the default options, so that the
+** strategy chosen by the reader can be compared to the fixed engines.
+*/
+static auto
+read_adaptive(const char* path)
+{
+	auto count = off_t{0};
+	file_reader r{path};
+	r.read([&](const uint8_t* p, size_t n, off_t) {
+		count += consume(p, n);
+	});
+	return count;
+}
+
 static auto
 check(const char* path)
 {
+	// The other stages contribute nothing to the values returned by the
+	// engines, and some of them are slow.
+	if (current_consumer.kind != consumer_kind::count) { return off_t{0}; }
+
 	static constexpr auto buf_size = 65536;
 	auto fd = safe_open(path, O_RDONLY).get();
 	auto buf = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
@@ -187,9 +230,399 @@ read_mmap_plain(const char* path)
 	auto fd = safe_open(path, O_RDONLY).get();
 	auto fs = file_size(fd).get();
 	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
-	auto count = std::count_if(p, p + fs, [](auto x) { return x == needle; });
+	auto count = consume(p, fs);
+	::munmap(p, fs);
+	return count;
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+/*
+** The direct engines round the block size up to the alignment required by the
+** file. The last read of a file whose size is not aligned is short, which the
+** loops treat as the end of the file.
+*/
+static auto
+read_direct(const char* path, size_t buf_size)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, bs);
+	auto count = read_loop(f.fd, buf.get(), bs);
+	::close(f.fd);
+	return count;
+}
+
+static auto
+read_fadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	fadvise_sequential_read(fd, fs);
+
+	auto count = read_loop(fd, buf.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+/*
+** Like `read_loop`, but keeps a window of `window` bytes ahead of the cursor in
+** the page cache; see `window_read`. If `window` is zero, then the window
+** adapts to the rate at which the blocks are consumed.
+*/
+static auto
+read_window_loop(int fd, uint8_t* buf, size_t buf_size, size_t window)
+{
+	auto count = off_t{0};
+	window_read(fd, buf, buf_size, window,
+		[&](const uint8_t* p, size_t n, off_t) {
+			count += consume(p, n);
+		});
+	return count;
+}
+
+static auto
+read_window(const char* path, size_t buf_size, unsigned blocks)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto buf = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto count = read_window_loop(fd, buf.get(), buf_size, blocks * buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_window_adaptive(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto buf = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto count = read_window_loop(fd, buf.get(), buf_size, 0);
+	::close(fd);
+	return count;
+}
+
+static auto
+aio_read_direct(const char* path, size_t buf_size)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf1 = allocate_aligned(f.align.memory, bs);
+	auto buf2 = allocate_aligned(f.align.memory, bs);
+	auto count = aio_read_loop(f.fd, buf1.get(), buf2.get(), bs);
+	::close(f.fd);
+	return count;
+}
+
+static auto
+aio_read_fadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto buf2 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	fadvise_sequential_read(fd, fs);
+
+	auto count = aio_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+aio_read_queue_direct(const char* path, size_t buf_size, unsigned depth)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	auto count = aio_queue_read_loop(f.fd, buf.get(), bs, depth);
+	::close(f.fd);
+	return count;
+}
+
+static auto
+aio_read_queue_fadvise(const char* path, size_t buf_size, unsigned depth)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	fadvise_sequential_read(fd, fs);
+
+	auto count = aio_queue_read_loop(fd, buf.get(), buf_size, depth);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_async_plain(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto buf2 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto count = async_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_async_direct(const char* path, size_t buf_size)
+{
+	auto f = open_direct(path, O_RDONLY | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf1 = allocate_aligned(f.align.memory, bs);
+	auto buf2 = allocate_aligned(f.align.memory, bs);
+	auto count = async_read_loop(f.fd, buf1.get(), buf2.get(), bs);
+	::close(f.fd);
+	return count;
+}
+
+static auto
+read_async_fadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	auto buf2 = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	fadvise_sequential_read(fd, fs);
+
+	auto count = async_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_mmap_direct(const char* path)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME | O_DIRECT).get();
+	auto fs = file_size(fd).get();
+	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	auto count = consume(p, fs);
 	::munmap(p, fs);
 	return count;
 }
 
+static auto
+read_mmap_fadvise(const char* path)
+{
+	auto fd = safe_open(path, O_RDONLY | O_NOATIME).get();
+	auto fs = file_size(fd).get();
+	fadvise_sequential_read(fd, fs);
+
+	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	auto count = consume(p, fs);
+	::munmap(p, fs);
+	return count;
+}
+
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+
+static auto
+read_nocache(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+
+	auto count = read_loop(fd, buf.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_rdahead(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdahead(fd);
+
+	auto count = read_loop(fd, buf.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_rdadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	auto buf = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdadvise(fd, fs);
+
+	auto count = read_loop(fd, buf.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_aio_nocache(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf1 = allocate_aligned(4096, buf_size);
+	auto buf2 = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+
+	auto count = aio_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_aio_queue_nocache(const char* path, size_t buf_size, unsigned depth)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf = allocate_aligned(4096, depth * buf_size);
+	disable_cache(fd);
+
+	auto count = aio_queue_read_loop(fd, buf.get(), buf_size, depth);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_aio_rdahead(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	auto buf2 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdahead(fd);
+
+	auto count = aio_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_aio_rdadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	auto buf2 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdadvise(fd, fs);
+
+	auto count = aio_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_async_nocache(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf1 = allocate_aligned(4096, buf_size);
+	auto buf2 = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+
+	auto count = async_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_async_rdahead(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	auto buf2 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdahead(fd);
+
+	auto count = async_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_async_rdadvise(const char* path, size_t buf_size)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	auto buf1 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	auto buf2 = std::unique_ptr<uint8_t[]>(new uint8_t[buf_size]);
+	enable_rdadvise(fd, fs);
+
+	auto count = async_read_loop(fd, buf1.get(), buf2.get(), buf_size);
+	::close(fd);
+	return count;
+}
+
+static auto
+read_mmap_nocache(const char* path)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	disable_cache(fd);
+
+	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	auto count = consume(p, fs);
+	::munmap(p, fs);
+	return count;
+}
+
+static auto
+read_mmap_rdahead(const char* path)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	enable_rdahead(fd);
+
+	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	auto count = consume(p, fs);
+	::munmap(p, fs);
+	return count;
+}
+
+static auto
+read_mmap_rdadvise(const char* path)
+{
+	auto fd = safe_open(path, O_RDONLY).get();
+	auto fs = file_size(fd).get();
+	enable_rdadvise(fd, fs);
+
+	auto p = (uint8_t*)::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	auto count = consume(p, fs);
+	::munmap(p, fs);
+	return count;
+}
+
+#endif
+
+static void
+register_read_engines(engine_registry& r)
+{
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	r.read("read_plain", read_plain);
+	r.read("read_direct", read_direct);
+	r.read("read_fadvise", read_fadvise);
+	r.read_queued("read_window", read_window);
+	r.read("read_window_adaptive", read_window_adaptive);
+	r.read("aio_read_direct", aio_read_direct);
+	r.read("aio_read_fadvise", aio_read_fadvise);
+	r.read_queued("aio_read_queue_direct", aio_read_queue_direct);
+	r.read_queued("aio_read_queue_fadvise", aio_read_queue_fadvise);
+	r.read("read_async_plain", read_async_plain);
+	r.read("read_async_direct", read_async_direct);
+	r.read("read_async_fadvise", read_async_fadvise);
+	r.read_whole("mmap_plain", read_mmap_plain);
+	r.read_whole("mmap_direct", read_mmap_direct);
+	r.read_whole("mmap_fadvise", read_mmap_fadvise);
+	r.read_whole("read_adaptive", read_adaptive);
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	r.read("read_plain", read_plain);
+	r.read("read_nocache", read_nocache);
+	r.read("read_rdahead", read_rdahead);
+	r.read("read_rdadvise", read_rdadvise);
+	r.read("read_aio_nocache", read_aio_nocache, false);
+	r.read_queued("read_aio_queue_nocache", read_aio_queue_nocache, false);
+	r.read("read_aio_rdahead", read_aio_rdahead, false);
+	r.read("read_aio_rdadvise", read_aio_rdadvise, false);
+	r.read("read_async_nocache", read_async_nocache);
+	r.read("read_async_rdahead", read_async_rdahead);
+	r.read("read_async_rdadvise", read_async_rdadvise);
+	r.read_whole("mmap_plain", read_mmap_plain);
+	r.read_whole("mmap_nocache", read_mmap_nocache);
+	r.read_whole("mmap_rdahead", read_mmap_rdahead);
+	r.read_whole("mmap_rdadvise", read_mmap_rdadvise);
+	r.read_whole("read_adaptive", read_adaptive);
+#endif
+}
+
 #endif
@@ -0,0 +1,471 @@
+/*
+** File Name:	reader.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** A sequential file reader for use outside of the benchmarks. It streams the
+** contents of a file to a callback, one chunk at a time, using whichever of the
+** benchmarked strategies is expected to be fastest for the file: `mmap` if most
+** of the file is already in the page cache (which avoids copying anything),
+** and otherwise the configuration recorded in a tuning profile (see
+** `tune.hpp`) for the nearest file size. Without a profile, a buffered `pread`
+** loop with sequential access advice is used, which was the most robust choice
+** across the machines in `results`.
+**
+** Example:
+**
+**   auto p = read_profile("data/profile.txt");
+**   file_reader r{"data/test_256.bin", reader_options{&p}};
+**   r.read([&](const uint8_t* buf, size_t n, off_t off) { ... });
+*/
+
+#ifndef ZF709A4E3_19F5_465D_B33C_42DCBB179A98
+#define ZF709A4E3_19F5_465D_B33C_42DCBB179A98
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <io_common.hpp>
+#include <profile.hpp>
+
+enum class read_strategy
+{
+	// A loop of `pread` calls into one buffer.
+	pread,
+	// POSIX AIO with several reads of one block each in flight.
+	queued,
+	// A loop of `pread` calls, with `readahead` issued for a window ahead
+	// of the cursor. This is the same as `pread` except on Linux.
+	window,
+	// Chunks of a shared mapping of the file; nothing is copied.
+	mmap
+};
+
+struct read_plan
+{
+	read_strategy strategy{read_strategy::pread};
+	// Size of the chunks passed to the callback.
+	size_t block_size{1 << 20};
+	// Number of reads in flight for `read_strategy::queued`.
+	unsigned queue_depth{1};
+	// Size in blocks of the window for `read_strategy::window`, or zero if
+	// the window should adapt to the rate at which the chunks are consumed.
+	unsigned window_blocks{0};
+	// Whether to bypass the page cache. This is ignored for
+	// `read_strategy::mmap`.
+	bool direct{false};
+};
+
+struct reader_options
+{
+	// Profile used to choose the plan for files that are not cached. May be
+	// null.
+	const tuning_profile* profile{nullptr};
+	// Fraction of the pages of the file that must be resident in the page
+	// cache for `mmap` to be used regardless of the profile.
+	double resident_threshold{0.5};
+	// Files of at most this size are read in a single chunk.
+	size_t small_file_size{256 << 10};
+};
+
+/*
+** Calls `f(buf, n, off)` for each consecutive block of at most `buf_size` bytes
+** of the file, keeping `depth` reads in flight. The buffer `buf` must hold
+** `depth * buf_size` bytes. Requests complete in the order in which they were
+** issued, and each buffer is reissued for the next block as soon as `f` has
+** returned. If anything throws, then the reads in flight are cancelled and
+** waited for before the exception propagates.
+*/
+template <class Function>
+static void
+queued_read(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	const Function& f
+)
+{
+	using aiocb = struct aiocb;
+	auto cbs = std::vector<aiocb>(depth);
+	// The control block of each read in flight, or null.
+	auto live = std::vector<aiocb*>(depth);
+	// Times at which each read was submitted, for the trace.
+	auto times = std::vector<uint64_t>(depth);
+	auto off = off_t{0};
+	auto pending = 0u;
+	auto eof = false;
+
+	auto submit = [&](unsigned i) {
+		cbs[i] = aiocb{};
+		cbs[i].aio_fildes = fd;
+		cbs[i].aio_buf = buf + i * buf_size;
+		cbs[i].aio_nbytes = buf_size;
+		cbs[i].aio_offset = off;
+		times[i] = trace_begin();
+		if (::aio_read(&cbs[i]) == -1) { throw current_system_error(); }
+		live[i] = &cbs[i];
+		off += buf_size;
+		++pending;
+	};
+
+	try {
+		for (auto i = 0u; i != depth; ++i) { submit(i); }
+
+		for (auto i = 0u; pending > 0; i = (i + 1) % depth) {
+			auto l = std::array<const aiocb*, 1>{{&cbs[i]}};
+			auto e = int{};
+			while ((e = ::aio_error(&cbs[i])) == EINPROGRESS) {
+				if (::aio_suspend(l.data(), 1, nullptr) == -1 && errno != EINTR) {
+					throw current_system_error();
+				}
+			}
+			--pending;
+			live[i] = nullptr;
+			auto n = ::aio_return(&cbs[i]);
+			trace_end(trace_op::aio_read, cbs[i].aio_offset, buf_size,
+				times[i], e != 0 ? -e : n);
+			if (e != 0) { throw std::system_error{e, std::system_category()}; }
+
+			if (n > 0) { f(buf + i * buf_size, size_t(n), cbs[i].aio_offset); }
+			if (size_t(n) < buf_size) { eof = true; }
+			if (!eof) { submit(i); }
+		}
+	}
+	catch (...) {
+		drain_aio(live.data(), live.size());
+		throw;
+	}
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+/*
+** Calls `f(buf, n, off)` for each consecutive block of at most `buf_size` bytes
+** of the file, which is read with `pread`. Meanwhile, `readahead` brings the
+** `window` bytes ahead of the cursor into the page cache, and
+** `POSIX_FADV_DONTNEED` evicts the blocks that have been consumed. The kernel's
+** own readahead is disabled, so that only the window determines how far ahead
+** the device is kept busy. The window is refilled once half of it has been
+** consumed.
+**
+** If `window` is zero, then it starts at two blocks and adapts to the
+** consumer: it is doubled (up to 8 MB) whenever a read takes longer than `f`
+** took for the previous block, since the device has then fallen behind, and
+** halved once a whole window has been read without such a stall, since the
+** pages are then being brought in earlier than they are needed.
+*/
+template <class Function>
+static void
+window_read(
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	size_t window,
+	const Function& f
+)
+{
+	using clock = std::chrono::steady_clock;
+	auto max_window = std::max(size_t{8} << 20, 2 * buf_size);
+	auto adaptive = window == 0;
+	if (adaptive) { window = 2 * buf_size; }
+
+	auto fs = file_size(fd).get();
+	::posix_fadvise(fd, 0, fs, POSIX_FADV_RANDOM);
+
+	auto off = off_t{0};
+	// End of the range passed to `readahead` so far.
+	auto ahead = off_t{0};
+	// End of the range evicted so far.
+	auto evicted = off_t{0};
+	// Bytes read since the last stall, and the time taken to consume the
+	// previous block.
+	auto clean = size_t{0};
+	auto consume = clock::duration::zero();
+
+	for (;;) {
+		ahead = std::max(ahead, off);
+		if (ahead - off <= off_t(window / 2) && ahead < fs) {
+			auto end = std::min(off + off_t(window), fs);
+			::readahead(fd, ahead, end - ahead);
+			ahead = end;
+		}
+
+		auto t1 = clock::now();
+		auto n = size_t(full_read(fd, buf, buf_size, off).get());
+		auto t2 = clock::now();
+		if (n > 0) { f(buf, n, off); }
+		off += n;
+
+		if (adaptive) {
+			auto t3 = clock::now();
+			if (t2 - t1 > consume && window < max_window) {
+				window *= 2;
+				clean = 0;
+			}
+			else if ((clean += n) >= window && window > 2 * buf_size) {
+				window /= 2;
+				clean = 0;
+			}
+			consume = t3 - t2;
+		}
+
+		if (off - evicted >= off_t(window) || n < buf_size) {
+			::posix_fadvise(fd, evicted, off - evicted, POSIX_FADV_DONTNEED);
+			evicted = off;
+		}
+		if (n < buf_size) { return; }
+	}
+}
+
+#endif
+
+/*
+** Returns the fraction of the pages of the file that are resident in the page
+** cache.
+*/
+static double
+resident_fraction(int fd, off_t fs)
+{
+	if (fs == 0) { return 1; }
+
+	auto ps = size_t(::sysconf(_SC_PAGESIZE));
+	auto p = ::mmap(nullptr, fs, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) { throw current_system_error(); }
+
+	auto pages = (size_t(fs) + ps - 1) / ps;
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	auto v = std::vector<unsigned char>(pages);
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	auto v = std::vector<char>(pages);
+#endif
+	auto r = ::mincore(p, fs, v.data());
+	::munmap(p, fs);
+	if (r == -1) { throw current_system_error(); }
+
+	auto n = std::count_if(v.begin(), v.end(), [](auto x) { return x & 1; });
+	return double(n) / pages;
+}
+
+/*
+** Translates the name of a benchmarked read engine into the equivalent plan.
+*/
+static read_plan
+plan_for_engine(const std::string& name, size_t block_size, unsigned queue_depth)
+{
+	auto has = [&](const char* s) { return name.find(s) != std::string::npos; };
+	auto p = read_plan{};
+
+	if (has("mmap")) {
+		p.strategy = read_strategy::mmap;
+	}
+	else if (has("queue")) {
+		p.strategy = read_strategy::queued;
+		p.queue_depth = std::max(queue_depth, 1u);
+	}
+	else if (has("window")) {
+		p.strategy = read_strategy::window;
+		p.window_blocks = queue_depth;
+	}
+	p.direct = has("direct") || has("nocache");
+	if (block_size != 0) { p.block_size = block_size; }
+
+	// Direct IO requires the block size to be a multiple of the page size.
+	if (p.direct) { p.block_size = (p.block_size + 4095) / 4096 * 4096; }
+	return p;
+}
+
+/*
+** Chooses the plan for a file of size `fs` of which the fraction `resident` is
+** in the page cache. The profile entry with the closest file size (by ratio) is
+** used.
+*/
+static read_plan
+choose_plan(off_t fs, double resident, const reader_options& o)
+{
+	auto p = read_plan{};
+	if (fs > 0 && resident >= o.resident_threshold) {
+		p.strategy = read_strategy::mmap;
+		return p;
+	}
+	if (size_t(fs) <= o.small_file_size) {
+		p.block_size = std::max(size_t(fs), size_t{4096});
+		return p;
+	}
+	if (o.profile == nullptr) { return p; }
+
+	auto best = (const profile_entry*)nullptr;
+	auto dist = 0.0;
+	for (const auto& e : *o.profile) {
+		if (e.kind != engine_kind::read || e.file_size <= 0) { continue; }
+		auto d = std::abs(std::log(double(e.file_size) / fs));
+		if (best == nullptr || d < dist) {
+			best = &e;
+			dist = d;
+		}
+	}
+	if (best == nullptr) { return p; }
+	return plan_for_engine(best->engine, best->block_size, best->queue_depth);
+}
+
+class file_reader
+{
+	int m_fd{-1};
+	off_t m_size{0};
+	read_plan m_plan{};
+	// Alignment of the buffers, which is larger for some devices when the
+	// file is opened with `O_DIRECT`.
+	size_t m_align{4096};
+public:
+	/*
+	** Opens the file at `path`, and chooses the plan using `o`.
+	*/
+	explicit file_reader(const char* path, const reader_options& o = {})
+	{
+		m_fd = safe_open(path, O_RDONLY).get();
+		try {
+			m_size = file_size(m_fd).get();
+			auto r = m_size == 0 ? 1.0 : resident_fraction(m_fd, m_size);
+			m_plan = choose_plan(m_size, r, o);
+			configure(path);
+		}
+		catch (...) {
+			::close(m_fd);
+			throw;
+		}
+	}
+
+	/*
+	** Opens the file at `path`, and reads it using the given plan.
+	*/
+	explicit file_reader(const char* path, const read_plan& p) : m_plan{p}
+	{
+		m_fd = safe_open(path, O_RDONLY).get();
+		try {
+			m_size = file_size(m_fd).get();
+			configure(path);
+		}
+		catch (...) {
+			::close(m_fd);
+			throw;
+		}
+	}
+
+	file_reader(const file_reader&) = delete;
+	file_reader& operator=(const file_reader&) = delete;
+
+	~file_reader()
+	{ if (m_fd != -1) { ::close(m_fd); } }
+
+	off_t size() const noexcept
+	{ return m_size; }
+
+	const read_plan& plan() const noexcept
+	{ return m_plan; }
+
+	/*
+	** Calls `f(buf, n, off)` for each consecutive chunk of the file, where
+	** `buf` points to the `n` bytes of the file starting at offset `off`.
+	** The pointer `buf` is only valid until `f` returns.
+	*/
+	template <class Function>
+	void read(const Function& f) const
+	{
+		if (m_size == 0) { return; }
+
+		switch (m_plan.strategy) {
+		case read_strategy::mmap:   read_mmap(f);   break;
+		case read_strategy::queued: read_queued(f); break;
+		case read_strategy::window: read_window(f); break;
+		case read_strategy::pread:  read_pread(f);  break;
+		}
+	}
+private:
+	/*
+	** Reopens the file with the flags required by the plan, and gives the
+	** kernel the corresponding access advice.
+	*/
+	void configure(const char* path)
+	{
+		if (m_plan.strategy == read_strategy::mmap) { return; }
+
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		if (m_plan.direct) {
+			auto f = open_direct(path, O_RDONLY);
+			::close(m_fd);
+			m_fd = f.fd;
+			m_plan.block_size = f.align.round(m_plan.block_size);
+			m_align = f.align.memory;
+		}
+		else if (m_plan.strategy != read_strategy::window) {
+			fadvise_sequential_read(m_fd, m_size);
+		}
+	#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+		(void)path;
+		if (m_plan.direct) { disable_cache(m_fd); }
+		else { enable_rdahead(m_fd); }
+	#endif
+	}
+
+	template <class Function>
+	void read_pread(const Function& f) const
+	{
+		auto bs = m_plan.block_size;
+		auto buf = allocate_aligned(m_align, bs);
+		for (auto off = off_t{0};; off += bs) {
+			auto n = size_t(full_read(m_fd, buf.get(), bs, off).get());
+			if (n > 0) { f(buf.get(), n, off); }
+			if (n < bs) { return; }
+		}
+	}
+
+	template <class Function>
+	void read_queued(const Function& f) const
+	{
+		auto bs = m_plan.block_size;
+		auto buf = allocate_aligned(m_align, m_plan.queue_depth * bs);
+		queued_read(m_fd, buf.get(), bs, m_plan.queue_depth, f);
+	}
+
+	template <class Function>
+	void read_window(const Function& f) const
+	{
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		auto bs = m_plan.block_size;
+		auto buf = allocate_aligned(m_align, bs);
+		window_read(m_fd, buf.get(), bs, m_plan.window_blocks * bs, f);
+	#else
+		read_pread(f);
+	#endif
+	}
+
+	template <class Function>
+	void read_mmap(const Function& f) const
+	{
+		auto p = (uint8_t*)::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+		if (p == MAP_FAILED) { throw current_system_error(); }
+		::posix_madvise(p, m_size, POSIX_MADV_SEQUENTIAL);
+
+		try {
+			auto bs = m_plan.block_size;
+			for (auto off = off_t{0}; off < m_size; off += bs) {
+				f(p + off, std::min(bs, size_t(m_size - off)), off);
+			}
+		}
+		catch (...) {
+			::munmap(p, m_size);
+			throw;
+		}
+		::munmap(p, m_size);
+	}
+};
+
+#endif
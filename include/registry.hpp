@@ -0,0 +1,242 @@
+/*
+** File Name:	registry.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Each of the `*_common.hpp` headers registers its engines with an
+** `engine_registry` under the name that is printed in the results. This allows
+** a single driver to select the engines to run at runtime.
+*/
+
+#ifndef Z068E902D_5A0F_4E08_99BD_703563DD5FC5
+#define Z068E902D_5A0F_4E08_99BD_703563DD5FC5
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <ccbase/filesystem/glob_matcher.hpp>
+
+enum class engine_kind
+{
+	read,
+	write,
+	copy
+};
+
+static const char*
+kind_name(engine_kind k)
+{
+	switch (k) {
+	case engine_kind::read:  return "read";
+	case engine_kind::write: return "write";
+	case engine_kind::copy:  return "copy";
+	}
+	return "unknown";
+}
+
+static engine_kind
+parse_kind(const std::string& s)
+{
+	if (s == "read")  { return engine_kind::read; }
+	if (s == "write") { return engine_kind::write; }
+	if (s == "copy")  { return engine_kind::copy; }
+	throw std::invalid_argument{"invalid kind \"" + s + "\""};
+}
+
+struct engine_job
+{
+	// The file read by read and copy engines.
+	const char* src;
+	// The file written by write and copy engines.
+	const char* dst;
+	// The block size. This is ignored by engines that are not blocked.
+	size_t buf_size;
+	// The number of bytes written by write engines.
+	size_t count;
+	// The number of requests kept in flight. This is ignored by engines
+	// that are not queued.
+	unsigned queue_depth;
+};
+
+struct engine
+{
+	std::string name;
+	engine_kind kind;
+	// Whether the engine is parameterized by a block size.
+	bool blocked;
+	// Whether the engine is parameterized by a queue depth.
+	bool queued;
+	// Whether the engine is run when no engines are selected explicitly.
+	bool enabled;
+	// Read engines return the number of occurrences of `needle` in the
+	// file; write and copy engines return zero.
+	std::function<off_t(const engine_job&)> run;
+};
+
+class engine_registry
+{
+	std::vector<engine> v;
+public:
+	/*
+	** Registers an engine invoked as `f(path, buf_size)`.
+	*/
+	template <class F>
+	void read(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::read, true, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				return f(j.src, j.buf_size);
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(path, buf_size, queue_depth)`.
+	*/
+	template <class F>
+	void read_queued(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::read, true, true, enabled,
+			[=](const engine_job& j) -> off_t {
+				return f(j.src, j.buf_size, j.queue_depth);
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(path)`.
+	*/
+	template <class F>
+	void read_whole(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::read, false, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				return f(j.src);
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(path, buf_size, count)`.
+	*/
+	template <class F>
+	void write(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::write, true, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.dst, j.buf_size, j.count);
+				return 0;
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(path, buf_size, count, queue_depth)`.
+	*/
+	template <class F>
+	void write_queued(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::write, true, true, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.dst, j.buf_size, j.count, j.queue_depth);
+				return 0;
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(path, count)`.
+	*/
+	template <class F>
+	void write_whole(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::write, false, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.dst, j.count);
+				return 0;
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(src, dst, buf_size)`.
+	*/
+	template <class F>
+	void copy(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::copy, true, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.src, j.dst, j.buf_size);
+				return 0;
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(src, dst, buf_size, queue_depth)`.
+	*/
+	template <class F>
+	void copy_queued(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::copy, true, true, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.src, j.dst, j.buf_size, j.queue_depth);
+				return 0;
+			}});
+	}
+
+	/*
+	** Registers an engine invoked as `f(src, dst)`.
+	*/
+	template <class F>
+	void copy_whole(const char* name, F f, bool enabled = true)
+	{
+		add({name, engine_kind::copy, false, false, enabled,
+			[=](const engine_job& j) -> off_t {
+				f(j.src, j.dst);
+				return 0;
+			}});
+	}
+
+	const std::vector<engine>& engines() const
+	{ return v; }
+
+	const engine* find(const std::string& name) const
+	{
+		for (const auto& e : v) {
+			if (e.name == name) { return &e; }
+		}
+		return nullptr;
+	}
+
+	/*
+	** Returns the engines whose names match at least one of the given glob
+	** patterns, in the order in which they were registered. If no patterns
+	** are given, then the engines that are enabled by default are
+	** returned.
+	*/
+	std::vector<const engine*>
+	select(const std::vector<std::string>& globs) const
+	{
+		auto r = std::vector<const engine*>{};
+		for (const auto& e : v) {
+			if (globs.empty()) {
+				if (e.enabled) { r.push_back(&e); }
+				continue;
+			}
+			for (const auto& g : globs) {
+				if (cc::glob_matcher{g.c_str()}(e.name.c_str())) {
+					r.push_back(&e);
+					break;
+				}
+			}
+		}
+		return r;
+	}
+private:
+	void add(engine e)
+	{
+		if (find(e.name) != nullptr) {
+			throw std::logic_error{"Engine \"" + e.name + "\" registered twice."};
+		}
+		v.push_back(std::move(e));
+	}
+};
+
+#endif
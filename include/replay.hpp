@@ -0,0 +1,781 @@
+/*
+** File Name:	replay.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Replays a recorded sequence of IOs against a file with one of several
+** submission engines, and reports the distribution of their latencies. This
+** makes it possible to compare the engines on the access pattern of a real
+** application rather than on a sequential scan.
+**
+** The trace is either a binary trace written by `benchmark.run --trace` (see
+** `trace.hpp`), or a text file with one IO per line:
+**
+**   # time (us)  op  offset  length
+**   0            r   0       4096
+**   12.5         w   65536   16384
+**
+** where the op is `r` or `w` (or `read` or `write`), and the time at which the
+** IO was issued is in microseconds from an arbitrary origin. Blank lines and
+** lines that begin with `#` are ignored.
+**
+** In the default mode, each IO is issued as soon as a thread or queue slot is
+** free. In the timing-faithful mode (`-m faithful`), no IO is issued before its
+** recorded time relative to the first one, and the amount by which each IO was
+** issued late is reported as well.
+**
+** The engines are:
+**
+**   - `pread`: `pread` and `pwrite` calls on a pool of threads.
+**   - `aio`: POSIX AIO, as in `aio_read_loop`, with up to `-q` IOs in flight.
+**   - `kaio`: Linux kernel AIO through the raw system calls, as in
+**     `reference/linux/aio_test_linux.cpp`, with up to `-q` IOs in flight. The
+**     file is always opened with `O_DIRECT`, since otherwise `io_submit`
+**     blocks until the IO completes.
+**   - `mmap`: copies to and from a shared mapping of the file on a pool of
+**     threads. The latency then includes any page faults.
+**
+** With `O_DIRECT`, each IO is widened to the nearest multiples of the alignment
+** that the file requires, as reported by `direct_io_alignment`.
+** The write IOs in the trace overwrite the contents of the file.
+*/
+
+#ifndef Z45990B09_61B0_4DF7_87EC_B7D0DF8F0AD2
+#define Z45990B09_61B0_4DF7_87EC_B7D0DF8F0AD2
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/platform.hpp>
+#include <ccbase/filesystem/compiled_glob.hpp>
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <statistics.hpp>
+#include <trace.hpp>
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	// For `__NR_*` system call definitions.
+	#include <sys/syscall.h>
+	#include <linux/aio_abi.h>
+#endif
+
+struct replay_io
+{
+	// Time at which the IO was issued, relative to the first IO.
+	uint64_t time_ns;
+	off_t    offset;
+	size_t   length;
+	bool     write;
+};
+
+struct replay_result
+{
+	uint64_t submit_ns;
+	uint64_t complete_ns;
+	// Number of bytes transferred, or the negated error code.
+	int64_t  result;
+};
+
+struct replay_options
+{
+	const char* trace{nullptr};
+	const char* file{nullptr};
+	std::vector<std::string> engines{"pread"};
+	// Glob patterns for the configurations to replay from a binary trace.
+	std::vector<std::string> configs;
+	// Number of threads used by the `pread` and `mmap` engines.
+	unsigned threads{1};
+	// Maximum number of IOs in flight for the `aio` and `kaio` engines.
+	unsigned depth{8};
+	bool faithful{false};
+	bool direct{false};
+	bool cold{false};
+};
+
+/*
+** Alignment of the buffers, and of the IOs when the file is opened with
+** `O_DIRECT`, unless the file reports larger ones.
+*/
+static constexpr auto replay_align = size_t{4096};
+
+static bool
+is_binary_trace(const char* path)
+{
+	auto f = std::fopen(path, "rb");
+	if (f == nullptr) { throw std::system_error{errno, std::system_category()}; }
+	auto h = trace_header{};
+	auto m = std::array<char, sizeof(h.magic)>{};
+	auto n = std::fread(m.data(), 1, m.size(), f);
+	std::fclose(f);
+	return n == m.size() && std::memcmp(m.data(), h.magic, m.size()) == 0;
+}
+
+/*
+** Reads the IOs of the selected configurations from a binary trace. If no
+** configuration is selected, the trace must contain only one, not counting
+** the IO done by the driver between configurations.
+*/
+static std::vector<replay_io>
+read_binary_ios(const char* path, const std::vector<std::string>& configs)
+{
+	auto t = read_trace(path);
+	auto set = configs.empty() ? nullptr :
+		std::unique_ptr<cc::glob_set>{new cc::glob_set{configs}};
+	auto keep = std::vector<bool>(t.engines.size());
+	auto kept = 0u;
+
+	for (auto i = size_t{0}; i != t.engines.size(); ++i) {
+		keep[i] = set ? (*set)(t.engines[i].c_str()) : t.engines[i] != "setup";
+		kept += keep[i];
+	}
+	if (!set && kept > 1) {
+		throw std::invalid_argument{cc::format("the trace contains $ "
+			"configurations; select some with -c", kept)};
+	}
+
+	auto r = std::vector<replay_io>{};
+	auto skipped = size_t{0};
+	for (const auto& x : t.records) {
+		if (!keep[x.engine]) { continue; }
+		auto op = trace_op(x.op);
+		if (op == trace_op::trial) { continue; }
+		if (
+			op != trace_op::read && op != trace_op::aio_read &&
+			op != trace_op::uring_read && op != trace_op::write
+		) {
+			++skipped;
+			continue;
+		}
+		r.push_back({x.submit_ns, x.offset, x.length, op == trace_op::write});
+	}
+	if (skipped != 0) {
+		cc::errln("Warning: skipped $ splice, sendfile, and copy_file_range records.", skipped);
+	}
+	return r;
+}
+
+static std::vector<replay_io>
+read_text_ios(const char* path)
+{
+	auto f = std::fopen(path, "r");
+	if (f == nullptr) { throw std::system_error{errno, std::system_category()}; }
+
+	auto r = std::vector<replay_io>{};
+	auto buf = std::array<char, 256>{};
+	auto op = std::array<char, 16>{};
+	for (auto line = 1u; std::fgets(buf.data(), buf.size(), f) != nullptr; ++line) {
+		auto p = buf.data();
+		while (*p == ' ' || *p == '\t') { ++p; }
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') { continue; }
+
+		auto t = 0.0;
+		auto off = (long long)0;
+		auto len = (unsigned long long)0;
+		auto n = std::sscanf(p, "%lf %15s %lld %llu", &t, op.data(), &off, &len);
+		auto o = std::string{op.data()};
+		if (
+			n != 4 || t < 0 || off < 0 || len == 0 ||
+			(o != "r" && o != "w" && o != "read" && o != "write")
+		) {
+			std::fclose(f);
+			throw std::invalid_argument{cc::format("line $ of \"$\" is "
+				"malformed", line, path)};
+		}
+		r.push_back({uint64_t(t * 1000), off_t(off), size_t(len), o[0] == 'w'});
+	}
+	std::fclose(f);
+	return r;
+}
+
+/*
+** Reads the IOs from the trace, orders them by the time at which they were
+** issued, and makes the times relative to that of the first IO.
+*/
+static std::vector<replay_io>
+read_replay_ios(const replay_options& o)
+{
+	auto r = is_binary_trace(o.trace) ? read_binary_ios(o.trace, o.configs) :
+		read_text_ios(o.trace);
+	if (r.empty()) { throw std::invalid_argument{"the trace contains no IOs"}; }
+
+	std::stable_sort(r.begin(), r.end(),
+		[](const auto& a, const auto& b) { return a.time_ns < b.time_ns; });
+	auto t0 = r.front().time_ns;
+	for (auto& x : r) { x.time_ns -= t0; }
+	return r;
+}
+
+/*
+** Widens each IO so that its offset and length are multiples of `a`.
+*/
+static std::vector<replay_io>
+align_ios(std::vector<replay_io> ios, size_t a)
+{
+	for (auto& x : ios) {
+		auto l = x.offset / off_t(a) * off_t(a);
+		auto h = (x.offset + off_t(x.length) + off_t(a) - 1) / off_t(a) * off_t(a);
+		x.offset = l;
+		x.length = size_t(h - l);
+	}
+	return ios;
+}
+
+static size_t
+max_length(const std::vector<replay_io>& ios)
+{
+	auto r = size_t{0};
+	for (const auto& x : ios) { r = std::max(r, x.length); }
+	return r;
+}
+
+/*
+** Waits until the monotonic clock reaches `t`. The last part of the wait is
+** spun, since sleeps overshoot by tens of microseconds.
+*/
+static void
+wait_until(uint64_t t)
+{
+	for (;;) {
+		auto now = trace_clock();
+		if (now >= t) { return; }
+		if (t - now > 200000) {
+			std::this_thread::sleep_for(std::chrono::nanoseconds{t - now - 100000});
+		}
+	}
+}
+
+/*
+** Issues the IOs on `o.threads` threads, each of which calls `f(buf, io)` for
+** the next IO that has not been taken, and records the result. The buffers are
+** aligned to `align` bytes.
+*/
+template <class Function>
+static void
+replay_threads(
+	size_t align,
+	const std::vector<replay_io>& ios,
+	const replay_options& o,
+	uint64_t start,
+	std::vector<replay_result>& rs,
+	const Function& f
+)
+{
+	std::atomic<size_t> next{0};
+	auto errors = std::vector<std::exception_ptr>(o.threads);
+	auto len = max_length(ios);
+
+	auto work = [&](unsigned t) {
+		try {
+			auto buf = allocate_aligned(align, len);
+			std::memset(buf.get(), 0, len);
+			for (;;) {
+				auto i = next.fetch_add(1, std::memory_order_relaxed);
+				if (i >= ios.size()) { return; }
+				if (o.faithful) { wait_until(start + ios[i].time_ns); }
+				auto s = trace_clock();
+				auto r = f(buf.get(), ios[i]);
+				rs[i] = {s, trace_clock(), r};
+			}
+		}
+		catch (...) {
+			errors[t] = std::current_exception();
+			next.store(ios.size(), std::memory_order_relaxed);
+		}
+	};
+
+	auto ts = std::vector<std::thread>{};
+	for (auto t = 1u; t < o.threads; ++t) { ts.emplace_back(work, t); }
+	work(0);
+	for (auto& t : ts) { t.join(); }
+	for (const auto& e : errors) {
+		if (e) { std::rethrow_exception(e); }
+	}
+}
+
+static void
+replay_pread(
+	int fd,
+	size_t align,
+	const std::vector<replay_io>& ios,
+	const replay_options& o,
+	uint64_t start,
+	std::vector<replay_result>& rs
+)
+{
+	replay_threads(align, ios, o, start, rs, [&](uint8_t* buf, const replay_io& x) {
+		auto r = x.write ? ::pwrite(fd, buf, x.length, x.offset) :
+			::pread(fd, buf, x.length, x.offset);
+		return r == -1 ? -int64_t(errno) : int64_t(r);
+	});
+}
+
+static void
+replay_mmap(
+	int fd,
+	size_t align,
+	const std::vector<replay_io>& ios,
+	const replay_options& o,
+	uint64_t start,
+	std::vector<replay_result>& rs
+)
+{
+	// Writes past the end of the file would fault, so the file is first
+	// extended to cover them. Reads past the end are cut short, as they
+	// would be by `pread`.
+	auto fs = file_size(fd).get();
+	auto writes = false;
+	for (const auto& x : ios) {
+		if (!x.write) { continue; }
+		writes = true;
+		fs = std::max(fs, x.offset + off_t(x.length));
+	}
+	if (fs == 0) { throw std::invalid_argument{"the file is empty"}; }
+	if (writes) { truncate(fd, fs); }
+
+	auto prot = PROT_READ | (writes ? PROT_WRITE : 0);
+	auto p = (uint8_t*)::mmap(nullptr, fs, prot, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) { throw current_system_error(); }
+
+	try {
+		replay_threads(align, ios, o, start, rs, [&](uint8_t* buf, const replay_io& x) {
+			if (x.offset >= fs) { return int64_t{0}; }
+			auto n = std::min(x.length, size_t(fs - x.offset));
+			if (x.write) { std::memcpy(p + x.offset, buf, n); }
+			else { std::memcpy(buf, p + x.offset, n); }
+			return int64_t(n);
+		});
+	}
+	catch (...) {
+		::munmap(p, fs);
+		throw;
+	}
+	::munmap(p, fs);
+}
+
+static void
+replay_posix_aio(
+	int fd,
+	size_t align,
+	const std::vector<replay_io>& ios,
+	const replay_options& o,
+	uint64_t start,
+	std::vector<replay_result>& rs
+)
+{
+	using aiocb = struct aiocb;
+	static constexpr auto none = std::numeric_limits<size_t>::max();
+
+	auto len = max_length(ios);
+	auto buf = allocate_aligned(align, o.depth * len);
+	std::memset(buf.get(), 0, o.depth * len);
+	auto cbs = std::vector<aiocb>(o.depth);
+	// The IO in each slot, and the list passed to `aio_suspend`, in which
+	// the free slots are null.
+	auto slots = std::vector<size_t>(o.depth, none);
+	auto list = std::vector<aiocb*>(o.depth);
+	auto pending = 0u;
+
+	// The completion of an IO is only noticed when its slot is checked,
+	// so its completion time is that at which it was reaped.
+	auto reap = [&]() {
+		for (auto s = 0u; s != o.depth; ++s) {
+			if (slots[s] == none) { continue; }
+			auto e = ::aio_error(&cbs[s]);
+			if (e == EINPROGRESS) { continue; }
+			auto n = ::aio_return(&cbs[s]);
+			auto& r = rs[slots[s]];
+			r.complete_ns = trace_clock();
+			r.result = e != 0 ? -int64_t(e) : int64_t(n);
+			slots[s] = none;
+			list[s] = nullptr;
+			--pending;
+		}
+	};
+
+	auto suspend = [&]() {
+		if (::aio_suspend(list.data(), o.depth, nullptr) == -1 && errno != EINTR) {
+			throw current_system_error();
+		}
+		reap();
+	};
+
+	try {
+		for (auto i = size_t{0}; i != ios.size(); ++i) {
+			if (o.faithful) {
+				while (trace_clock() < start + ios[i].time_ns) {
+					reap();
+					std::this_thread::yield();
+				}
+			}
+			while (pending == o.depth) { suspend(); }
+
+			auto s = unsigned(std::find(slots.begin(), slots.end(), none) - slots.begin());
+			cbs[s] = aiocb{};
+			cbs[s].aio_fildes = fd;
+			cbs[s].aio_buf = buf.get() + s * len;
+			cbs[s].aio_nbytes = ios[i].length;
+			cbs[s].aio_offset = ios[i].offset;
+
+			rs[i].submit_ns = trace_clock();
+			auto r = ios[i].write ? ::aio_write(&cbs[s]) : ::aio_read(&cbs[s]);
+			if (r == -1) { throw current_system_error(); }
+			slots[s] = i;
+			list[s] = &cbs[s];
+			++pending;
+		}
+		while (pending != 0) { suspend(); }
+	}
+	catch (...) {
+		// The IOs still in flight write into `cbs` and `buf`.
+		drain_aio(list.data(), list.size());
+		throw;
+	}
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+static int
+io_setup(unsigned n, aio_context_t* c)
+{ return ::syscall(__NR_io_setup, n, c); }
+
+static int
+io_destroy(aio_context_t c)
+{ return ::syscall(__NR_io_destroy, c); }
+
+static int
+io_submit(aio_context_t c, long n, iocb** b)
+{ return ::syscall(__NR_io_submit, c, n, b); }
+
+static int
+io_getevents(aio_context_t c, long min, long max, io_event* e, timespec* t)
+{ return ::syscall(__NR_io_getevents, c, min, max, e, t); }
+
+static void
+replay_kernel_aio(
+	int fd,
+	size_t align,
+	const std::vector<replay_io>& ios,
+	const replay_options& o,
+	uint64_t start,
+	std::vector<replay_result>& rs
+)
+{
+	auto len = max_length(ios);
+	auto buf = allocate_aligned(align, o.depth * len);
+	std::memset(buf.get(), 0, o.depth * len);
+	auto cbs = std::vector<iocb>(o.depth);
+	auto events = std::vector<io_event>(o.depth);
+	// The IO in each slot, and the slots that are free.
+	auto slots = std::vector<size_t>(o.depth);
+	auto free = std::vector<unsigned>{};
+	for (auto s = o.depth; s != 0; --s) { free.push_back(s - 1); }
+
+	auto c = aio_context_t{0};
+	if (io_setup(o.depth, &c) == -1) { throw current_system_error(); }
+
+	// Waits for at least `min` IOs to complete, or until the timeout `t`
+	// (if not null) elapses.
+	auto reap = [&](long min, timespec* t) {
+		auto n = io_getevents(c, min, o.depth, events.data(), t);
+		if (n == -1) {
+			if (errno == EINTR) { return; }
+			throw current_system_error();
+		}
+		auto now = trace_clock();
+		for (auto k = 0; k != n; ++k) {
+			auto s = unsigned(events[k].data);
+			rs[slots[s]].complete_ns = now;
+			rs[slots[s]].result = events[k].res;
+			free.push_back(s);
+		}
+	};
+
+	try {
+		for (auto i = size_t{0}; i != ios.size(); ++i) {
+			if (o.faithful) {
+				auto t = start + ios[i].time_ns;
+				for (auto now = trace_clock(); now < t; now = trace_clock()) {
+					if (free.size() == o.depth) {
+						wait_until(t);
+						break;
+					}
+					auto d = t - now;
+					auto ts = timespec{time_t(d / 1000000000), long(d % 1000000000)};
+					reap(1, &ts);
+				}
+			}
+			while (free.empty()) { reap(1, nullptr); }
+
+			auto s = free.back();
+			free.pop_back();
+			cbs[s] = iocb{};
+			cbs[s].aio_data = s;
+			cbs[s].aio_lio_opcode = ios[i].write ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+			cbs[s].aio_fildes = fd;
+			cbs[s].aio_buf = (uint64_t)(buf.get() + s * len);
+			cbs[s].aio_nbytes = ios[i].length;
+			cbs[s].aio_offset = ios[i].offset;
+			slots[s] = i;
+
+			auto p = &cbs[s];
+			rs[i].submit_ns = trace_clock();
+			auto r = io_submit(c, 1, &p);
+			if (r == -1) { throw current_system_error(); }
+			if (r != 1) { throw std::runtime_error{"Failed to submit IO."}; }
+		}
+		while (free.size() != o.depth) { reap(1, nullptr); }
+	}
+	catch (...) {
+		io_destroy(c);
+		throw;
+	}
+	if (io_destroy(c) == -1) { throw current_system_error(); }
+}
+
+#endif
+
+static bool
+replay_engine_supported(const std::string& e)
+{
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	if (e == "kaio") { return true; }
+#endif
+	return e == "pread" || e == "aio" || e == "mmap";
+}
+
+/*
+** Replays the IOs with the engine `e`, and prints a line of results.
+*/
+static void
+replay_with(const std::string& e, const std::vector<replay_io>& ios, const replay_options& o)
+{
+	auto writes = std::any_of(ios.begin(), ios.end(),
+		[](const auto& x) { return x.write; });
+	auto direct = e == "kaio" || (o.direct && e != "mmap");
+	auto flags = writes ? O_RDWR : O_RDONLY;
+	// Alignment of the buffers, and of the IOs if they must be aligned.
+	auto mem_align = replay_align;
+	auto io_align = direct ? replay_align : size_t{1};
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	auto fd = int{};
+	if (direct) {
+		// If the file system does not support `O_DIRECT`, the file
+		// is opened without it, and the IOs are left as they are.
+		auto f = open_direct(o.file, flags);
+		fd = f.fd;
+		mem_align = f.align.memory;
+		io_align = f.align.offset;
+	}
+	else {
+		fd = safe_open(o.file, flags).get();
+	}
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	auto fd = safe_open(o.file, flags).get();
+	if (direct) { disable_cache(fd); }
+#endif
+	auto xs = io_align > 1 ? align_ios(ios, io_align) : ios;
+	if (o.cold) { purge_cache().get(); }
+
+	auto rs = std::vector<replay_result>(xs.size());
+	// In the timing-faithful mode, the first IO is scheduled slightly in
+	// the future, so that starting the threads does not make it late.
+	auto start = trace_clock() + (o.faithful ? 1000000 : 0);
+
+	try {
+		if      (e == "pread") { replay_pread(fd, mem_align, xs, o, start, rs); }
+		else if (e == "mmap")  { replay_mmap(fd, mem_align, xs, o, start, rs); }
+		else if (e == "aio")   { replay_posix_aio(fd, mem_align, xs, o, start, rs); }
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		else if (e == "kaio")  { replay_kernel_aio(fd, mem_align, xs, o, start, rs); }
+#endif
+	}
+	catch (...) {
+		::close(fd);
+		throw;
+	}
+	safe_close(fd).get();
+
+	auto first = std::numeric_limits<uint64_t>::max();
+	auto last = uint64_t{0};
+	auto bytes = uint64_t{0};
+	auto errors = size_t{0};
+	auto late = 0.0;
+	auto lat = std::vector<double>{};
+	lat.reserve(rs.size());
+
+	for (auto i = size_t{0}; i != rs.size(); ++i) {
+		const auto& r = rs[i];
+		first = std::min(first, r.submit_ns);
+		last = std::max(last, r.complete_ns);
+		if (r.result < 0) { ++errors; }
+		else { bytes += r.result; }
+		lat.push_back((r.complete_ns - r.submit_ns) / 1e3);
+		if (o.faithful) {
+			late += (int64_t(r.submit_ns) - int64_t(start + xs[i].time_ns)) / 1e3;
+		}
+	}
+	if (errors != 0) {
+		cc::errln("Warning: $ of $ IOs failed with $.", errors, rs.size(), e);
+	}
+
+	auto mean = 0.0;
+	for (const auto& x : lat) { mean += x; }
+	mean /= lat.size();
+	std::sort(lat.begin(), lat.end());
+
+	auto secs = (last - first) / 1e9;
+	auto q = [&](double p) { return sorted_quantile(lat.begin(), lat.end(), p); };
+	std::printf("%s, %s, %zu, %zu, %f, %f, %f, %f, %f, %f, %f, %f, %f, %f\n",
+		e.c_str(), o.faithful ? "faithful" : "fast", rs.size(), errors,
+		secs * 1000, bytes / 1048576.0 / secs, rs.size() / secs, mean,
+		q(0.5), q(0.9), q(0.99), q(0.999), lat.back(),
+		o.faithful ? late / rs.size() : 0.0);
+	std::fflush(stdout);
+}
+
+static void
+print_replay_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] trace file\n"
+"\n"
+"Replays the IOs in the trace against the file with each of the selected\n"
+"engines, and reports the distribution of their latencies. The trace is either\n"
+"written by benchmark.run --trace, or is a text file with one IO per line, as\n"
+"\"TIME_US r|w OFFSET LENGTH\". Write IOs overwrite the contents of the file.\n"
+"\n"
+"Options:\n"
+"  -e, --engines NAME[,NAME...]  Engines to use: pread, aio, kaio, or mmap\n"
+"                                (default: pread).\n"
+"  -c, --configs GLOB[,GLOB...]  Configurations to replay from a binary trace.\n"
+"  -m, --mode MODE               fast (default) to issue each IO as soon as\n"
+"                                possible, or faithful to keep the recorded\n"
+"                                times between them.\n"
+"  -t, --threads N               Threads used by pread and mmap (default: 1).\n"
+"  -q, --queue-depth N           IOs in flight for aio and kaio (default: 8).\n"
+"  -d, --direct                  Bypass the page cache (always done by kaio).\n"
+"      --cold                    Purge the page cache before each engine.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+replay_main(int argc, char** argv)
+{
+	auto o = replay_options{};
+	auto ios = std::vector<replay_io>{};
+
+	try {
+		auto args = std::vector<const char*>{};
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_replay_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-e", "--engines")) {
+				o.engines = split(value(), ',');
+				for (const auto& e : o.engines) {
+					if (!replay_engine_supported(e)) {
+						throw std::invalid_argument{cc::format(
+							"unsupported engine \"$\"", e)};
+					}
+				}
+			}
+			else if (is_option(a, "-c", "--configs")) {
+				auto g = split(value(), ',');
+				o.configs.insert(o.configs.end(), g.begin(), g.end());
+			}
+			else if (is_option(a, "-m", "--mode")) {
+				auto m = std::string{value()};
+				if      (m == "fast")     { o.faithful = false; }
+				else if (m == "faithful") { o.faithful = true; }
+				else {
+					throw std::invalid_argument{cc::format("invalid mode \"$\"", m)};
+				}
+			}
+			else if (is_option(a, "-t", "--threads")) {
+				o.threads = parse_count(value());
+			}
+			else if (is_option(a, "-q", "--queue-depth")) {
+				o.depth = parse_count(value());
+			}
+			else if (is_option(a, "-d", "--direct")) {
+				o.direct = true;
+			}
+			else if (is_option(a, nullptr, "--cold")) {
+				o.cold = true;
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else {
+				args.push_back(a);
+			}
+		}
+
+		if (args.size() != 2) {
+			throw std::invalid_argument{"expected a trace and a file"};
+		}
+		o.trace = args[0];
+		o.file = args[1];
+		ios = read_replay_ios(o);
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to read \"$\": $.", o.trace, e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	print_environment(stdout, capture_environment({o.file}));
+	std::printf("Engine, Mode, IOs, Errors, Time (ms), Throughput (MB/s), IOPS, "
+		"Mean (us), p50 (us), p90 (us), p99 (us), p99.9 (us), Max (us), "
+		"Mean Lateness (us)\n");
+	for (const auto& e : o.engines) {
+		try {
+			replay_with(e, ios, o);
+		}
+		catch (const std::invalid_argument& err) {
+			cc::errln("Error: failed to replay with $: $.", e, err.what());
+			return EXIT_FAILURE;
+		}
+		catch (const std::system_error& err) {
+			cc::errln("Error: failed to replay on \"$\" with $: $.", o.file,
+				e, err.what());
+			return EXIT_FAILURE;
+		}
+		catch (const std::runtime_error& err) {
+			cc::errln("Error: failed to replay with $: $.", e, err.what());
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
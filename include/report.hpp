@@ -0,0 +1,375 @@
+/*
+** File Name:	report.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Writes the results of the benchmarks to standard output, either as CSV or as
+** JSON. The JSON format also contains the individual trial times, which
+** `tools/compare.rb` uses to test whether two sets of results differ
+** significantly. In the CSV format, the environment is written as comment
+** lines beginning with `#` before the header.
+*/
+
+#ifndef Z7E342AD4_E2C2_4635_90F3_D965ADB55A87
+#define Z7E342AD4_E2C2_4635_90F3_D965ADB55A87
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include <consumer.hpp>
+#include <environment.hpp>
+#include <options.hpp>
+#include <placement.hpp>
+#include <statistics.hpp>
+
+enum class report_format
+{
+	csv,
+	json
+};
+
+enum class result_kind
+{
+	// Results of IO engines, reported by `report_result`.
+	io,
+	// Results of metadata operations, reported by `report_rate`.
+	metadata,
+	// Results of IO engines run on several files at once, reported by
+	// `report_streams`.
+	streams
+};
+
+/*
+** The throughput of the individual files read concurrently in one trial, and
+** Jain's fairness index over them, which is 1 if every file is read at the
+** same rate and 1/n if one of the n files gets all of the bandwidth.
+*/
+struct stream_summary
+{
+	double min_mbps;
+	double mean_mbps;
+	double max_mbps;
+	double fairness;
+};
+
+/*
+** Statistics that a program reports for each result in addition to the usual
+** ones, e.g. the fraction of time for which each stage of a pipeline was busy.
+** Each one is written as a JSON field under its key, and as a column of the CSV
+** output, whose title is given to `begin_report`.
+*/
+using report_extras = std::vector<std::pair<const char*, double>>;
+
+// The format used by the functions below. This can be overridden from the
+// command line of the driver.
+static auto output_format = report_format::csv;
+
+namespace detail {
+
+// Number of results written since `begin_report` was called.
+static auto results_written = size_t{0};
+
+static std::string
+json_string(const std::string& s)
+{
+	auto r = std::string{"\""};
+	for (const auto& c : s) {
+		switch (c) {
+		case '"':  r += "\\\""; break;
+		case '\\': r += "\\\\"; break;
+		case '\n': r += "\\n";  break;
+		case '\t': r += "\\t";  break;
+		default:
+			if ((unsigned char)c < 0x20) {
+				char buf[8];
+				std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+				r += buf;
+			}
+			else {
+				r += c;
+			}
+		}
+	}
+	return r + "\"";
+}
+
+static std::string
+json_object(const property_list& ps)
+{
+	auto r = std::string{"{"};
+	for (const auto& p : ps) {
+		if (r.size() > 1) { r += ", "; }
+		r += json_string(p.first) + ": " + json_string(p.second);
+	}
+	return r + "}";
+}
+
+}
+
+/*
+** Writes the environment as comment lines of the form `# key: value`.
+*/
+static void
+print_environment(std::FILE* f, const environment& e)
+{
+	for (const auto& p : e.system) {
+		std::fprintf(f, "# %s: %s\n", p.first.c_str(), p.second.c_str());
+	}
+	for (const auto& fe : e.files) {
+		for (const auto& p : fe) {
+			std::fprintf(f, "# %s %s: %s\n", fe[0].second.c_str(),
+				p.first.c_str(), p.second.c_str());
+		}
+	}
+}
+
+/*
+** Returns the label used for a configuration in human-readable output, e.g.
+** `read_direct 64 KB` or `aio_read_queue_direct 64 KB qd 8`.
+*/
+static std::string
+config_label(const char* name, size_t buf_size, unsigned queue_depth)
+{
+	auto r = std::string{name};
+	if (buf_size != 0) { r += " " + format_size(buf_size); }
+	if (queue_depth != 0) { r += " qd " + std::to_string(queue_depth); }
+	return r;
+}
+
+/*
+** Returns the suffix appended to the labels of the results of IO engines,
+** which names `current_placement` and `current_consumer` unless they are the
+** defaults, e.g. ` @ b0-i0-c1 [crc32c]`.
+*/
+static std::string
+context_label()
+{
+	auto r = std::string{};
+	if (!current_placement.name.empty()) {
+		r += " @ " + current_placement.name;
+	}
+	if (current_consumer.kind != consumer_kind::count) {
+		r += " [" + consumer_name(current_consumer) + "]";
+	}
+	return r;
+}
+
+/*
+** Writes the environment and, in the CSV format, the header. The titles of the
+** columns for the `report_extras` of each result are given by `extra_columns`.
+*/
+static void
+begin_report(
+	const environment& e,
+	result_kind k = result_kind::io,
+	const std::vector<const char*>& extra_columns = {}
+)
+{
+	detail::results_written = 0;
+
+	if (output_format == report_format::json) {
+		std::printf("{\n\"environment\": {\n\"system\": %s,\n\"files\": [",
+			detail::json_object(e.system).c_str());
+		for (auto i = size_t{0}; i != e.files.size(); ++i) {
+			std::printf("%s\n%s", i == 0 ? "" : ",",
+				detail::json_object(e.files[i]).c_str());
+		}
+		std::printf("\n]\n},\n\"results\": [");
+		std::fflush(stdout);
+		return;
+	}
+
+	print_environment(stdout, e);
+	if (k == result_kind::metadata) {
+		std::printf("%s, %s, %s, %s, %s, %s, %s, %s, %s, %s", "Entries",
+			"Method", "Mean (ms)", "Stddev (ms)", "Median (ms)",
+			"CI Low (ms)", "CI High (ms)", "Trials", "Outliers",
+			"Rate (ops/s)");
+	}
+	else if (k == result_kind::streams) {
+		std::printf("%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s",
+			"Total Size", "Method", "Mean (ms)", "Stddev (ms)",
+			"Median (ms)", "CI Low (ms)", "CI High (ms)", "Trials",
+			"Outliers", "Throughput (MB/s)", "Min Stream (MB/s)",
+			"Mean Stream (MB/s)", "Max Stream (MB/s)", "Fairness");
+	}
+	else {
+		std::printf("%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s", "File Size",
+			"Method", "Mean (ms)", "Stddev (ms)", "Median (ms)",
+			"CI Low (ms)", "CI High (ms)", "Trials", "Outliers",
+			"Throughput (MB/s)", "IOPS");
+	}
+	for (const auto& c : extra_columns) { std::printf(", %s", c); }
+	std::printf("\n");
+	std::fflush(stdout);
+}
+
+/*
+** Writes the result for the engine `name` run on `file_size` bytes with block
+** size `buf_size` and queue depth `queue_depth`. These are zero for engines
+** that are not blocked or not queued, respectively. The throughput and IOPS
+** are computed from the median. The placement and consumer stage are included
+** if they are not the defaults, and the statistics in `x` are written last.
+*/
+static void
+report_result(
+	const char* name,
+	size_t buf_size,
+	unsigned queue_depth,
+	off_t file_size,
+	const sample_summary& s,
+	const report_extras& x = {}
+)
+{
+	auto secs = s.median / 1000;
+	auto mbps = file_size / 1048576.0 / secs;
+	auto iops = buf_size == 0 ? 0.0 :
+		(file_size + buf_size - 1) / buf_size / secs;
+	auto label = config_label(name, buf_size, queue_depth) + context_label();
+
+	if (output_format == report_format::json) {
+		std::printf("%s\n{\"engine\": %s, \"block_size\": %zu, "
+			"\"queue_depth\": %u, \"placement\": %s, \"consumer\": %s, "
+			"\"file_size\": %jd, \"mean_ms\": %f, "
+			"\"stddev_ms\": %f, \"median_ms\": %f, \"ci_low_ms\": %f, \"ci_high_ms\": %f, "
+			"\"trials\": %u, \"outliers\": %u, \"throughput_mbps\": %f, ",
+			detail::results_written == 0 ? "" : ",",
+			detail::json_string(name).c_str(), buf_size, queue_depth,
+			detail::json_string(current_placement.name).c_str(),
+			detail::json_string(consumer_name(current_consumer)).c_str(),
+			(intmax_t)file_size, s.mean, s.stddev, s.median, s.ci_low,
+			s.ci_high, s.trials, s.outliers, mbps);
+		if (buf_size == 0) { std::printf("\"iops\": null, "); }
+		else { std::printf("\"iops\": %f, ", iops); }
+		for (const auto& e : x) { std::printf("\"%s\": %f, ", e.first, e.second); }
+		std::printf("\"samples_ms\": [");
+
+		for (auto i = size_t{0}; i != s.times.size(); ++i) {
+			std::printf("%s%f", i == 0 ? "" : ", ", s.times[i]);
+		}
+		std::printf("]}");
+	}
+	else {
+		std::printf("%jd, %s, %f, %f, %f, %f, %f, %u, %u, %f, ",
+			(intmax_t)file_size, label.c_str(), s.mean, s.stddev,
+			s.median, s.ci_low, s.ci_high, s.trials, s.outliers, mbps);
+		if (buf_size != 0) { std::printf("%f", iops); }
+		for (const auto& e : x) { std::printf(", %f", e.second); }
+		std::printf("\n");
+	}
+
+	++detail::results_written;
+	std::fflush(stdout);
+}
+
+/*
+** Writes the result for the engine `name` run on `streams` files at once,
+** which hold `total_size` bytes in all. The aggregate throughput is computed
+** from the median time for all of the files to be read, and `ss` describes the
+** throughput of the individual files.
+*/
+static void
+report_streams(
+	const char* name,
+	size_t buf_size,
+	unsigned queue_depth,
+	unsigned streams,
+	off_t total_size,
+	const sample_summary& s,
+	const stream_summary& ss
+)
+{
+	auto mbps = total_size / 1048576.0 / (s.median / 1000);
+	auto label = config_label(name, buf_size, queue_depth) + " " +
+		std::to_string(streams) + " streams" + context_label();
+
+	if (output_format == report_format::json) {
+		std::printf("%s\n{\"engine\": %s, \"block_size\": %zu, "
+			"\"queue_depth\": %u, \"streams\": %u, \"placement\": %s, "
+			"\"consumer\": %s, \"file_size\": %jd, \"mean_ms\": %f, \"stddev_ms\": %f, "
+			"\"median_ms\": %f, \"ci_low_ms\": %f, \"ci_high_ms\": %f, "
+			"\"trials\": %u, \"outliers\": %u, \"throughput_mbps\": %f, "
+			"\"min_stream_mbps\": %f, \"mean_stream_mbps\": %f, "
+			"\"max_stream_mbps\": %f, \"fairness\": %f, \"samples_ms\": [",
+			detail::results_written == 0 ? "" : ",",
+			detail::json_string(name).c_str(), buf_size, queue_depth,
+			streams, detail::json_string(current_placement.name).c_str(),
+			detail::json_string(consumer_name(current_consumer)).c_str(),
+			(intmax_t)total_size, s.mean, s.stddev, s.median, s.ci_low,
+			s.ci_high, s.trials, s.outliers, mbps, ss.min_mbps,
+			ss.mean_mbps, ss.max_mbps, ss.fairness);
+		for (auto i = size_t{0}; i != s.times.size(); ++i) {
+			std::printf("%s%f", i == 0 ? "" : ", ", s.times[i]);
+		}
+		std::printf("]}");
+	}
+	else {
+		std::printf("%jd, %s, %f, %f, %f, %f, %f, %u, %u, %f, %f, %f, %f, %f\n",
+			(intmax_t)total_size, label.c_str(), s.mean, s.stddev,
+			s.median, s.ci_low, s.ci_high, s.trials, s.outliers, mbps,
+			ss.min_mbps, ss.mean_mbps, ss.max_mbps, ss.fairness);
+	}
+
+	++detail::results_written;
+	std::fflush(stdout);
+}
+
+/*
+** Writes the result for the metadata operation `name`, run by `threads` threads
+** in a directory with `entries` entries. Each trial performs `ops` operations
+** in total, from which the rate is computed using the median. The parameter
+** `buf_size` is the size of the buffer used to list the directory, or zero if
+** there is none.
+*/
+static void
+report_rate(
+	const char* name,
+	size_t buf_size,
+	unsigned threads,
+	size_t entries,
+	size_t ops,
+	const sample_summary& s
+)
+{
+	auto rate = ops / (s.median / 1000);
+	auto label = config_label(name, buf_size, 0);
+	if (threads > 1) { label += " " + std::to_string(threads) + " threads"; }
+
+	if (output_format == report_format::json) {
+		std::printf("%s\n{\"engine\": %s, \"block_size\": %zu, "
+			"\"threads\": %u, \"entries\": %zu, \"mean_ms\": %f, "
+			"\"stddev_ms\": %f, \"median_ms\": %f, \"ci_low_ms\": %f, "
+			"\"ci_high_ms\": %f, \"trials\": %u, \"outliers\": %u, "
+			"\"ops_per_sec\": %f, \"samples_ms\": [",
+			detail::results_written == 0 ? "" : ",",
+			detail::json_string(name).c_str(), buf_size, threads, entries,
+			s.mean, s.stddev, s.median, s.ci_low, s.ci_high, s.trials,
+			s.outliers, rate);
+		for (auto i = size_t{0}; i != s.times.size(); ++i) {
+			std::printf("%s%f", i == 0 ? "" : ", ", s.times[i]);
+		}
+		std::printf("]}");
+	}
+	else {
+		std::printf("%zu, %s, %f, %f, %f, %f, %f, %u, %u, %f\n", entries,
+			label.c_str(), s.mean, s.stddev, s.median, s.ci_low,
+			s.ci_high, s.trials, s.outliers, rate);
+	}
+
+	++detail::results_written;
+	std::fflush(stdout);
+}
+
+static void
+end_report()
+{
+	if (output_format == report_format::json) {
+		std::printf("\n]\n}\n");
+		std::fflush(stdout);
+	}
+}
+
+#endif
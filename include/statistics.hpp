@@ -0,0 +1,139 @@
+/*
+** File Name:	statistics.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Summary statistics used to decide when a benchmark has been sampled enough.
+** The median is used as the point estimate, since a single trial that gets
+** preempted or that hits a cold metadata cache can drag the mean arbitrarily
+** far. The confidence interval for the median is computed using the
+** percentile bootstrap, which makes no assumption about the shape of the
+** distribution of the trial times.
+*/
+
+#ifndef Z9941A0CB_FDA8_4730_97DA_33CE037BDBC1
+#define Z9941A0CB_FDA8_4730_97DA_33CE037BDBC1
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+struct sample_summary
+{
+	double   mean;
+	double   stddev;
+	double   median;
+	double   ci_low;
+	double   ci_high;
+	unsigned trials;
+	unsigned outliers;
+	// The individual trial times, in the order in which they were taken.
+	std::vector<double> times;
+};
+
+/*
+** Returns the `p`th quantile of the sorted range `[f, l)`, linearly
+** interpolating between the two closest ranks.
+*/
+template <class Iterator>
+static double
+sorted_quantile(Iterator f, Iterator l, double p)
+{
+	assert(f != l);
+	assert(p >= 0 && p <= 1);
+
+	auto n = l - f;
+	auto h = p * (n - 1);
+	auto i = (decltype(n))std::floor(h);
+	if (i + 1 >= n) { return *(f + (n - 1)); }
+	return *(f + i) + (h - i) * (*(f + i + 1) - *(f + i));
+}
+
+static double
+median(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	return sorted_quantile(v.begin(), v.end(), 0.5);
+}
+
+/*
+** Counts the number of samples outside of Tukey's fences, i.e. more than 1.5
+** interquartile ranges below the first quartile or above the third quartile.
+*/
+static unsigned
+count_outliers(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	auto q1 = sorted_quantile(v.begin(), v.end(), 0.25);
+	auto q3 = sorted_quantile(v.begin(), v.end(), 0.75);
+	auto lo = q1 - 1.5 * (q3 - q1);
+	auto hi = q3 + 1.5 * (q3 - q1);
+	return std::count_if(v.begin(), v.end(),
+		[&](auto x) { return x < lo || x > hi; });
+}
+
+/*
+** Computes a percentile bootstrap confidence interval for the median of `v`
+** at the given confidence level, using `resamples` resamples.
+*/
+template <class RNG>
+static std::pair<double, double>
+bootstrap_median_ci(
+	const std::vector<double>& v,
+	unsigned resamples,
+	double level,
+	RNG& gen
+)
+{
+	assert(!v.empty());
+	assert(resamples > 0);
+
+	auto dist = std::uniform_int_distribution<size_t>(0, v.size() - 1);
+	auto r = std::vector<double>(v.size());
+	auto m = std::vector<double>(resamples);
+
+	for (auto& x : m) {
+		std::generate(r.begin(), r.end(), [&]() { return v[dist(gen)]; });
+		std::sort(r.begin(), r.end());
+		x = sorted_quantile(r.begin(), r.end(), 0.5);
+	}
+
+	std::sort(m.begin(), m.end());
+	auto a = (1 - level) / 2;
+	return {
+		sorted_quantile(m.begin(), m.end(), a),
+		sorted_quantile(m.begin(), m.end(), 1 - a)
+	};
+}
+
+template <class RNG>
+static sample_summary
+summarize(
+	const std::vector<double>& v,
+	unsigned resamples,
+	double level,
+	RNG& gen
+)
+{
+	assert(!v.empty());
+
+	auto s = sample_summary{};
+	s.trials = v.size();
+
+	for (const auto& x : v) { s.mean += x; }
+	s.mean /= v.size();
+	for (const auto& x : v) { s.stddev += std::pow(x - s.mean, 2); }
+	s.stddev = std::sqrt(s.stddev / v.size());
+
+	s.median = median(v);
+	s.outliers = count_outliers(v);
+	std::tie(s.ci_low, s.ci_high) = bootstrap_median_ci(v, resamples, level, gen);
+	return s;
+}
+
+#endif
@@ -8,19 +8,73 @@
 #ifndef ZD477B76C_977A_4861_963D_3C448BD98F34
 #define ZD477B76C_977A_4861_963D_3C448BD98F34
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdio>
 #include <chrono>
 #include <cmath>
+#include <exception>
+#include <random>
 #include <ratio>
+#include <thread>
+#include <vector>
 #include <io_common.hpp>
-#include <boost/range/numeric.hpp>
+#include <configuration.hpp>
+#include <report.hpp>
+#include <statistics.hpp>
+#include <trace.hpp>
 
-static void
-print_header()
+/*
+** Runs `sampler.warmup_trials` untimed trials, followed by at least
+** `sampler.min_trials` timed trials. Sampling continues until the bootstrap
+** confidence interval for the median is narrower than `sampler.target_ci_width`
+** times the median, `sampler.max_trials` trials have been run, or
+** `sampler.time_budget` has elapsed. This way, configurations with tight
+** distributions finish quickly, and noisy ones are sampled more.
+**
+** The function `trial` runs one trial and returns its duration in
+** milliseconds; `reset` is called after every trial (including the warm-up
+** trials) to restore the state of the system, and is not timed.
+*/
+template <class Trial, class Reset>
+static sample_summary
+sample_trials(const Trial& trial, const Reset& reset)
 {
-	std::printf("%s, %s, %s, %s\n", "File Size", "Method", "Mean (ms)", "Stddev (ms)");
-	std::fflush(stdout);
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	// The seed is fixed so that the reported intervals are reproducible
+	// for a given sample.
+	auto gen = std::mt19937{0x5EED};
+	auto sample = std::vector<double>{};
+	sample.reserve(sampler.max_trials);
+
+	for (auto i = 0u; i != sampler.warmup_trials; ++i) {
+		trial();
+		reset();
+	}
+
+	auto start = steady_clock::now();
+	for (;;) {
+		sample.push_back(trial());
+		reset();
+
+		if (sample.size() < sampler.min_trials) { continue; }
+		auto s = summarize(sample, sampler.bootstrap_resamples, sampler.ci_level, gen);
+		auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+
+		if (
+			s.ci_high - s.ci_low <= sampler.target_ci_width * s.median ||
+			sample.size() >= sampler.max_trials ||
+			elapsed >= sampler.time_budget
+		) {
+			s.times = std::move(sample);
+			return s;
+		}
+	}
 }
 
 /*
@@ -33,7 +87,9 @@ template <class Function>
 static void test_read(
 	const Function& func,
 	const char* name,
-	unsigned count,
+	size_t buf_size,
+	unsigned queue_depth,
+	off_t count,
 	off_t file_size
 )
 {
@@ -42,119 +98,147 @@ static void test_read(
 	using std::chrono::duration;
 	using milliseconds = duration<double, std::ratio<1, 1000>>;
 
-	auto mean = double{0};
-	auto sample = std::array<double, num_trials>{};
-
-	for (auto i = 0; i != num_trials; ++i) {
-		auto t1 = high_resolution_clock::now();
-		if (func() != count) { throw std::runtime_error{"Mismatching count."}; }
-		auto t2 = high_resolution_clock::now();
-		auto ms = duration_cast<milliseconds>(t2 - t1).count();
-		sample[i] = ms;
-		mean += ms;
-		purge_cache().get();
-	}
-
-	mean /= num_trials;
-	auto stddev = std::sqrt(1.0 / num_trials * boost::accumulate(
-		sample, 0.0, [&](auto x, auto y) {
-			return x + std::pow(y - mean, 2);
-		}));
-
-	std::printf("%jd, %s, %f, %f\n", file_size, name, mean, stddev);
-	std::fflush(stdout);
+	auto s = sample_trials(
+		[&]() {
+			trace_trial();
+			auto t1 = high_resolution_clock::now();
+			if (func() != count) { throw std::runtime_error{"mismatching count"}; }
+			auto t2 = high_resolution_clock::now();
+			return duration_cast<milliseconds>(t2 - t1).count();
+		},
+		[]() { purge_cache().get(); }
+	);
+	report_result(name, buf_size, queue_depth, file_size, s);
 }
 
-template <class Function, class Range>
-static void test_read_range(
+/*
+** Reads `counts.size()` files at once, by calling `func(i)` for each file `i`
+** on its own thread. The threads are started before the clock, and are then
+** released together. File `i` holds `sizes[i]` bytes, and `func(i)` should
+** return `counts[i]`. The throughput of each file is measured from the release
+** of the threads to the return of its call; the median of each statistic in
+** `stream_summary` over the timed trials is reported.
+*/
+template <class Function>
+static void test_streams(
 	const Function& func,
-	const char* path,
 	const char* name,
-	const Range& range,
-	off_t file_size,
-	unsigned count
+	size_t buf_size,
+	unsigned queue_depth,
+	const std::vector<off_t>& counts,
+	const std::vector<off_t>& sizes
 )
-{
-	static constexpr auto kb = 1024;
-	auto buf = std::array<char, 64>{};
-
-	for (const auto& bs : range) {
-		if (bs * kb <= file_size) {
-			std::snprintf(buf.data(), 64, "%s %d KB", name, bs);
-			test_read(std::bind(func, path, bs * kb), buf.data(), count, file_size);
-		}
-	}
-}
-
-template <class Function>
-static void test_write(const Function& func, const char* name, off_t count)
 {
 	using std::chrono::high_resolution_clock;
 	using std::chrono::duration_cast;
 	using std::chrono::duration;
 	using milliseconds = duration<double, std::ratio<1, 1000>>;
 
-	auto mean = double{0};
-	auto sample = std::array<double, num_trials>{};
-
-	for (auto i = 0; i != num_trials; ++i) {
-		auto t1 = high_resolution_clock::now();
-		func();
-		auto t2 = high_resolution_clock::now();
-		auto ms = duration_cast<milliseconds>(t2 - t1).count();
-		sample[i] = ms;
-		mean += ms;
-	}
-
-	mean /= num_trials;
-	auto stddev = std::sqrt(1.0 / num_trials * boost::accumulate(
-		sample, 0.0, [&](auto x, auto y) {
-			return x + std::pow(y - mean, 2);
-		}));
-
-	std::printf("%jd, %s, %f, %f\n", count, name, mean, stddev);
-	std::fflush(stdout);
-}
-
-template <class Function, class Range>
-static void test_write_range(
-	const Function& func,
-	const char* path,
-	const char* name,
-	const Range& range,
-	off_t count
-)
-{
-	static constexpr auto kb = 1024;
-	auto buf = std::array<char, 64>{};
-
-	for (const auto& bs : range) {
-		if (bs * kb <= count) {
-			std::snprintf(buf.data(), 64, "%s %d KB", name, bs);
-			test_write(std::bind(func, path, bs * kb), buf.data(), count);
-		}
-	}
+	auto n = counts.size();
+	auto total = off_t{0};
+	for (const auto& s : sizes) { total += s; }
+	auto min_mbps = std::vector<double>{};
+	auto mean_mbps = std::vector<double>{};
+	auto max_mbps = std::vector<double>{};
+	auto fairness = std::vector<double>{};
+
+	auto s = sample_trials(
+		[&]() {
+			trace_trial();
+			std::atomic<unsigned> ready{0};
+			std::atomic<bool> go{false};
+			auto results = std::vector<off_t>(n);
+			auto ends = std::vector<high_resolution_clock::time_point>(n);
+			auto errors = std::vector<std::exception_ptr>(n);
+			auto ts = std::vector<std::thread>{};
+
+			for (auto i = size_t{0}; i != n; ++i) {
+				ts.emplace_back([&, i]() {
+					ready.fetch_add(1, std::memory_order_release);
+					while (!go.load(std::memory_order_acquire)) {
+						std::this_thread::yield();
+					}
+					try {
+						results[i] = func(i);
+					}
+					catch (...) {
+						errors[i] = std::current_exception();
+					}
+					ends[i] = high_resolution_clock::now();
+				});
+			}
+			while (ready.load(std::memory_order_acquire) != n) {
+				std::this_thread::yield();
+			}
+
+			auto t1 = high_resolution_clock::now();
+			go.store(true, std::memory_order_release);
+			for (auto& t : ts) { t.join(); }
+			for (const auto& e : errors) {
+				if (e) { std::rethrow_exception(e); }
+			}
+
+			auto t2 = t1;
+			auto sum = 0.0;
+			auto sum_sq = 0.0;
+			auto lo = 0.0;
+			auto hi = 0.0;
+			for (auto i = size_t{0}; i != n; ++i) {
+				if (results[i] != counts[i]) {
+					throw std::runtime_error{"mismatching count"};
+				}
+				t2 = std::max(t2, ends[i]);
+				auto secs = duration_cast<milliseconds>(ends[i] - t1).count() / 1000;
+				auto mbps = sizes[i] / 1048576.0 / secs;
+				sum += mbps;
+				sum_sq += mbps * mbps;
+				lo = i == 0 ? mbps : std::min(lo, mbps);
+				hi = std::max(hi, mbps);
+			}
+			min_mbps.push_back(lo);
+			mean_mbps.push_back(sum / n);
+			max_mbps.push_back(hi);
+			fairness.push_back(sum * sum / (n * sum_sq));
+			return duration_cast<milliseconds>(t2 - t1).count();
+		},
+		[]() { purge_cache().get(); }
+	);
+
+	// Leave out the warm-up trials.
+	auto w = std::min(size_t{sampler.warmup_trials}, min_mbps.size() - 1);
+	auto tail_median = [&](const std::vector<double>& v) {
+		return median(std::vector<double>(v.begin() + w, v.end()));
+	};
+	auto ss = stream_summary{tail_median(min_mbps), tail_median(mean_mbps),
+		tail_median(max_mbps), tail_median(fairness)};
+	report_streams(name, buf_size, queue_depth, n, total, s, ss);
 }
 
-template <class Function, class Range>
-static void test_copy_range(
+template <class Function>
+static void test_write(
 	const Function& func,
-	const char* src,
-	const char* dst,
 	const char* name,
-	const Range& range,
+	size_t buf_size,
+	unsigned queue_depth,
 	off_t count
 )
 {
-	static constexpr auto kb = 1024;
-	auto buf = std::array<char, 64>{};
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
 
-	for (const auto& bs : range) {
-		if (bs * kb <= count) {
-			std::snprintf(buf.data(), 64, "%s %d KB", name, bs);
-			test_write(std::bind(func, src, dst, bs * kb), buf.data(), count);
-		}
-	}
+	auto s = sample_trials(
+		[&]() {
+			trace_trial();
+			auto t1 = high_resolution_clock::now();
+			func();
+			auto t2 = high_resolution_clock::now();
+			return duration_cast<milliseconds>(t2 - t1).count();
+		},
+		[]() {}
+	);
+	report_result(name, buf_size, queue_depth, count, s);
 }
 
 #endif
@@ -0,0 +1,427 @@
+/*
+** File Name:	trace.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Records one fixed-size binary record for every IO issued by the engines, so
+** that the behavior behind a summary statistic (e.g. a large standard
+** deviation) can be examined after the fact with `out/analyze_trace.run`.
+**
+** Each thread that issues IO appends its records to its own ring buffer, which
+** only that thread writes and only the background thread started by
+** `tracer::start` reads. Neither side takes a lock, and a thread whose ring is
+** full drops the record (the number of dropped records is reported) rather
+** than wait. When tracing is off, the cost of a traced call is one relaxed
+** atomic load; when it is on, it is two reads of the monotonic clock and a
+** copy into the ring.
+**
+** The trace file consists of a `trace_header`, followed by `trace_record`s in
+** no particular order, in the byte order of the machine that wrote it. Each
+** configuration that is run is given an engine ID, and a record with the op
+** `trace_op::engine` gives its name (see `trace_record::name`). A record with
+** the op `trace_op::trial` marks the start of each trial.
+*/
+
+#ifndef ZB03AD396_33E0_4B4D_91EE_9E02CE6D1D96
+#define ZB03AD396_33E0_4B4D_91EE_9E02CE6D1D96
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+enum class trace_op : uint8_t
+{
+	read     = 0,
+	write    = 1,
+	aio_read = 2,
+	splice   = 3,
+	sendfile = 4,
+	// A call to `copy_file_range`.
+	copy_range = 5,
+	// A read through `io_uring`.
+	uring_read = 6,
+	// Marks the start of a trial; only the timestamps are meaningful.
+	trial    = 254,
+	// Gives the name of an engine; see `trace_record::name`.
+	engine   = 255
+};
+
+struct trace_header
+{
+	char     magic[8]{'I', 'O', 'T', 'R', 'A', 'C', 'E', '\0'};
+	uint32_t version{1};
+	uint32_t record_size{48};
+};
+
+struct trace_record
+{
+	uint16_t engine;
+	uint8_t  op;
+	uint8_t  reserved;
+	uint32_t thread;
+	int64_t  offset;
+	uint64_t length;
+	// Times at which the IO was issued and found to have completed, in
+	// nanoseconds on the monotonic clock.
+	uint64_t submit_ns;
+	uint64_t complete_ns;
+	// Number of bytes transferred, or the negated error code.
+	int64_t  result;
+
+	/*
+	** For records with the op `trace_op::engine`, the fields after
+	** `thread` instead hold part of the name of the engine, padded with
+	** null characters. A name longer than `name_size` is split over
+	** several consecutive records.
+	*/
+	std::string name() const
+	{
+		auto p = (const char*)this + offsetof(trace_record, offset);
+		return std::string{p, strnlen(p, name_size)};
+	}
+
+	static constexpr size_t name_size = 40;
+};
+
+static_assert(sizeof(trace_record) == 48, "Unexpected size of trace record.");
+
+namespace detail {
+
+/*
+** A single-producer, single-consumer ring of trace records.
+*/
+class trace_ring
+{
+	static constexpr size_t capacity = 8192;
+
+	std::unique_ptr<trace_record[]> recs{new trace_record[capacity]};
+	// The padding keeps the indices, which are written by different
+	// threads, on different cache lines.
+	char pad1[64];
+	std::atomic<size_t> head{0};
+	char pad2[64];
+	std::atomic<size_t> tail{0};
+	char pad3[64];
+public:
+	// Whether a live thread owns this ring.
+	std::atomic<bool> in_use{true};
+
+	bool push(const trace_record& r) noexcept
+	{
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == capacity) {
+			return false;
+		}
+		recs[t % capacity] = r;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const noexcept
+	{
+		return head.load(std::memory_order_acquire) ==
+			tail.load(std::memory_order_acquire);
+	}
+
+	template <class Function>
+	void drain(const Function& f)
+	{
+		auto h = head.load(std::memory_order_relaxed);
+		auto t = tail.load(std::memory_order_acquire);
+		for (; h != t; ++h) { f(recs[h % capacity]); }
+		head.store(t, std::memory_order_release);
+	}
+};
+
+}
+
+class tracer
+{
+	std::mutex m;
+	// Rings are never freed, since a thread may still hold a pointer to
+	// one after tracing stops. The ring of a thread that has exited is
+	// reused once it has been drained.
+	std::vector<std::unique_ptr<detail::trace_ring>> rings;
+	std::vector<std::string> engines;
+	std::FILE* file{nullptr};
+	std::thread drainer;
+	std::atomic<bool> stop{false};
+	std::atomic<unsigned> gen{0};
+	std::atomic<uint32_t> next_thread{0};
+	std::atomic<uint64_t> dropped{0};
+	uint64_t written{0};
+
+	struct thread_state
+	{
+		detail::trace_ring* ring{nullptr};
+		unsigned gen{0};
+		uint32_t id{0};
+
+		~thread_state()
+		{ if (ring != nullptr) { ring->in_use.store(false, std::memory_order_release); } }
+	};
+
+	static thread_state& this_thread()
+	{
+		static thread_local thread_state s;
+		return s;
+	}
+public:
+	std::atomic<bool> enabled{false};
+
+	tracer() {}
+	tracer(const tracer&) = delete;
+	tracer& operator=(const tracer&) = delete;
+
+	~tracer()
+	{ if (file != nullptr) { finish(); } }
+
+	/*
+	** Starts writing the trace to the file at `path`.
+	*/
+	void start(const char* path)
+	{
+		auto f = std::fopen(path, "wb");
+		if (f == nullptr) { throw std::system_error{errno, std::system_category()}; }
+		auto h = trace_header{};
+		if (std::fwrite(&h, sizeof(h), 1, f) != 1) {
+			std::fclose(f);
+			throw std::system_error{errno, std::system_category()};
+		}
+
+		file = f;
+		written = 0;
+		engines.clear();
+		dropped.store(0, std::memory_order_relaxed);
+		stop.store(false, std::memory_order_relaxed);
+		gen.fetch_add(1, std::memory_order_relaxed);
+		drainer = std::thread{[this] { drain_loop(); }};
+		enabled.store(true, std::memory_order_release);
+	}
+
+	/*
+	** Stops tracing, writes the remaining records, and closes the file.
+	** Returns the number of records written and dropped.
+	*/
+	std::pair<uint64_t, uint64_t> finish()
+	{
+		enabled.store(false, std::memory_order_release);
+		stop.store(true, std::memory_order_release);
+		drainer.join();
+		drain_all();
+
+		auto r = std::fclose(file);
+		file = nullptr;
+		if (r != 0) { throw std::system_error{errno, std::system_category()}; }
+		return {written, dropped.load(std::memory_order_relaxed)};
+	}
+
+	/*
+	** Returns the ID for the engine with the given name, and records the
+	** name the first time that it is seen.
+	*/
+	uint16_t engine_id(const std::string& name)
+	{
+		auto id = uint16_t{};
+		{
+			std::lock_guard<std::mutex> g{m};
+			auto it = std::find(engines.begin(), engines.end(), name);
+			if (it != engines.end()) { return it - engines.begin(); }
+			id = engines.size();
+			engines.push_back(name);
+		}
+
+		// Long names are split over several records, which are written
+		// in order since they come from the same ring.
+		auto n = trace_record::name_size;
+		for (auto i = size_t{0}; i == 0 || i < name.size(); i += n) {
+			auto r = trace_record{};
+			r.engine = id;
+			r.op = uint8_t(trace_op::engine);
+			std::memcpy((char*)&r + offsetof(trace_record, offset),
+				name.data() + i, std::min(name.size() - i, n));
+			push(r);
+		}
+		return id;
+	}
+
+	void push(trace_record& r) noexcept
+	{
+		auto& s = this_thread();
+		auto g = gen.load(std::memory_order_relaxed);
+		if (s.ring == nullptr || s.gen != g) {
+			if (!attach(s, g)) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		r.thread = s.id;
+		if (!s.ring->push(r)) { dropped.fetch_add(1, std::memory_order_relaxed); }
+	}
+private:
+	bool attach(thread_state& s, unsigned g) noexcept
+	{
+		s.gen = g;
+		s.id = next_thread.fetch_add(1, std::memory_order_relaxed);
+		if (s.ring != nullptr) { return true; }
+
+		try {
+			std::lock_guard<std::mutex> lock{m};
+			for (auto& r : rings) {
+				if (!r->in_use.load(std::memory_order_acquire) && r->empty()) {
+					r->in_use.store(true, std::memory_order_relaxed);
+					s.ring = r.get();
+					return true;
+				}
+			}
+			rings.emplace_back(new detail::trace_ring{});
+			s.ring = rings.back().get();
+			return true;
+		}
+		catch (...) {
+			return false;
+		}
+	}
+
+	void drain_all()
+	{
+		std::lock_guard<std::mutex> g{m};
+		for (auto& r : rings) {
+			r->drain([&](const trace_record& x) {
+				if (std::fwrite(&x, sizeof(x), 1, file) == 1) { ++written; }
+			});
+		}
+	}
+
+	void drain_loop()
+	{
+		while (!stop.load(std::memory_order_acquire)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+			drain_all();
+		}
+	}
+};
+
+static tracer io_trace{};
+
+// The ID of the engine that is being run. This is set by the driver.
+static auto current_trace_engine = uint16_t{0};
+
+static uint64_t
+trace_clock() noexcept
+{
+	auto ts = timespec{};
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/*
+** Returns the time at which an IO is about to be issued, or zero if tracing is
+** off.
+*/
+static uint64_t
+trace_begin() noexcept
+{
+	if (!io_trace.enabled.load(std::memory_order_relaxed)) { return 0; }
+	return trace_clock();
+}
+
+/*
+** Records an IO that was issued at `t`, as returned by `trace_begin`. The
+** value `r` is the return value of the system call; if it is -1, then `errno`
+** is recorded instead. The value of `errno` is preserved, so that the caller
+** can still inspect it afterwards.
+*/
+static void
+trace_end(trace_op op, off_t off, size_t len, uint64_t t, int64_t r) noexcept
+{
+	if (t == 0) { return; }
+	auto e = errno;
+	auto x = trace_record{};
+	x.engine = current_trace_engine;
+	x.op = uint8_t(op);
+	x.offset = off;
+	x.length = len;
+	x.submit_ns = t;
+	x.complete_ns = trace_clock();
+	x.result = r == -1 ? -e : r;
+	// Registering the calling thread with the trace allocates, which
+	// can change `errno`.
+	io_trace.push(x);
+	errno = e;
+}
+
+static void
+trace_trial() noexcept
+{
+	auto t = trace_begin();
+	trace_end(trace_op::trial, 0, 0, t, 0);
+}
+
+struct trace_file
+{
+	// Names of the engines, indexed by ID.
+	std::vector<std::string> engines;
+	// All records other than those that give the names of engines.
+	std::vector<trace_record> records;
+};
+
+static trace_file
+read_trace(const char* path)
+{
+	auto f = std::fopen(path, "rb");
+	if (f == nullptr) { throw std::system_error{errno, std::system_category()}; }
+
+	auto r = trace_file{};
+	auto h = trace_header{};
+	auto expected = trace_header{};
+	if (
+		std::fread(&h, sizeof(h), 1, f) != 1 ||
+		std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0
+	) {
+		std::fclose(f);
+		throw std::runtime_error{std::string{"\""} + path + "\" is not a trace"};
+	}
+	if (h.version != expected.version || h.record_size != sizeof(trace_record)) {
+		std::fclose(f);
+		throw std::runtime_error{"unsupported trace version " +
+			std::to_string(h.version)};
+	}
+
+	auto x = trace_record{};
+	while (std::fread(&x, sizeof(x), 1, f) == 1) {
+		if (x.op != uint8_t(trace_op::engine)) {
+			r.records.push_back(x);
+			continue;
+		}
+		if (r.engines.size() <= x.engine) { r.engines.resize(x.engine + 1); }
+		r.engines[x.engine] += x.name();
+	}
+	auto err = std::ferror(f);
+	std::fclose(f);
+	if (err) { throw std::runtime_error{"failed to read trace"}; }
+
+	for (const auto& x : r.records) {
+		if (r.engines.size() <= x.engine) { r.engines.resize(x.engine + 1); }
+	}
+	for (auto i = size_t{0}; i != r.engines.size(); ++i) {
+		if (r.engines[i].empty()) { r.engines[i] = "engine " + std::to_string(i); }
+	}
+	return r;
+}
+
+#endif
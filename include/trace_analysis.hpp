@@ -0,0 +1,369 @@
+/*
+** File Name:	trace_analysis.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Summarizes a trace written by `benchmark.run --trace` (see `trace.hpp`). For
+** each configuration, the latencies of the IOs, the number of IOs in flight
+** over time, the gaps between successive submissions, and the stalls of each
+** thread (gaps between the completion of one of its IOs and the submission of
+** the next) are reported. Gaps that span the start of a trial are ignored,
+** since they include the time taken to purge the page cache.
+*/
+
+#ifndef ZF8F5ABD5_DA86_4CF7_A045_D12F334ED1D3
+#define ZF8F5ABD5_DA86_4CF7_A045_D12F334ED1D3
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/filesystem/compiled_glob.hpp>
+
+#include <options.hpp>
+#include <statistics.hpp>
+#include <trace.hpp>
+
+struct analysis_options
+{
+	const char* path{nullptr};
+	// Glob patterns for the configurations to summarize. If this is empty,
+	// all of them are summarized.
+	std::vector<std::string> engines;
+	// Gaps longer than this are counted as stalls.
+	double stall_ms{1};
+	// If nonzero, the mean queue depth over each interval of this length
+	// is printed instead of the summary.
+	double timeline_ms{0};
+};
+
+/*
+** The records of one configuration, sorted by submission time, along with
+** the times at which its trials started.
+*/
+struct engine_trace
+{
+	std::string name;
+	std::vector<trace_record> ios;
+	std::vector<uint64_t> trials;
+
+	/*
+	** Determines whether a trial started in the interval `(a, b]`.
+	*/
+	bool crosses_trial(uint64_t a, uint64_t b) const
+	{
+		auto it = std::upper_bound(trials.begin(), trials.end(), a);
+		return it != trials.end() && *it <= b;
+	}
+};
+
+static std::vector<engine_trace>
+split_trace(const trace_file& t, const analysis_options& o)
+{
+	auto set = o.engines.empty() ? nullptr :
+		std::unique_ptr<cc::glob_set>{new cc::glob_set{o.engines}};
+	auto r = std::vector<engine_trace>(t.engines.size());
+	for (auto i = size_t{0}; i != r.size(); ++i) { r[i].name = t.engines[i]; }
+
+	for (const auto& x : t.records) {
+		if (x.op == uint8_t(trace_op::trial)) {
+			r[x.engine].trials.push_back(x.submit_ns);
+		}
+		else {
+			r[x.engine].ios.push_back(x);
+		}
+	}
+
+	r.erase(std::remove_if(r.begin(), r.end(), [&](const engine_trace& e) {
+		return e.ios.empty() || (set && !(*set)(e.name.c_str()));
+	}), r.end());
+
+	for (auto& e : r) {
+		std::sort(e.ios.begin(), e.ios.end(),
+			[](const auto& a, const auto& b) { return a.submit_ns < b.submit_ns; });
+		std::sort(e.trials.begin(), e.trials.end());
+	}
+	return r;
+}
+
+/*
+** Returns the changes in the number of IOs in flight, sorted by time.
+** Completions are ordered before submissions that happen at the same time.
+*/
+static std::vector<std::pair<uint64_t, int>>
+depth_events(const engine_trace& e)
+{
+	auto r = std::vector<std::pair<uint64_t, int>>{};
+	r.reserve(2 * e.ios.size());
+	for (const auto& x : e.ios) {
+		r.emplace_back(x.submit_ns, 1);
+		r.emplace_back(x.complete_ns, -1);
+	}
+	std::sort(r.begin(), r.end());
+	return r;
+}
+
+static void
+print_quantiles(const char* what, std::vector<double> v)
+{
+	if (v.empty()) {
+		std::printf("  %s: none\n", what);
+		return;
+	}
+	std::sort(v.begin(), v.end());
+	std::printf("  %s (us): p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n", what,
+		sorted_quantile(v.begin(), v.end(), 0.5),
+		sorted_quantile(v.begin(), v.end(), 0.9),
+		sorted_quantile(v.begin(), v.end(), 0.99), v.back());
+}
+
+static void
+print_queue_depth(const engine_trace& e)
+{
+	// Time-weighted sum of the depth over the periods in which at least
+	// one IO is in flight.
+	auto busy = uint64_t{0};
+	auto sum = 0.0;
+	auto depth = 0;
+	auto max_depth = 0;
+	auto last = uint64_t{0};
+
+	for (const auto& ev : depth_events(e)) {
+		if (depth > 0) {
+			busy += ev.first - last;
+			sum += double(depth) * (ev.first - last);
+		}
+		depth += ev.second;
+		max_depth = std::max(max_depth, depth);
+		last = ev.first;
+	}
+
+	// The time spent in the trials, from the start of each trial to the
+	// last completion before the next one.
+	auto span = uint64_t{0};
+	auto start = e.trials.empty() ? e.ios.front().submit_ns : e.trials.front();
+	auto end = start;
+	for (const auto& x : e.ios) {
+		if (e.crosses_trial(end, x.submit_ns)) {
+			span += end - start;
+			start = *std::upper_bound(e.trials.begin(), e.trials.end(), end);
+			end = start;
+		}
+		end = std::max(end, x.complete_ns);
+	}
+	span += end - start;
+
+	std::printf("  Queue depth: mean %.2f while busy, max %d; busy %.1f%% of "
+		"%.3f ms\n", busy == 0 ? 0.0 : sum / busy, max_depth,
+		span == 0 ? 0.0 : 100.0 * busy / span, span / 1e6);
+}
+
+static void
+print_stalls(const engine_trace& e, double stall_ms)
+{
+	struct thread_stalls
+	{
+		size_t ios{0};
+		size_t stalls{0};
+		uint64_t idle{0};
+		uint64_t longest{0};
+		int64_t longest_offset{0};
+		uint64_t last_complete{0};
+	};
+
+	auto threshold = uint64_t(stall_ms * 1e6);
+	auto ts = std::map<uint32_t, thread_stalls>{};
+
+	for (const auto& x : e.ios) {
+		auto& t = ts[x.thread];
+		auto p = t.last_complete;
+		++t.ios;
+		t.last_complete = std::max(p, x.complete_ns);
+		if (p == 0 || x.submit_ns <= p || e.crosses_trial(p, x.submit_ns)) {
+			continue;
+		}
+
+		auto gap = x.submit_ns - p;
+		t.idle += gap;
+		if (gap < threshold) { continue; }
+		++t.stalls;
+		if (gap > t.longest) {
+			t.longest = gap;
+			t.longest_offset = x.offset;
+		}
+	}
+
+	auto stalled = size_t{0};
+	for (const auto& p : ts) {
+		const auto& t = p.second;
+		if (t.stalls == 0) { continue; }
+		++stalled;
+		std::printf("  Thread %u: %zu IOs, idle %.3f ms, %zu stalls, longest "
+			"%.3f ms before offset %jd\n", p.first, t.ios, t.idle / 1e6,
+			t.stalls, t.longest / 1e6, (intmax_t)t.longest_offset);
+	}
+	std::printf("  Stalls: %zu of %zu threads stalled for at least %g ms\n",
+		stalled, ts.size(), stall_ms);
+}
+
+static void
+summarize_engine(const engine_trace& e, const analysis_options& o)
+{
+	auto bytes = uint64_t{0};
+	auto errors = size_t{0};
+	auto lat = std::vector<double>{};
+	auto gaps = std::vector<double>{};
+	lat.reserve(e.ios.size());
+
+	for (auto i = size_t{0}; i != e.ios.size(); ++i) {
+		const auto& x = e.ios[i];
+		if (x.result < 0) { ++errors; }
+		else { bytes += x.result; }
+		lat.push_back((x.complete_ns - x.submit_ns) / 1e3);
+
+		if (i == 0) { continue; }
+		const auto& p = e.ios[i - 1];
+		if (!e.crosses_trial(p.submit_ns, x.submit_ns)) {
+			gaps.push_back((x.submit_ns - p.submit_ns) / 1e3);
+		}
+	}
+
+	std::printf("%s\n", e.name.c_str());
+	std::printf("  IOs: %zu in %zu trials, %s, %zu errors\n", e.ios.size(),
+		std::max(e.trials.size(), size_t{1}), format_size(bytes).c_str(), errors);
+	print_quantiles("Latency", std::move(lat));
+	print_queue_depth(e);
+	print_quantiles("Inter-arrival", std::move(gaps));
+	print_stalls(e, o.stall_ms);
+}
+
+/*
+** Prints the mean number of IOs in flight over each interval of `step_ns`
+** nanoseconds, starting from the first submission.
+*/
+static void
+print_timeline(const engine_trace& e, uint64_t step_ns)
+{
+	auto evs = depth_events(e);
+	auto origin = evs.front().first;
+	auto bucket = uint64_t{0};
+	auto sum = 0.0;
+	auto depth = 0;
+	auto last = origin;
+
+	auto flush = [&]() {
+		std::printf("\"%s\", %f, %f\n", e.name.c_str(),
+			bucket * step_ns / 1e6, sum / step_ns);
+		sum = 0;
+		++bucket;
+	};
+
+	for (const auto& ev : evs) {
+		while (ev.first >= origin + (bucket + 1) * step_ns) {
+			auto b = origin + (bucket + 1) * step_ns;
+			sum += double(depth) * (b - last);
+			last = b;
+			flush();
+		}
+		sum += double(depth) * (ev.first - last);
+		depth += ev.second;
+		last = ev.first;
+	}
+	if (sum != 0) { flush(); }
+}
+
+static void
+print_analysis_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] trace\n"
+"\n"
+"Summarizes a trace written by benchmark.run --trace: the latency of the IOs,\n"
+"the queue depth, the gaps between submissions, and the stalls of each thread.\n"
+"\n"
+"Options:\n"
+"  -e, --engines GLOB[,GLOB...]  Configurations to summarize (default: all).\n"
+"  -s, --stall MS                Gaps longer than MS count as stalls (default: 1).\n"
+"  -t, --timeline MS             Instead of the summary, print the mean queue\n"
+"                                depth over each interval of MS as CSV.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+analyze_main(int argc, char** argv)
+{
+	auto o = analysis_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_analysis_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-e", "--engines")) {
+				auto g = split(value(), ',');
+				o.engines.insert(o.engines.end(), g.begin(), g.end());
+			}
+			else if (is_option(a, "-s", "--stall")) {
+				o.stall_ms = parse_real(value());
+			}
+			else if (is_option(a, "-t", "--timeline")) {
+				o.timeline_ms = parse_real(value());
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else if (o.path != nullptr) {
+				throw std::invalid_argument{"more than one trace given"};
+			}
+			else {
+				o.path = a;
+			}
+		}
+		if (o.path == nullptr) { throw std::invalid_argument{"no trace given"}; }
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	auto t = trace_file{};
+	try {
+		t = read_trace(o.path);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to open \"$\": $.", o.path, e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	auto es = split_trace(t, o);
+	if (o.timeline_ms > 0) {
+		std::printf("Engine, Time (ms), Mean Queue Depth\n");
+		for (const auto& e : es) { print_timeline(e, uint64_t(o.timeline_ms * 1e6)); }
+		return EXIT_SUCCESS;
+	}
+
+	for (auto i = size_t{0}; i != es.size(); ++i) {
+		if (i != 0) { std::printf("\n"); }
+		summarize_engine(es[i], o);
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
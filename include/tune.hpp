@@ -0,0 +1,345 @@
+/*
+** File Name:	tune.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Searches the space of engines, block sizes, and queue depths for the fastest
+** configuration on a given device and file size, without running the full grid.
+** The search uses successive halving: every candidate is first timed once, and
+** after each round only the fastest `1 / eta` of the candidates are kept and
+** timed `eta` times as often. Most of the time is thus spent telling apart the
+** few configurations that are actually competitive. The winners are written
+** to a tuning profile (see `profile.hpp`).
+*/
+
+#ifndef Z3D2CC9A6_4F28_4B84_BD49_4D2FB4A51DEA
+#define Z3D2CC9A6_4F28_4B84_BD49_4D2FB4A51DEA
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <ratio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <ccbase/format.hpp>
+
+#include <configuration.hpp>
+#include <driver.hpp>
+#include <environment.hpp>
+#include <options.hpp>
+#include <profile.hpp>
+#include <statistics.hpp>
+
+struct tuner_options
+{
+	// Number of trials of each candidate in the first round.
+	unsigned initial_trials{1};
+	// Factor by which the number of candidates is reduced in each round.
+	unsigned eta{3};
+	// Time budget for the search for one file, in milliseconds. When it
+	// runs out, the fastest candidate so far is chosen.
+	double time_budget{300000};
+	const char* profile{"data/profile.txt"};
+};
+
+struct candidate
+{
+	const engine* e;
+	size_t buf_size;
+	unsigned queue_depth;
+	std::vector<double> times;
+	double median;
+};
+
+/*
+** Narrows `cs` down to a single candidate by successive halving, and returns
+** it. The function `trial` times one run of the given candidate, in
+** milliseconds. The number of trials of each candidate is capped at
+** `sampler.max_trials`.
+*/
+template <class Trial>
+static candidate
+successive_halving(
+	std::vector<candidate> cs,
+	const tuner_options& o,
+	const Trial& trial
+)
+{
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	if (cs.empty()) { throw std::invalid_argument{"no engines to tune"}; }
+
+	auto start = steady_clock::now();
+	auto elapsed = [&]() {
+		return duration_cast<milliseconds>(steady_clock::now() - start).count();
+	};
+	auto target = std::min(o.initial_trials, sampler.max_trials);
+
+	for (auto round = 1u;; ++round) {
+		for (auto& c : cs) {
+			// The first candidate is always run once, so that one is
+			// left even if the budget runs out before the first trial.
+			while (c.times.size() < target && (elapsed() < o.time_budget ||
+				(&c == &cs.front() && c.times.empty())))
+			{
+				c.times.push_back(trial(c));
+			}
+			if (!c.times.empty()) { c.median = median(c.times); }
+		}
+
+		// If the budget ran out during the first round, then the
+		// candidates that were never run are dropped. At least the
+		// first one remains.
+		cs.erase(std::remove_if(cs.begin(), cs.end(),
+			[](const candidate& c) { return c.times.empty(); }), cs.end());
+		assert(!cs.empty());
+		std::stable_sort(cs.begin(), cs.end(),
+			[](const candidate& a, const candidate& b) {
+				return a.median < b.median;
+			});
+
+		cc::errln("Round $: $ candidates, $ trials each; fastest is $ ($ ms).",
+			round, cs.size(), target, config_label(cs[0].e->name.c_str(),
+			cs[0].buf_size, cs[0].queue_depth), cs[0].median);
+
+		if (cs.size() == 1 || elapsed() >= o.time_budget) { break; }
+		cs.resize((cs.size() + o.eta - 1) / o.eta);
+		if (cs.size() == 1) { break; }
+		target = std::min(target * o.eta, sampler.max_trials);
+	}
+	return cs[0];
+}
+
+/*
+** Returns one candidate for each configuration of the selected engines of
+** kind `k` that applies to a file of the given size.
+*/
+static std::vector<candidate>
+make_candidates(
+	const std::vector<const engine*>& es,
+	const driver_options& d,
+	engine_kind k,
+	off_t file_size
+)
+{
+	auto cs = std::vector<candidate>{};
+	run_kind(es, d, k, file_size,
+		[&](const engine& e, size_t bs, unsigned qd) {
+			cs.push_back({&e, bs, qd, {}, 0});
+		});
+	return cs;
+}
+
+template <class Function>
+static double
+time_trial(const Function& f)
+{
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::duration;
+	using milliseconds = duration<double, std::ratio<1, 1000>>;
+
+	auto t1 = steady_clock::now();
+	f();
+	auto t2 = steady_clock::now();
+	return duration_cast<milliseconds>(t2 - t1).count();
+}
+
+static profile_entry
+make_entry(engine_kind k, off_t file_size, const candidate& c)
+{
+	return {k, file_size, c.e->name, c.buf_size, c.queue_depth, c.median,
+		file_size / 1048576.0 / (c.median / 1000)};
+}
+
+static tuning_profile
+tune_engines(
+	const engine_registry& r,
+	const driver_options& d,
+	const tuner_options& o
+)
+{
+	auto es = r.select(d.engines);
+	auto p = tuning_profile{};
+
+	auto tune = [&](engine_kind k, off_t fs, const char* what, const auto& trial) {
+		cc::errln("Tuning $ engines for $ ($ bytes).", kind_name(k), what, fs);
+		auto c = successive_halving(make_candidates(es, d, k, fs), o, trial);
+		p.push_back(make_entry(k, fs, c));
+		cc::println("$ $: $ ($ MB/s)", kind_name(k), fs,
+			config_label(c.e->name.c_str(), c.buf_size, c.queue_depth),
+			p.back().throughput_mbps);
+	};
+
+	if (selected(d, engine_kind::read)) {
+		for (const auto& path : d.inputs) {
+			auto fd = safe_open(path, O_RDONLY).get();
+			auto fs = file_size(fd).get();
+			safe_close(fd).get();
+			auto count = check(path);
+
+			tune(engine_kind::read, fs, path, [&](const candidate& c) {
+				auto j = engine_job{path, nullptr, c.buf_size, 0, c.queue_depth};
+				purge_cache().get();
+				auto n = off_t{};
+				auto t = time_trial([&]() { n = c.e->run(j); });
+				if (n != count) { throw std::runtime_error{"mismatching count"}; }
+				return t;
+			});
+		}
+	}
+
+	if (selected(d, engine_kind::write)) {
+		for (const auto& count : d.file_sizes) {
+			// Dummy write to create the file.
+			write_plain(d.output, 4096, count);
+			tune(engine_kind::write, count, d.output, [&](const candidate& c) {
+				auto j = engine_job{nullptr, d.output, c.buf_size, count,
+					c.queue_depth};
+				return time_trial([&]() { c.e->run(j); });
+			});
+		}
+	}
+
+	if (selected(d, engine_kind::copy)) {
+		for (const auto& path : d.inputs) {
+			auto fd = safe_open(path, O_RDONLY).get();
+			auto fs = file_size(fd).get();
+			safe_close(fd).get();
+
+			tune(engine_kind::copy, fs, path, [&](const candidate& c) {
+				auto j = engine_job{path, d.output, c.buf_size, 0, c.queue_depth};
+				return time_trial([&]() { c.e->run(j); });
+			});
+		}
+	}
+	return p;
+}
+
+static void
+print_tune_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options] [file ...]\n"
+"\n"
+"Finds the fastest configuration of the selected engines for each file (read\n"
+"and copy engines) and each file size (write engines), and writes the results\n"
+"to a tuning profile.\n"
+"\n"
+"Options:\n"
+"  -e, --engines GLOB[,GLOB...]  Engines to consider (default: all enabled engines).\n"
+"  -k, --kinds KIND[,KIND...]    Kinds of engines to tune: read, write, copy.\n"
+"  -b, --block-sizes LIST        Block sizes to consider, e.g. 4K-16M.\n"
+"  -q, --queue-depths LIST       Queue depths to consider for queued engines.\n"
+"  -s, --file-sizes LIST         Sizes of the files written by write engines.\n"
+"  -o, --output PATH             File written by write and copy engines.\n"
+"  -p, --profile PATH            Where to write the profile (default: data/profile.txt).\n"
+"      --eta N                   Keep the fastest 1/N candidates after each round.\n"
+"      --initial-trials N        Trials of each candidate in the first round.\n"
+"      --max-trials N            Maximum number of trials of any candidate.\n"
+"      --budget SECONDS          Time budget for the search for each file.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+tune_main(int argc, char** argv)
+{
+	auto d = driver_options{};
+	auto o = tuner_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_tune_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-e", "--engines")) {
+				auto g = split(value(), ',');
+				d.engines.insert(d.engines.end(), g.begin(), g.end());
+			}
+			else if (is_option(a, "-k", "--kinds")) {
+				for (const auto& k : split(value(), ',')) {
+					d.kinds.push_back(parse_kind(k));
+				}
+			}
+			else if (is_option(a, "-b", "--block-sizes")) {
+				d.block_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-q", "--queue-depths")) {
+				d.queue_depths = parse_depth_list(value());
+			}
+			else if (is_option(a, "-s", "--file-sizes")) {
+				d.file_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-o", "--output")) {
+				d.output = value();
+			}
+			else if (is_option(a, "-p", "--profile")) {
+				o.profile = value();
+			}
+			else if (is_option(a, nullptr, "--eta")) {
+				o.eta = parse_count(value());
+				if (o.eta < 2) {
+					throw std::invalid_argument{"eta must be at least two"};
+				}
+			}
+			else if (is_option(a, nullptr, "--initial-trials")) {
+				o.initial_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				o.time_budget = 1000 * parse_real(value());
+			}
+			else if (a[0] == '-' && a[1] != '\0') {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+			else {
+				d.inputs.push_back(a);
+			}
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	auto paths = d.inputs;
+	if (selected(d, engine_kind::write) || selected(d, engine_kind::copy)) {
+		paths.push_back(d.output);
+	}
+	auto env = capture_environment(paths);
+
+	try {
+		auto p = tune_engines(make_registry(), d, o);
+		write_profile(o.profile, env, p);
+		cc::errln("Wrote profile to \"$\".", o.profile);
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (const std::runtime_error& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,866 @@
+/*
+** File Name:	uring.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Write and copy engines built on `io_uring`, called through `syscall` so that
+** `liburing` is not needed. The writes use buffers registered with the ring
+** (`IORING_OP_WRITE_FIXED`), so that the kernel does not pin the pages of each
+** buffer on every request. The copies submit each block as a chain of two
+** linked requests, so that the write is issued by the kernel as soon as the
+** read completes, without a round trip through user space: either a read into
+** a registered buffer followed by a write from it, or a splice from the input
+** into a pipe followed by a splice from the pipe into the output.
+**
+** Each engine can also be run on a ring set up with `IORING_SETUP_SQPOLL`, for
+** which a kernel thread picks up the requests as they are queued (so that
+** submitting them takes no system call), or with `IORING_SETUP_IOPOLL`, for
+** which completions are found by polling the device instead of by interrupts
+** (which only works with `O_DIRECT`). The variants that the kernel does not
+** allow are not registered. The polling thread of `SQPOLL` keeps spinning for
+** `sq_thread_idle` milliseconds after the ring goes idle, so it competes for a
+** core with the thread that submits the requests.
+*/
+
+#ifndef Z32B53A1A_B718_4009_9044_618A956EA6E2
+#define Z32B53A1A_B718_4009_9044_618A956EA6E2
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <ccbase/format.hpp>
+
+#include <configuration.hpp>
+#include <copy_common.hpp>
+#include <io_common.hpp>
+#include <registry.hpp>
+#include <trace.hpp>
+#include <write_common.hpp>
+
+/*
+** Owns an `io_uring` instance with room for `entries` requests, along with the
+** mappings of its submission and completion queues.
+*/
+class uring
+{
+	static constexpr auto sq_thread_idle = 50u;
+
+	int m_fd{-1};
+	unsigned m_flags;
+	uint8_t* m_sq_ring{nullptr};
+	size_t m_sq_ring_size{0};
+	uint8_t* m_cq_ring{nullptr};
+	size_t m_cq_ring_size{0};
+	io_uring_sqe* m_sqes{nullptr};
+	size_t m_sqes_size{0};
+
+	unsigned* m_sq_head;
+	unsigned* m_sq_tail;
+	unsigned* m_sq_flags;
+	unsigned* m_sq_array;
+	unsigned m_sq_mask;
+	unsigned* m_cq_head;
+	unsigned* m_cq_tail;
+	unsigned m_cq_mask;
+	io_uring_cqe* m_cqes;
+	// The number of requests that have been queued but not submitted.
+	unsigned m_queued{0};
+public:
+	explicit uring(unsigned entries, unsigned flags = 0) : m_flags{flags}
+	{
+		auto p = io_uring_params{};
+		p.flags = flags;
+		p.sq_thread_idle = sq_thread_idle;
+		m_fd = int(::syscall(SYS_io_uring_setup, entries, &p));
+		if (m_fd == -1) { throw current_system_error(); }
+
+		m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+		m_sq_ring = map(m_sq_ring_size, IORING_OFF_SQ_RING);
+		m_cq_ring = map(m_cq_ring_size, IORING_OFF_CQ_RING);
+		m_sqes = (io_uring_sqe*)map(m_sqes_size, IORING_OFF_SQES);
+
+		m_sq_head = (unsigned*)(m_sq_ring + p.sq_off.head);
+		m_sq_tail = (unsigned*)(m_sq_ring + p.sq_off.tail);
+		m_sq_flags = (unsigned*)(m_sq_ring + p.sq_off.flags);
+		m_sq_array = (unsigned*)(m_sq_ring + p.sq_off.array);
+		m_sq_mask = *(unsigned*)(m_sq_ring + p.sq_off.ring_mask);
+		m_cq_head = (unsigned*)(m_cq_ring + p.cq_off.head);
+		m_cq_tail = (unsigned*)(m_cq_ring + p.cq_off.tail);
+		m_cq_mask = *(unsigned*)(m_cq_ring + p.cq_off.ring_mask);
+		m_cqes = (io_uring_cqe*)(m_cq_ring + p.cq_off.cqes);
+	}
+
+	uring(const uring&) = delete;
+	uring& operator=(const uring&) = delete;
+
+	~uring()
+	{ release(); }
+
+	unsigned flags() const noexcept
+	{ return m_flags; }
+
+	/*
+	** Returns whether the kernel supports the request `op`.
+	*/
+	bool supports(uint8_t op) const
+	{
+		auto n = size_t{256};
+		auto size = sizeof(io_uring_probe) + n * sizeof(io_uring_probe_op);
+		auto buf = std::vector<uint8_t>(size);
+		auto p = (io_uring_probe*)buf.data();
+		if (::syscall(SYS_io_uring_register, m_fd, IORING_REGISTER_PROBE,
+			p, n) == -1)
+		{
+			return false;
+		}
+		return op <= p->last_op &&
+			(p->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+	}
+
+	/*
+	** Registers `n` buffers of `buf_size` bytes starting at `buf`, so that
+	** the `i`th one can be used by the fixed requests with `buf_index` set
+	** to `i`. Returns false if they could not be registered (e.g. because
+	** they exceed `RLIMIT_MEMLOCK`), in which case the plain requests
+	** should be used instead.
+	*/
+	bool register_buffers(uint8_t* buf, size_t buf_size, unsigned n)
+	{
+		auto v = std::vector<iovec>(n);
+		for (auto i = 0u; i != n; ++i) {
+			v[i].iov_base = buf + i * buf_size;
+			v[i].iov_len = buf_size;
+		}
+		return ::syscall(SYS_io_uring_register, m_fd,
+			IORING_REGISTER_BUFFERS, v.data(), n) == 0;
+	}
+
+	/*
+	** Returns the next free entry of the submission queue, cleared. The
+	** caller must not have more requests in flight than the ring holds.
+	*/
+	io_uring_sqe& queue()
+	{
+		auto i = (*m_sq_tail + m_queued) & m_sq_mask;
+		++m_queued;
+		m_sq_array[i] = i;
+		m_sqes[i] = io_uring_sqe{};
+		return m_sqes[i];
+	}
+
+	/*
+	** Submits the queued requests and, if `wait` is true and no completion
+	** is ready, waits for at least one. With `IORING_SETUP_IOPOLL`, this can
+	** return before the completion has been posted, so the caller should
+	** check again.
+	*/
+	void submit(bool wait)
+	{
+		auto n = m_queued;
+		if (n != 0) {
+			__atomic_store_n(m_sq_tail, *m_sq_tail + n, __ATOMIC_RELEASE);
+			m_queued = 0;
+		}
+
+		auto flags = 0u;
+		if ((m_flags & IORING_SETUP_SQPOLL) != 0) {
+			// The fence orders the store to the tail before the load
+			// of the flags, as the polling thread checks the tail
+			// after setting the flag.
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (n != 0 && (__atomic_load_n(m_sq_flags, __ATOMIC_RELAXED) &
+				IORING_SQ_NEED_WAKEUP) != 0)
+			{
+				flags |= IORING_ENTER_SQ_WAKEUP;
+			}
+			n = 0;
+		}
+		if (wait && peek() == nullptr) { flags |= IORING_ENTER_GETEVENTS; }
+		if (n == 0 && flags == 0) { return; }
+
+		auto min = (flags & IORING_ENTER_GETEVENTS) != 0 ? 1u : 0u;
+		while (::syscall(SYS_io_uring_enter, m_fd, n, min, flags, nullptr,
+			0) == -1)
+		{
+			if (errno != EINTR) { throw current_system_error(); }
+		}
+	}
+
+	/*
+	** Returns the next completion, or null if none is ready. It must be
+	** released with `pop` once it has been handled.
+	*/
+	const io_uring_cqe* peek() const noexcept
+	{
+		auto head = *m_cq_head;
+		auto tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+		return head == tail ? nullptr : &m_cqes[head & m_cq_mask];
+	}
+
+	void pop() noexcept
+	{ __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE); }
+
+	/*
+	** Discards the requests that have been queued but not submitted, and
+	** waits for the rest of the `pending` requests to complete, ignoring
+	** their results. This must be done before an exception unwinds past
+	** the buffers and the ring that the requests in flight use. Every
+	** completion that has been handled must have been popped.
+	*/
+	void drain(unsigned pending) noexcept
+	{
+		pending -= std::min(pending, m_queued);
+		m_queued = 0;
+
+		auto sqpoll = (m_flags & IORING_SETUP_SQPOLL) != 0;
+		auto flags = IORING_ENTER_GETEVENTS | (sqpoll ? IORING_ENTER_SQ_WAKEUP : 0);
+		while (pending != 0) {
+			if (peek() == nullptr) {
+				// The requests that a failed `io_uring_enter` did
+				// not consume are submitted again.
+				auto n = sqpoll ? 0u : *m_sq_tail -
+					__atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+				if (::syscall(SYS_io_uring_enter, m_fd, n, 1u, flags,
+					nullptr, 0) == -1 && errno != EINTR)
+				{
+					return;
+				}
+			}
+			for (; pending != 0 && peek() != nullptr; pop()) { --pending; }
+		}
+	}
+private:
+	uint8_t* map(size_t size, off_t off)
+	{
+		auto p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, m_fd, off);
+		if (p == MAP_FAILED) {
+			auto e = current_system_error();
+			release();
+			throw e;
+		}
+		return (uint8_t*)p;
+	}
+
+	void release() noexcept
+	{
+		if (m_sqes != nullptr) { ::munmap(m_sqes, m_sqes_size); }
+		if (m_cq_ring != nullptr) { ::munmap(m_cq_ring, m_cq_ring_size); }
+		if (m_sq_ring != nullptr) { ::munmap(m_sq_ring, m_sq_ring_size); }
+		if (m_fd != -1) { ::close(m_fd); }
+	}
+};
+
+/*
+** Returns whether a ring can be set up with `flags` and supports the request
+** `op`.
+*/
+static bool
+uring_supported(unsigned flags, uint8_t op)
+{
+	try {
+		uring ring{1, flags};
+		return ring.supports(op);
+	}
+	catch (const std::system_error&) {
+		return false;
+	}
+}
+
+static void
+prepare_sqe(
+	io_uring_sqe& e,
+	uint8_t op,
+	int fd,
+	uint8_t* buf,
+	size_t n,
+	off_t off,
+	uint64_t data
+)
+{
+	e.opcode = op;
+	e.fd = fd;
+	e.addr = uint64_t(uintptr_t(buf));
+	e.len = uint32_t(n);
+	e.off = uint64_t(off);
+	e.user_data = data;
+}
+
+/*
+** Prepares a splice of `n` bytes from `in` at `in_off` to `out` at `out_off`.
+** An offset of -1 is used for a pipe.
+*/
+static void
+prepare_splice(
+	io_uring_sqe& e,
+	int in,
+	off_t in_off,
+	int out,
+	off_t out_off,
+	size_t n,
+	uint64_t data
+)
+{
+	e.opcode = IORING_OP_SPLICE;
+	e.splice_fd_in = in;
+	e.splice_off_in = uint64_t(in_off);
+	e.fd = out;
+	e.off = uint64_t(out_off);
+	e.len = uint32_t(n);
+	e.splice_flags = SPLICE_F_MOVE;
+	e.user_data = data;
+}
+
+/*
+** Records the completion of a request with the result `res`, which was issued
+** at `t`, in the trace.
+*/
+static void
+trace_cqe(trace_op op, off_t off, size_t len, uint64_t t, int32_t res)
+{
+	if (res < 0) { errno = -res; }
+	trace_end(op, off, len, t, res < 0 ? -1 : res);
+}
+
+/*
+** Throws if the request that completed with `e` failed.
+*/
+static void
+check_cqe(const io_uring_cqe& e)
+{
+	if (e.res < 0) {
+		throw std::system_error{-e.res, std::system_category()};
+	}
+}
+
+/*
+** Writes `count` bytes to `fd` in blocks of `buf_size`, keeping `depth` writes
+** in flight, as `kernel_aio_write` does. The buffer `buf` must hold `depth *
+** buf_size` bytes. The ring must hold at least `depth` requests.
+*/
+static void
+uring_write_loop(
+	uring& ring,
+	int fd,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	size_t count,
+	size_t align = 1
+)
+{
+	auto fixed = ring.register_buffers(buf, buf_size, depth);
+	auto offs = std::vector<size_t>(depth);
+	auto times = std::vector<uint64_t>(depth);
+	auto off = size_t{0};
+	auto pending = 0u;
+
+	auto issue = [&](unsigned i) {
+		auto n = std::min(buf_size, count - off);
+		auto m = (n + align - 1) / align * align;
+		auto& e = ring.queue();
+		prepare_sqe(e, fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE,
+			fd, buf + i * buf_size, m, off_t(off), i);
+		e.buf_index = fixed ? i : 0;
+		offs[i] = off;
+		times[i] = trace_begin();
+		off += n;
+		++pending;
+	};
+
+	try {
+		for (auto i = 0u; i != depth && off < count; ++i) { issue(i); }
+
+		while (pending != 0) {
+			ring.submit(true);
+			for (const io_uring_cqe* p; (p = ring.peek()) != nullptr;) {
+				auto e = *p;
+				ring.pop();
+				auto i = unsigned(e.user_data);
+				auto n = std::min(buf_size, count - offs[i]);
+				auto m = (n + align - 1) / align * align;
+				--pending;
+				trace_cqe(trace_op::write, off_t(offs[i]), m, times[i], e.res);
+				check_cqe(e);
+				assert(size_t(e.res) == m);
+				if (off < count) { issue(i); }
+			}
+		}
+	}
+	catch (...) {
+		ring.drain(pending);
+		throw;
+	}
+	if (count % align != 0) { truncate(fd, off_t(count)); }
+}
+
+/*
+** The block of a copy that is handled by one chain of requests: `len` bytes at
+** `off`, of which the first request has moved `got`.
+*/
+struct uring_copy_slot
+{
+	off_t off;
+	size_t len;
+	size_t got;
+	uint64_t time;
+};
+
+/*
+** Copies `in` to `out` in blocks of `buf_size`, keeping `depth` chains of a
+** read followed by a write in flight. The buffer `buf` must hold `depth *
+** buf_size` bytes, and the ring at least `2 * depth` requests. If `out` was
+** opened with `O_DIRECT`, then `align` is the alignment required for the
+** lengths of the writes: the last block is padded to it, and `out` is then
+** truncated to the size of `in`.
+**
+** The write is hard-linked to the read, so that it is issued even if the read
+** is short, as it is for the last block when the lengths are padded. If a read
+** is short before the end of the file, then the rest of the block is copied by
+** a new chain once the write has completed. If a request fails, the ones still
+** in flight are waited for before the error is rethrown.
+*/
+static void
+uring_copy_loop(
+	uring& ring,
+	int in,
+	int out,
+	uint8_t* buf,
+	size_t buf_size,
+	unsigned depth,
+	off_t fs,
+	size_t align = 1
+)
+{
+	auto fixed = ring.register_buffers(buf, buf_size, depth);
+	auto slots = std::vector<uring_copy_slot>(depth);
+	auto next = off_t{0};
+	auto pending = 0u;
+
+	auto issue = [&](unsigned i) {
+		auto& s = slots[i];
+		auto m = (s.len + align - 1) / align * align;
+		auto p = buf + i * buf_size;
+
+		auto& r = ring.queue();
+		prepare_sqe(r, fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, in, p,
+			m, s.off, i << 1);
+		r.buf_index = fixed ? i : 0;
+		r.flags = IOSQE_IO_HARDLINK;
+
+		auto& w = ring.queue();
+		prepare_sqe(w, fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, out,
+			p, m, s.off, i << 1 | 1);
+		w.buf_index = fixed ? i : 0;
+
+		s.got = 0;
+		s.time = trace_begin();
+		pending += 2;
+	};
+
+	auto start = [&](unsigned i) {
+		slots[i].off = next;
+		slots[i].len = size_t(std::min(off_t(buf_size), fs - next));
+		next += slots[i].len;
+		issue(i);
+	};
+
+	try {
+		for (auto i = 0u; i != depth && next < fs; ++i) { start(i); }
+
+		while (pending != 0) {
+			ring.submit(true);
+			for (const io_uring_cqe* p; (p = ring.peek()) != nullptr;) {
+				auto e = *p;
+				ring.pop();
+				auto i = unsigned(e.user_data >> 1);
+				auto& s = slots[i];
+				--pending;
+
+				if ((e.user_data & 1) == 0) {
+					trace_cqe(trace_op::uring_read, s.off, s.len, s.time, e.res);
+					check_cqe(e);
+					s.got = size_t(e.res);
+					continue;
+				}
+
+				trace_cqe(trace_op::write, s.off, s.len, s.time, e.res);
+				check_cqe(e);
+				if (s.got >= s.len) {
+					if (next < fs) { start(i); }
+					continue;
+				}
+				if (s.got == 0 || (s.off + s.got) % align != 0) {
+					throw std::runtime_error{"unexpected short read"};
+				}
+				s.off += s.got;
+				s.len -= s.got;
+				issue(i);
+			}
+		}
+	}
+	catch (...) {
+		ring.drain(pending);
+		throw;
+	}
+	if (fs % align != 0) { truncate(out, fs); }
+}
+
+/*
+** Copies `in` to `out` in blocks of at most `buf_size`, keeping `depth` chains
+** of a splice from `in` into a pipe followed by a splice from the pipe into
+** `out` in flight, with one pipe per chain. The blocks are limited to the
+** capacity of the pipes, which is raised to `buf_size` if possible. The ring
+** must hold at least `2 * depth` requests.
+**
+** The second splice is linked to the first, so that it is cancelled if the
+** first fails or is short; in the latter case, the data in the pipe is spliced
+** into `out` by itself, and the rest of the block by a new chain.
+*/
+static void
+uring_splice_loop(
+	uring& ring,
+	int in,
+	int out,
+	size_t buf_size,
+	unsigned depth,
+	off_t fs
+)
+{
+	auto slots = std::vector<uring_copy_slot>(depth);
+	// The part of each block that is left to copy once its pipe has been
+	// flushed after a short splice.
+	auto rest = std::vector<size_t>(depth);
+	auto pipes = std::vector<std::tuple<int, int>>(depth);
+	auto chunk = buf_size;
+	for (auto& p : pipes) {
+		p = make_pipe().get();
+		// This fails if `buf_size` exceeds `/proc/sys/fs/pipe-max-size`
+		// and we are not privileged, in which case the capacity is left
+		// as it is.
+		::fcntl(std::get<1>(p), F_SETPIPE_SZ, int(buf_size));
+		auto c = ::fcntl(std::get<1>(p), F_GETPIPE_SZ);
+		if (c == -1) { throw current_system_error(); }
+		chunk = std::min(chunk, size_t(c));
+	}
+
+	auto next = off_t{0};
+	auto pending = 0u;
+
+	auto issue = [&](unsigned i) {
+		auto& s = slots[i];
+		auto r = std::get<0>(pipes[i]);
+		auto w = std::get<1>(pipes[i]);
+
+		auto& e1 = ring.queue();
+		prepare_splice(e1, in, s.off, w, -1, s.len, i << 1);
+		e1.flags = IOSQE_IO_LINK;
+		auto& e2 = ring.queue();
+		prepare_splice(e2, r, -1, out, s.off, s.len, i << 1 | 1);
+
+		s.got = 0;
+		s.time = trace_begin();
+		pending += 2;
+	};
+
+	// Splices the `s.got` bytes that are left in the pipe into `out`.
+	auto flush = [&](unsigned i) {
+		auto& s = slots[i];
+		auto& e = ring.queue();
+		prepare_splice(e, std::get<0>(pipes[i]), -1, out, s.off, s.got,
+			i << 1 | 1);
+		s.len = s.got;
+		++pending;
+	};
+
+	auto start = [&](unsigned i) {
+		slots[i].off = next;
+		slots[i].len = size_t(std::min(off_t(chunk), fs - next));
+		next += slots[i].len;
+		issue(i);
+	};
+
+	auto close_pipes = [&]() {
+		for (const auto& p : pipes) {
+			::close(std::get<0>(p));
+			::close(std::get<1>(p));
+		}
+	};
+
+	try {
+		for (auto i = 0u; i != depth && next < fs; ++i) { start(i); }
+
+		while (pending != 0) {
+			ring.submit(true);
+			for (const io_uring_cqe* p; (p = ring.peek()) != nullptr;) {
+				auto e = *p;
+				ring.pop();
+				auto i = unsigned(e.user_data >> 1);
+				auto& s = slots[i];
+				--pending;
+
+				if ((e.user_data & 1) == 0) {
+					trace_cqe(trace_op::splice, s.off, s.len, s.time, e.res);
+					check_cqe(e);
+					s.got = size_t(e.res);
+					continue;
+				}
+
+				if (e.res == -ECANCELED && s.got != 0 && s.got < s.len) {
+					rest[i] = s.len - s.got;
+					flush(i);
+					continue;
+				}
+
+				trace_cqe(trace_op::splice, s.off, s.len, s.time, e.res);
+				check_cqe(e);
+				if (size_t(e.res) != s.len) {
+					throw std::runtime_error{"unexpected short splice"};
+				}
+				s.off += s.len;
+				if (rest[i] != 0) {
+					s.len = std::exchange(rest[i], 0);
+					issue(i);
+				}
+				else if (next < fs) {
+					start(i);
+				}
+			}
+		}
+	}
+	catch (...) {
+		ring.drain(pending);
+		close_pipes();
+		throw;
+	}
+	close_pipes();
+}
+
+/*
+** Returns `flags` without `IORING_SETUP_IOPOLL` if the device that holds `f`
+** does not support polled IO for requests of kind `op`. The kernel only finds
+** this out once the request reaches the device, so a request for the first
+** `f.align.offset` bytes is issued from `buf`; the engines then overwrite what
+** a write put there. Like `open_direct`, this lets the `iopoll` engines run on
+** any file; a warning is printed the first time.
+*/
+static unsigned
+check_iopoll(unsigned flags, const direct_file& f, uint8_t op, uint8_t* buf)
+{
+	static auto warned = false;
+	if ((flags & IORING_SETUP_IOPOLL) == 0) { return flags; }
+
+	uring ring{1, IORING_SETUP_IOPOLL};
+	prepare_sqe(ring.queue(), op, f.fd, buf, f.align.offset, 0, 0);
+	// With `IORING_SETUP_IOPOLL`, `io_uring_enter` can return before the
+	// completion has been posted.
+	try {
+		do { ring.submit(true); } while (ring.peek() == nullptr);
+	}
+	catch (...) {
+		ring.drain(1);
+		throw;
+	}
+	auto r = ring.peek()->res;
+	ring.pop();
+	if (r != -EOPNOTSUPP) { return flags; }
+
+	if (!warned) {
+		cc::errln("Warning: polled IO is not supported for this file; "
+			"using interrupts instead.");
+		warned = true;
+	}
+	return flags & ~unsigned{IORING_SETUP_IOPOLL};
+}
+
+static void
+uring_write_file(
+	const char* path,
+	size_t buf_size,
+	size_t count,
+	unsigned depth,
+	bool direct,
+	unsigned flags
+)
+{
+	static constexpr auto mode = O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME;
+	auto f = direct ? open_direct(path, mode) :
+		direct_file{safe_open(path, mode).get(), {4096, 1}};
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, depth * bs);
+	fill_buffer(buf.get(), depth * bs);
+	flags = check_iopoll(flags, f, IORING_OP_WRITE, buf.get());
+	uring ring{depth, flags};
+	uring_write_loop(ring, f.fd, buf.get(), bs, depth, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+uring_copy_file(
+	const char* src,
+	const char* dst,
+	size_t buf_size,
+	unsigned depth,
+	bool direct,
+	unsigned flags
+)
+{
+	static constexpr auto in_mode = O_RDONLY | O_NOATIME;
+	static constexpr auto out_mode = O_RDWR | O_CREAT | O_TRUNC | O_NOATIME;
+	auto in = direct ? open_direct(src, in_mode) :
+		direct_file{safe_open(src, in_mode).get(), {4096, 1}};
+	auto out = direct ? open_direct(dst, out_mode) :
+		direct_file{safe_open(dst, out_mode).get(), {4096, 1}};
+	auto fs = file_size(in.fd).get();
+	// The alignments are powers of two, so the larger is a multiple of the
+	// smaller.
+	auto a = std::max(in.align.offset, out.align.offset);
+	auto bs = (buf_size + a - 1) / a * a;
+	auto buf = allocate_aligned(std::max(in.align.memory, out.align.memory),
+		depth * bs);
+	flags = check_iopoll(flags, in, IORING_OP_READ, buf.get());
+	flags = check_iopoll(flags, out, IORING_OP_WRITE, buf.get());
+	uring ring{2 * depth, flags};
+	uring_copy_loop(ring, in.fd, out.fd, buf.get(), bs, depth, fs,
+		out.align.offset);
+	::close(in.fd);
+	::close(out.fd);
+}
+
+static void
+uring_splice_file(
+	const char* src,
+	const char* dst,
+	size_t buf_size,
+	unsigned depth,
+	bool preallocate_fadvise,
+	unsigned flags
+)
+{
+	auto in = safe_open(src, O_RDONLY | O_NOATIME).get();
+	auto out = safe_open(dst, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto fs = file_size(in).get();
+	if (preallocate_fadvise) {
+		fadvise_sequential_read(in, fs);
+		preallocate(out, fs);
+	}
+	uring ring{2 * depth, flags};
+	uring_splice_loop(ring, in, out, buf_size, depth, fs);
+	::close(in);
+	::close(out);
+}
+
+static void
+uring_write_plain(const char* path, size_t buf_size, size_t count, unsigned depth)
+{ uring_write_file(path, buf_size, count, depth, false, 0); }
+
+static void
+uring_write_direct(const char* path, size_t buf_size, size_t count, unsigned depth)
+{ uring_write_file(path, buf_size, count, depth, true, 0); }
+
+static void
+uring_write_plain_sqpoll(const char* path, size_t buf_size, size_t count, unsigned depth)
+{ uring_write_file(path, buf_size, count, depth, false, IORING_SETUP_SQPOLL); }
+
+static void
+uring_write_direct_sqpoll(const char* path, size_t buf_size, size_t count, unsigned depth)
+{ uring_write_file(path, buf_size, count, depth, true, IORING_SETUP_SQPOLL); }
+
+static void
+uring_write_direct_iopoll(const char* path, size_t buf_size, size_t count, unsigned depth)
+{ uring_write_file(path, buf_size, count, depth, true, IORING_SETUP_IOPOLL); }
+
+static void
+uring_copy_plain(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_copy_file(src, dst, buf_size, depth, false, 0); }
+
+static void
+uring_copy_direct(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_copy_file(src, dst, buf_size, depth, true, 0); }
+
+static void
+uring_copy_plain_sqpoll(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_copy_file(src, dst, buf_size, depth, false, IORING_SETUP_SQPOLL); }
+
+static void
+uring_copy_direct_sqpoll(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_copy_file(src, dst, buf_size, depth, true, IORING_SETUP_SQPOLL); }
+
+static void
+uring_copy_direct_iopoll(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_copy_file(src, dst, buf_size, depth, true, IORING_SETUP_IOPOLL); }
+
+static void
+uring_copy_splice(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_splice_file(src, dst, buf_size, depth, false, 0); }
+
+static void
+uring_copy_splice_preallocate_fadvise(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_splice_file(src, dst, buf_size, depth, true, 0); }
+
+static void
+uring_copy_splice_sqpoll(const char* src, const char* dst, size_t buf_size, unsigned depth)
+{ uring_splice_file(src, dst, buf_size, depth, false, IORING_SETUP_SQPOLL); }
+
+/*
+** Registers the engines that the kernel supports. Splicing is not allowed on
+** a ring set up with `IORING_SETUP_IOPOLL`. The `SQPOLL` and `IOPOLL` variants
+** are only run when they are selected explicitly.
+*/
+static void
+register_uring_engines(engine_registry& r)
+{
+	static constexpr auto sqpoll = unsigned{IORING_SETUP_SQPOLL};
+	static constexpr auto iopoll = unsigned{IORING_SETUP_IOPOLL};
+
+	if (uring_supported(0, IORING_OP_WRITE_FIXED)) {
+		r.write_queued("uring_write_plain", uring_write_plain);
+		r.write_queued("uring_write_direct", uring_write_direct);
+	}
+	if (uring_supported(sqpoll, IORING_OP_WRITE_FIXED)) {
+		r.write_queued("uring_write_plain_sqpoll", uring_write_plain_sqpoll, false);
+		r.write_queued("uring_write_direct_sqpoll", uring_write_direct_sqpoll, false);
+	}
+	if (uring_supported(iopoll, IORING_OP_WRITE_FIXED)) {
+		r.write_queued("uring_write_direct_iopoll", uring_write_direct_iopoll, false);
+	}
+
+	if (uring_supported(0, IORING_OP_READ)) {
+		r.copy_queued("uring_copy_plain", uring_copy_plain);
+		r.copy_queued("uring_copy_direct", uring_copy_direct);
+	}
+	if (uring_supported(sqpoll, IORING_OP_READ)) {
+		r.copy_queued("uring_copy_plain_sqpoll", uring_copy_plain_sqpoll, false);
+		r.copy_queued("uring_copy_direct_sqpoll", uring_copy_direct_sqpoll, false);
+	}
+	if (uring_supported(iopoll, IORING_OP_READ)) {
+		r.copy_queued("uring_copy_direct_iopoll", uring_copy_direct_iopoll, false);
+	}
+
+	if (uring_supported(0, IORING_OP_SPLICE)) {
+		r.copy_queued("uring_copy_splice", uring_copy_splice);
+		r.copy_queued("uring_copy_splice_preallocate_fadvise",
+			uring_copy_splice_preallocate_fadvise);
+	}
+	if (uring_supported(sqpoll, IORING_OP_SPLICE)) {
+		r.copy_queued("uring_copy_splice_sqpoll", uring_copy_splice_sqpoll, false);
+	}
+}
+
+#endif
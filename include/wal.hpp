@@ -0,0 +1,548 @@
+/*
+** File Name:	wal.hpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures the rate at which small records can be made durable in a
+** write-ahead log. Each producer thread appends one record at a time, and waits
+** for it to be committed before appending the next, as a transaction would. A
+** single committer thread writes the records that have accumulated as one batch,
+** calls `fdatasync`, and then acknowledges every record in the batch (group
+** commit). The records that arrive in the meantime form the next batch.
+**
+** A batch is written once it holds at least the batch size, or once the batch
+** window has elapsed since its first record arrived. With a window of zero,
+** each batch is written as soon as the committer is free.
+**
+** The log is written in one of three ways:
+**
+**   - `append`: `write` on a descriptor opened with `O_APPEND`.
+**   - `pwrite`: `pwrite` at an offset tracked by the committer.
+**   - `direct`: `pwrite` with `O_DIRECT`. Each batch is padded with zeros to a
+**     multiple of the alignment required by the file, and the last, partial
+**     block is written again at the start of the next batch. The padding is
+**     truncated at the end.
+**
+** Each trial commits a fixed number of records to a new log. The results are
+** written through `report.hpp`, with the record size as the block size and the
+** number of producers as the queue depth, since each producer has one record
+** in flight at a time. The rates of batches and the percentiles of the commit
+** latency over the timed trials are reported as extra statistics.
+*/
+
+#ifndef ZB04467C5_0926_4B31_8153_9F9120C4515D
+#define ZB04467C5_0926_4B31_8153_9F9120C4515D
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <ccbase/format.hpp>
+#include <ccbase/platform.hpp>
+
+#include <environment.hpp>
+#include <io_common.hpp>
+#include <options.hpp>
+#include <report.hpp>
+#include <statistics.hpp>
+#include <test.hpp>
+
+enum class wal_mode
+{
+	append,
+	pwrite,
+	direct
+};
+
+static const char*
+wal_mode_name(wal_mode m)
+{
+	switch (m) {
+	case wal_mode::append: return "append";
+	case wal_mode::pwrite: return "pwrite";
+	case wal_mode::direct: return "direct";
+	}
+	return "unknown";
+}
+
+static wal_mode
+parse_wal_mode(const std::string& s)
+{
+	if (s == "append") { return wal_mode::append; }
+	if (s == "pwrite") { return wal_mode::pwrite; }
+	if (s == "direct") { return wal_mode::direct; }
+	throw std::invalid_argument{cc::format("invalid mode \"$\"", s)};
+}
+
+struct wal_options
+{
+	std::vector<wal_mode> modes{wal_mode::append, wal_mode::pwrite, wal_mode::direct};
+	std::vector<unsigned> producers{1, 4, 16};
+	std::vector<size_t> record_sizes{128, 4096, 16384};
+	std::vector<size_t> batch_sizes{65536};
+	// Longest time for which a batch waits for more records, in
+	// microseconds.
+	std::vector<double> windows{0, 100, 1000};
+	// Number of records committed in each trial, by all producers.
+	size_t commits{1000};
+	const char* path{"data/wal.log"};
+};
+
+class group_committer
+{
+	using clock = std::chrono::steady_clock;
+
+	const wal_mode mode;
+	const size_t batch_size;
+	const clock::duration window;
+	int fd;
+
+	std::mutex m;
+	// Wakes the committer when a record is appended.
+	std::condition_variable commit_cv;
+	// Wakes the producers when a batch has been committed.
+	std::condition_variable durable_cv;
+	std::vector<uint8_t> staged;
+	std::vector<uint8_t> writing;
+	clock::time_point first;
+	// Logical size of the log, including the staged records, and the
+	// part of it that has been committed.
+	uint64_t appended{0};
+	uint64_t durable{0};
+	size_t batches{0};
+	bool stop{false};
+	std::exception_ptr error;
+
+	// For `direct`: the alignment of the offsets and lengths of the
+	// writes.
+	size_t align{1};
+	// For `pwrite` and `direct`: the offset of the next write. For
+	// `direct`, this is the start of the last partial block, whose `tail`
+	// bytes are kept at the start of `buf`.
+	off_t off{0};
+	size_t tail{0};
+	detail::buffer_type buf;
+
+	std::thread committer;
+public:
+	/*
+	** The value `max_batch` is the largest number of bytes that can be
+	** staged at once.
+	*/
+	group_committer(
+		const char* path,
+		wal_mode mode,
+		size_t batch_size,
+		double window_us,
+		size_t max_batch
+	) : mode{mode}, batch_size{batch_size},
+	window{std::chrono::duration_cast<clock::duration>(
+		std::chrono::duration<double, std::micro>{window_us})}
+	{
+		auto flags = O_WRONLY | O_CREAT | O_TRUNC;
+		if (mode == wal_mode::append) { flags |= O_APPEND; }
+		auto mem_align = size_t{4096};
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		if (mode == wal_mode::direct) {
+			// If the file system does not support `O_DIRECT`, the
+			// log is written through the page cache, unpadded.
+			auto f = open_direct(path, flags);
+			fd = f.fd;
+			align = f.align.offset;
+			mem_align = f.align.memory;
+		}
+		else {
+			fd = safe_open(path, flags).get();
+		}
+	#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+		fd = safe_open(path, flags).get();
+		if (mode == wal_mode::direct) {
+			disable_cache(fd);
+			align = 4096;
+		}
+	#endif
+
+		staged.reserve(max_batch);
+		writing.reserve(max_batch);
+		if (mode == wal_mode::direct) {
+			buf = allocate_aligned(mem_align, max_batch + 2 * align);
+		}
+		committer = std::thread{[this] { run(); }};
+	}
+
+	group_committer(const group_committer&) = delete;
+	group_committer& operator=(const group_committer&) = delete;
+
+	~group_committer()
+	{
+		if (committer.joinable()) {
+			try { finish(); }
+			catch (...) {}
+		}
+	}
+
+	/*
+	** Appends a record of `n` bytes to the log, and waits until it has
+	** been committed.
+	*/
+	void commit(const uint8_t* p, size_t n)
+	{
+		std::unique_lock<std::mutex> lk{m};
+		if (staged.empty()) { first = clock::now(); }
+		staged.insert(staged.end(), p, p + n);
+		appended += n;
+		auto lsn = appended;
+
+		commit_cv.notify_one();
+		durable_cv.wait(lk, [&] { return durable >= lsn || error; });
+		if (error) { std::rethrow_exception(error); }
+	}
+
+	/*
+	** Commits the remaining records, stops the committer, and closes the
+	** log. Returns the number of batches that were written.
+	*/
+	size_t finish()
+	{
+		{
+			std::lock_guard<std::mutex> g{m};
+			stop = true;
+		}
+		commit_cv.notify_one();
+		committer.join();
+
+		if (mode == wal_mode::direct) { truncate(fd, appended); }
+		safe_close(fd).get();
+		if (error) { std::rethrow_exception(error); }
+		return batches;
+	}
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lk{m};
+		try {
+			for (;;) {
+				commit_cv.wait(lk, [&] { return stop || !staged.empty(); });
+				if (staged.empty()) { return; }
+
+				if (window != clock::duration::zero()) {
+					commit_cv.wait_until(lk, first + window, [&] {
+						return stop || staged.size() >= batch_size;
+					});
+				}
+
+				writing.swap(staged);
+				auto lsn = appended;
+				lk.unlock();
+				write_batch();
+				lk.lock();
+
+				writing.clear();
+				durable = lsn;
+				++batches;
+				durable_cv.notify_all();
+			}
+		}
+		catch (...) {
+			error = std::current_exception();
+			durable_cv.notify_all();
+		}
+	}
+
+	void write_batch()
+	{
+		auto n = writing.size();
+		switch (mode) {
+		case wal_mode::append:
+			for (auto c = size_t{0}; c < n;) {
+				auto r = ::write(fd, writing.data() + c, n - c);
+				if (r == -1) {
+					if (errno == EINTR) { continue; }
+					throw current_system_error();
+				}
+				c += r;
+			}
+			break;
+		case wal_mode::pwrite:
+			full_write(fd, writing.data(), n, off).get();
+			off += n;
+			break;
+		case wal_mode::direct: {
+			std::memcpy(buf.get() + tail, writing.data(), n);
+			auto m = tail + n;
+			auto padded = (m + align - 1) / align * align;
+			std::memset(buf.get() + m, 0, padded - m);
+			full_write(fd, buf.get(), padded, off).get();
+
+			// Keep the last partial block for the next batch.
+			auto full = m / align * align;
+			std::memmove(buf.get(), buf.get() + full, m - full);
+			off += full;
+			tail = m - full;
+			break;
+		}
+		}
+
+	#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+		if (::fdatasync(fd) == -1) { throw current_system_error(); }
+	#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+		// `fsync` on OS X does not flush the disk's write cache.
+		if (::fcntl(fd, F_FULLFSYNC) == -1) { throw current_system_error(); }
+	#endif
+	}
+};
+
+/*
+** Returns the name under which the results for a configuration are reported,
+** e.g. `pwrite batch 64 KB window 100 us`.
+*/
+static std::string
+wal_config_name(wal_mode mode, size_t bs, double window)
+{
+	char w[32];
+	std::snprintf(w, sizeof(w), "%g", window);
+	return std::string{wal_mode_name(mode)} + " batch " + format_size(bs) +
+		" window " + w + " us";
+}
+
+/*
+** Runs trials in which `producers` threads together commit `o.commits` records
+** of `rs` bytes to a new log, and reports the results.
+*/
+static void
+run_wal_config(
+	const wal_options& o,
+	wal_mode mode,
+	unsigned producers,
+	size_t rs,
+	size_t bs,
+	double window
+)
+{
+	using clock = std::chrono::steady_clock;
+	using microseconds = std::chrono::duration<double, std::micro>;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	// The commit latencies and the number of batches of each trial.
+	auto lats = std::vector<std::vector<double>>{};
+	auto batches = std::vector<size_t>{};
+
+	auto s = sample_trials(
+		[&]() {
+			group_committer c{o.path, mode, bs, window, producers * rs};
+			std::atomic<size_t> next{0};
+			auto ls = std::vector<std::vector<double>>(producers);
+			auto errors = std::vector<std::exception_ptr>(producers);
+
+			auto work = [&](unsigned t) {
+				try {
+					auto rec = std::vector<uint8_t>(rs, uint8_t('a' + t % 26));
+					while (next.fetch_add(1, std::memory_order_relaxed) < o.commits) {
+						auto t1 = clock::now();
+						c.commit(rec.data(), rs);
+						auto t2 = clock::now();
+						ls[t].push_back(microseconds{t2 - t1}.count());
+					}
+				}
+				catch (...) {
+					errors[t] = std::current_exception();
+					next.store(o.commits, std::memory_order_relaxed);
+				}
+			};
+
+			auto start = clock::now();
+			auto ts = std::vector<std::thread>{};
+			for (auto t = 1u; t < producers; ++t) { ts.emplace_back(work, t); }
+			work(0);
+			for (auto& t : ts) { t.join(); }
+			auto elapsed = milliseconds{clock::now() - start}.count();
+			batches.push_back(c.finish());
+			for (const auto& e : errors) {
+				if (e) { std::rethrow_exception(e); }
+			}
+
+			auto all = std::vector<double>{};
+			for (const auto& v : ls) { all.insert(all.end(), v.begin(), v.end()); }
+			lats.push_back(std::move(all));
+			return elapsed;
+		},
+		[]() {}
+	);
+
+	// Only the timed trials, which are the last ones, are summarized.
+	auto all = std::vector<double>{};
+	auto nb = size_t{0};
+	for (auto i = lats.size() - s.times.size(); i != lats.size(); ++i) {
+		all.insert(all.end(), lats[i].begin(), lats[i].end());
+		nb += batches[i];
+	}
+	std::sort(all.begin(), all.end());
+	auto q = [&](double p) { return sorted_quantile(all.begin(), all.end(), p); };
+	auto secs = 0.0;
+	for (const auto& t : s.times) { secs += t / 1000; }
+
+	auto name = wal_config_name(mode, bs, window);
+	report_result(name.c_str(), rs, producers, off_t(o.commits * rs), s, {
+		{"batches_per_sec", nb / secs},
+		{"records_per_batch", double(all.size()) / nb},
+		{"p50_us", q(0.5)},
+		{"p90_us", q(0.9)},
+		{"p99_us", q(0.99)},
+		{"p999_us", q(0.999)},
+		{"max_us", all.back()}
+	});
+}
+
+static void
+run_wal(const wal_options& o)
+{
+	begin_report(capture_environment({o.path}), result_kind::io, {"Batches/s",
+		"Records/Batch", "p50 (us)", "p90 (us)", "p99 (us)", "p99.9 (us)",
+		"Max (us)"});
+
+	for (const auto& m : o.modes) {
+		for (const auto& p : o.producers) {
+			for (const auto& rs : o.record_sizes) {
+				for (const auto& bs : o.batch_sizes) {
+					for (const auto& w : o.windows) {
+						run_wal_config(o, m, p, rs, bs, w);
+					}
+				}
+			}
+		}
+	}
+	end_report();
+}
+
+static void
+print_wal_usage(const char* prog)
+{
+	cc::err(
+"Usage: $ [options]\n"
+"\n"
+"Measures the rate and latency of commits to a write-ahead log, to which several\n"
+"producers append records that are written in batches and then synced.\n"
+"\n"
+"Options:\n"
+"  -m, --modes MODE[,MODE...]    How the log is written: append, pwrite, direct.\n"
+"  -p, --producers N[,N...]      Numbers of producer threads (default: 1,4,16).\n"
+"  -r, --record-sizes LIST       Sizes of the records (default: 128,4K,16K).\n"
+"  -b, --batch-sizes LIST        Sizes at which a batch is written (default: 64K).\n"
+"  -w, --windows US[,US...]      Longest time in microseconds for which a batch\n"
+"                                waits for more records (default: 0,100,1000).\n"
+"  -n, --commits N               Records committed in each trial (default: 1000).\n"
+"  -o, --output PATH             Path of the log (default: data/wal.log).\n"
+"  -f, --format FORMAT           Format of the results: csv or json.\n"
+"      --trials N                Run exactly N timed trials per configuration.\n"
+"      --min-trials N            Minimum number of timed trials.\n"
+"      --max-trials N            Maximum number of timed trials.\n"
+"      --budget SECONDS          Time budget per configuration.\n"
+"  -h, --help                    Print this message.\n",
+	prog);
+}
+
+static int
+wal_main(int argc, char** argv)
+{
+	auto o = wal_options{};
+
+	try {
+		for (auto i = 1; i < argc; ++i) {
+			auto a = argv[i];
+			auto value = [&]() { return option_value(argc, argv, i); };
+
+			if (is_option(a, "-h", "--help")) {
+				print_wal_usage(argv[0]);
+				return EXIT_SUCCESS;
+			}
+			else if (is_option(a, "-m", "--modes")) {
+				o.modes.clear();
+				for (const auto& m : split(value(), ',')) {
+					o.modes.push_back(parse_wal_mode(m));
+				}
+			}
+			else if (is_option(a, "-p", "--producers")) {
+				o.producers.clear();
+				for (const auto& p : split(value(), ',')) {
+					o.producers.push_back(parse_count(p.c_str()));
+				}
+			}
+			else if (is_option(a, "-r", "--record-sizes")) {
+				o.record_sizes = parse_size_list(value());
+				for (const auto& r : o.record_sizes) {
+					if (r == 0) {
+						throw std::invalid_argument{"record size must be positive"};
+					}
+				}
+			}
+			else if (is_option(a, "-b", "--batch-sizes")) {
+				o.batch_sizes = parse_size_list(value());
+			}
+			else if (is_option(a, "-w", "--windows")) {
+				o.windows.clear();
+				for (const auto& w : split(value(), ',')) {
+					o.windows.push_back(w == "0" ? 0 : parse_real(w.c_str()));
+				}
+			}
+			else if (is_option(a, "-n", "--commits")) {
+				o.commits = parse_count(value());
+			}
+			else if (is_option(a, "-o", "--output")) {
+				o.path = value();
+			}
+			else if (is_option(a, "-f", "--format")) {
+				auto f = std::string{value()};
+				if      (f == "csv")  { output_format = report_format::csv; }
+				else if (f == "json") { output_format = report_format::json; }
+				else {
+					throw std::invalid_argument{cc::format("invalid format \"$\"", f)};
+				}
+			}
+			else if (is_option(a, nullptr, "--trials")) {
+				sampler.min_trials = sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--min-trials")) {
+				sampler.min_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--max-trials")) {
+				sampler.max_trials = parse_count(value());
+			}
+			else if (is_option(a, nullptr, "--budget")) {
+				sampler.time_budget = 1000 * parse_real(value());
+			}
+			else {
+				throw std::invalid_argument{cc::format("unknown option \"$\"", a)};
+			}
+		}
+
+		if (sampler.min_trials > sampler.max_trials) {
+			throw std::invalid_argument{"minimum number of trials exceeds maximum"};
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		cc::errln("Error: $.", e.what());
+		return EXIT_FAILURE;
+	}
+
+	try {
+		run_wal(o);
+	}
+	catch (const std::system_error& e) {
+		cc::errln("Error: failed to write \"$\": $.", o.path, e.what());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -8,10 +8,18 @@
 #ifndef ZFD327A4C_B13C_4813_9572_DDC0936536FE
 #define ZFD327A4C_B13C_4813_9572_DDC0936536FE
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <random>
 #include <thread>
+#include <vector>
 #include <io_common.hpp>
 #include <configuration.hpp>
+#include <placement.hpp>
+#include <registry.hpp>
 
 static void
 fill_buffer(uint8_t* p, size_t count)
@@ -21,14 +29,23 @@ fill_buffer(uint8_t* p, size_t count)
 	std::generate(p, p + count, [&]() { return dist(gen); });
 }
 
+/*
+** Writes `count` bytes in blocks of `buf_size`. For a file opened with
+** `O_DIRECT`, `align` is the alignment required for the lengths of the writes
+** (of which `buf_size` must be a multiple): the last block is padded to it,
+** and the file is then truncated to `count` bytes.
+*/
 static auto
-write_loop(int fd, uint8_t* buf, size_t buf_size, size_t count)
+write_loop(int fd, uint8_t* buf, size_t buf_size, size_t count, size_t align = 1)
 {
-	for (auto off = off_t{0}; off < off_t(count); off += buf_size) {
-		fill_buffer(buf, buf_size);
-		auto r = full_write(fd, buf, buf_size, off);
-		assert(r == buf_size);
+	for (auto off = size_t{0}; off < count; off += buf_size) {
+		auto n = std::min(buf_size, count - off);
+		auto m = (n + align - 1) / align * align;
+		fill_buffer(buf, n);
+		auto r = full_write(fd, buf, m, off).get();
+		assert(size_t(r) == m);
 	}
+	if (count % align != 0) { truncate(fd, off_t(count)); }
 }
 
 static void
@@ -40,6 +57,7 @@ write_worker(
 	std::atomic<int>& cv2
 )
 {
+	thread_binding b{current_placement.io_cpu, current_placement.io_node};
 	auto r = int{};
 	auto s = int{};
 	auto off = off_t{0};
@@ -66,25 +84,37 @@ write_worker(
 	}
 }
 
+/*
+** Like `write_loop`, but the blocks are written by a second thread while the
+** next one is filled. The last block is padded to `align` in the same way.
+*/
 static void
 async_write_loop(
 	int fd,
 	uint8_t* buf1,
 	uint8_t* buf2,
 	size_t buf_size,
-	size_t count
+	size_t count,
+	size_t align = 1
 )
 {
+	thread_binding b{current_placement.consumer_cpu,
+		current_placement.consumer_node};
+	buffer_binding bb1{buf1, buf_size, current_placement.buffer_node};
+	buffer_binding bb2{buf2, buf_size, current_placement.buffer_node};
+	auto padded = [&](size_t n) { return int((n + align - 1) / align * align); };
+
 	if (count <= buf_size) {
 		fill_buffer(buf1, count);
-		auto r = full_write(fd, buf1, count, 0).get();
-		assert(r == count);
+		auto r = full_write(fd, buf1, padded(count), 0).get();
+		assert(r == padded(count));
+		if (count % align != 0) { truncate(fd, off_t(count)); }
 		return;
 	}
 
 	fill_buffer(buf1, buf_size);
-	std::atomic<int> cv1(buf_size);
-	std::atomic<int> cv2{-1};
+	alignas(cache_line_size) std::atomic<int> cv1(buf_size);
+	alignas(cache_line_size) std::atomic<int> cv2{-1};
 	auto rem = count - buf_size;
 	auto buf1_active = false;
 	auto t = std::thread(write_worker, fd, buf1, buf2,
@@ -99,7 +129,9 @@ async_write_loop(
 			}
 			else {
 				fill_buffer(buf1, rem);
-				cv1.store(-2, std::memory_order_release);
+				cv1.store(padded(rem), std::memory_order_release);
+				while (cv2.load(std::memory_order_acquire) != -1) {}
+				cv2.store(-2, std::memory_order_release);
 				goto exit;
 			}
 		}
@@ -111,7 +143,9 @@ async_write_loop(
 			}
 			else {
 				fill_buffer(buf2, rem);
-				cv2.store(-2, std::memory_order_release);
+				cv2.store(padded(rem), std::memory_order_release);
+				while (cv1.load(std::memory_order_acquire) != -1) {}
+				cv1.store(-2, std::memory_order_release);
 				goto exit;
 			}
 		}
@@ -120,6 +154,7 @@ async_write_loop(
 	}
 exit:
 	t.join();
+	if (count % align != 0) { truncate(fd, off_t(count)); }
 }
 
 static void
@@ -141,4 +176,386 @@ write_async_plain(const char* path, size_t buf_size, size_t count)
 	::close(fd);
 }
 
+/*
+** The `write_records_*` engines model a serializer that emits many small
+** records of `buf_size` bytes, which need not be a multiple of the block size
+** of the device. `write_records_pwrite` writes each record with its own call to
+** `pwrite`. The other two coalesce the records into batches of `queue_depth`
+** records: `write_records_writev` gathers the records in place into an array
+** of `iovec`s and writes it with `pwritev`, and `write_records_staged` copies
+** them into a staging buffer and writes that with `pwrite`.
+**
+** The records are taken in turn from a pool of random bytes. The pool is
+** filled by the first trial with a given record size, which is the untimed
+** warm-up trial unless `--warmup 0` is given, and is kept for the later trials
+** with that size, so that the cost of generating the records is not counted.
+*/
+class record_pool
+{
+	uint8_t* m_buf;
+	size_t m_record_size;
+	size_t m_records;
+	size_t m_next{0};
+
+	static uint8_t* fill(size_t record_size, size_t records)
+	{
+		static auto buf = std::unique_ptr<uint8_t[]>{};
+		static auto size = size_t{0};
+
+		if (size != record_size) {
+			buf.reset(new uint8_t[records * record_size]);
+			fill_buffer(buf.get(), records * record_size);
+			size = record_size;
+		}
+		return buf.get();
+	}
+public:
+	explicit record_pool(size_t record_size) : m_record_size{record_size}
+	{
+		// Enough records to fill 1 MB.
+		m_records = std::max((size_t{1} << 20) / record_size, size_t{1});
+		m_buf = fill(m_record_size, m_records);
+	}
+
+	uint8_t* next() noexcept
+	{
+		auto p = m_buf + m_next * m_record_size;
+		if (++m_next == m_records) { m_next = 0; }
+		return p;
+	}
+};
+
+static void
+write_records_pwrite(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto pool = record_pool{buf_size};
+	for (auto off = size_t{0}; off < count; off += buf_size) {
+		auto n = std::min(buf_size, count - off);
+		full_write(fd, pool.next(), n, off).get();
+	}
+	::close(fd);
+}
+
+static void
+write_records_writev(
+	const char* path,
+	size_t buf_size,
+	size_t count,
+	unsigned batch
+)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto pool = record_pool{buf_size};
+	auto iov = std::vector<iovec>(batch);
+
+	for (auto off = size_t{0}; off < count;) {
+		auto n = 0;
+		auto len = size_t{0};
+		for (; n != int(batch) && off + len < count; ++n) {
+			iov[n].iov_base = pool.next();
+			iov[n].iov_len = std::min(buf_size, count - off - len);
+			len += iov[n].iov_len;
+		}
+		full_pwritev(fd, iov.data(), n, off).get();
+		off += len;
+	}
+	::close(fd);
+}
+
+static void
+write_records_staged(
+	const char* path,
+	size_t buf_size,
+	size_t count,
+	unsigned batch
+)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto pool = record_pool{buf_size};
+	auto stage = allocate_aligned(4096, buf_size * batch);
+
+	for (auto off = size_t{0}; off < count;) {
+		auto len = size_t{0};
+		for (auto i = 0u; i != batch && off + len < count; ++i) {
+			auto n = std::min(buf_size, count - off - len);
+			std::memcpy(stage.get() + len, pool.next(), n);
+			len += n;
+		}
+		full_write(fd, stage.get(), len, off).get();
+		off += len;
+	}
+	::close(fd);
+}
+
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+
+static void
+write_direct(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, bs);
+	write_loop(f.fd, buf.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_preallocate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	preallocate(fd, count);
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_truncate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	preallocate(fd, count);
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_direct_preallocate(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, bs);
+	preallocate(f.fd, count);
+	write_loop(f.fd, buf.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_direct_truncate(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf = allocate_aligned(f.align.memory, bs);
+	truncate(f.fd, count);
+	write_loop(f.fd, buf.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_async_direct(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf1 = allocate_aligned(f.align.memory, bs);
+	auto buf2 = allocate_aligned(f.align.memory, bs);
+	async_write_loop(f.fd, buf1.get(), buf2.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_async_preallocate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf1 = allocate_aligned(4096, buf_size);
+	auto buf2 = allocate_aligned(4096, buf_size);
+	preallocate(fd, count);
+	async_write_loop(fd, buf1.get(), buf2.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_async_truncate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME).get();
+	auto buf1 = allocate_aligned(4096, buf_size);
+	auto buf2 = allocate_aligned(4096, buf_size);
+	truncate(fd, count);
+	async_write_loop(fd, buf1.get(), buf2.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_async_direct_preallocate(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf1 = allocate_aligned(f.align.memory, bs);
+	auto buf2 = allocate_aligned(f.align.memory, bs);
+	preallocate(f.fd, count);
+	async_write_loop(f.fd, buf1.get(), buf2.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_async_direct_truncate(const char* path, size_t buf_size, size_t count)
+{
+	auto f = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOATIME);
+	auto bs = f.align.round(buf_size);
+	auto buf1 = allocate_aligned(f.align.memory, bs);
+	auto buf2 = allocate_aligned(f.align.memory, bs);
+	truncate(f.fd, count);
+	async_write_loop(f.fd, buf1.get(), buf2.get(), bs, count, f.align.offset);
+	::close(f.fd);
+}
+
+static void
+write_mmap_preallocate(const char* path, size_t count)
+{
+	auto fd = safe_open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	preallocate(fd, count);
+
+	auto p = (uint8_t*)::mmap(nullptr, count, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == (void*)-1) { throw current_system_error(); }
+	fill_buffer(p, count);
+	::close(fd);
+}
+
+static void
+write_mmap_preallocate_direct(const char* path, size_t count)
+{
+	auto fd = safe_open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME | O_DIRECT).get();
+	preallocate(fd, count);
+
+	auto p = (uint8_t*)::mmap(nullptr, count, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == (void*)-1) { throw current_system_error(); }
+	fill_buffer(p, count);
+	::close(fd);
+}
+
+static void
+write_mmap_truncate(const char* path, size_t count)
+{
+	auto fd = safe_open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME).get();
+	truncate(fd, count);
+
+	auto p = (uint8_t*)::mmap(nullptr, count, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == (void*)-1) { throw current_system_error(); }
+	fill_buffer(p, count);
+	::close(fd);
+}
+
+static void
+write_mmap_truncate_direct(const char* path, size_t count)
+{
+	auto fd = safe_open(path, O_RDWR | O_CREAT | O_TRUNC | O_NOATIME | O_DIRECT).get();
+	truncate(fd, count);
+
+	auto p = (uint8_t*)::mmap(nullptr, count, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == (void*)-1) { throw current_system_error(); }
+	fill_buffer(p, count);
+	::close(fd);
+}
+
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+
+static void
+write_nocache(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_preallocate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto buf = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	preallocate(fd, count);
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_preallocate_truncate(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto buf = std::unique_ptr<uint8_t[]>{new uint8_t[buf_size]};
+	preallocate(fd, count);
+	truncate(fd, count);
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_preallocate_truncate_nocache(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto buf = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+	preallocate(fd, count);
+	truncate(fd, count);
+
+	write_loop(fd, buf.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+async_write_preallocate_truncate_nocache(const char* path, size_t buf_size, size_t count)
+{
+	auto fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC).get();
+	auto buf1 = allocate_aligned(4096, buf_size);
+	auto buf2 = allocate_aligned(4096, buf_size);
+	disable_cache(fd);
+	preallocate(fd, count);
+	truncate(fd, count);
+
+	async_write_loop(fd, buf1.get(), buf2.get(), buf_size, count);
+	::close(fd);
+}
+
+static void
+write_mmap(const char* path, size_t count)
+{
+	auto fd = safe_open(path, O_RDWR | O_CREAT | O_TRUNC).get();
+	disable_cache(fd);
+	preallocate(fd, count);
+	truncate(fd, count);
+
+	auto p = (uint8_t*)::mmap(nullptr, count, PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == (void*)-1) { throw current_system_error(); }
+	fill_buffer(p, count);
+	::close(fd);
+}
+
+#endif
+
+static void
+register_write_engines(engine_registry& r)
+{
+#if PLATFORM_KERNEL == PLATFORM_KERNEL_LINUX
+	r.write("write_plain", write_plain);
+	r.write("write_direct", write_direct);
+	r.write("write_preallocate", write_preallocate);
+	r.write("write_truncate", write_truncate, false);
+	r.write("write_direct_preallocate", write_direct_preallocate);
+	r.write("write_direct_truncate", write_direct_truncate, false);
+	r.write("write_async_plain", write_async_plain);
+	r.write("write_async_direct", write_async_direct);
+	r.write("write_async_preallocate", write_async_preallocate);
+	r.write("write_async_truncate", write_async_truncate, false);
+	r.write("write_async_direct_preallocate", write_async_direct_preallocate);
+	r.write("write_async_direct_truncate", write_async_direct_truncate, false);
+	r.write_whole("write_mmap_preallocate", write_mmap_preallocate);
+	r.write_whole("write_mmap_preallocate_direct", write_mmap_preallocate_direct);
+	r.write_whole("write_mmap_truncate", write_mmap_truncate, false);
+	r.write_whole("write_mmap_truncate_direct", write_mmap_truncate_direct);
+#elif PLATFORM_KERNEL == PLATFORM_KERNEL_XNU
+	r.write("write_plain", write_plain);
+	r.write("write_nocache", write_nocache);
+	r.write("write_preallocate", write_preallocate);
+	r.write("write_preallocate_truncate", write_preallocate_truncate);
+	r.write("write_preallocate_truncate_nocache", write_preallocate_truncate_nocache);
+	r.write("async_write_preallocate_truncate_nocache", async_write_preallocate_truncate_nocache);
+	r.write_whole("write_mmap", write_mmap);
+#endif
+	r.write("write_records_pwrite", write_records_pwrite, false);
+	r.write_queued("write_records_writev", write_records_writev, false);
+	r.write_queued("write_records_staged", write_records_staged, false);
+}
+
 #endif
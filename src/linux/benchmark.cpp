@@ -0,0 +1,17 @@
+/*
+** File Name:	benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Driver that runs any selection of the read, write, and copy engines over a
+** given set of block sizes, files, and file sizes. Run with `--help` for
+** usage.
+*/
+
+#include <driver.hpp>
+
+int main(int argc, char** argv)
+{
+	return driver_main(argc, argv);
+}
@@ -0,0 +1,21 @@
+/*
+** File Name:	coro_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Runs the driver with the coroutine and native AIO engines added to the usual
+** ones. Run with `--help` for usage.
+*/
+
+#include <driver.hpp>
+#include <kernel_aio.hpp>
+#include <coro_io.hpp>
+
+int main(int argc, char** argv)
+{
+	auto r = make_registry();
+	register_kernel_aio_engines(r);
+	register_coro_engines(r);
+	return driver_main(argc, argv, r);
+}
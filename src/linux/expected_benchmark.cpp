@@ -0,0 +1,16 @@
+/*
+** File Name:	expected_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures the cost of returning errors through cc::expected and
+** cc::errno_expected. Run with `--help` for usage.
+*/
+
+#include <expected_cost.hpp>
+
+int main(int argc, char** argv)
+{
+	return expected_main(argc, argv);
+}
@@ -0,0 +1,16 @@
+/*
+** File Name:	glob_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Compares the interpreted and compiled glob matchers. Run with `--help` for
+** usage.
+*/
+
+#include <glob.hpp>
+
+int main(int argc, char** argv)
+{
+	return glob_main(argc, argv);
+}
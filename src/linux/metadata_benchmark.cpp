@@ -0,0 +1,16 @@
+/*
+** File Name:	metadata_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures the rates of metadata operations and the throughput of directory
+** listing. Run with `--help` for usage.
+*/
+
+#include <metadata.hpp>
+
+int main(int argc, char** argv)
+{
+	return metadata_main(argc, argv);
+}
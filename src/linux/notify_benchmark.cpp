@@ -0,0 +1,16 @@
+/*
+** File Name:	notify_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Compares ways of being notified of completed asynchronous reads. Run with
+** `--help` for usage.
+*/
+
+#include <notify.hpp>
+
+int main(int argc, char** argv)
+{
+	return notify_main(argc, argv);
+}
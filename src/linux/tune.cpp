@@ -0,0 +1,16 @@
+/*
+** File Name:	tune.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Finds the fastest engine configuration for each file and writes a tuning
+** profile. Run with `--help` for usage.
+*/
+
+#include <tune.hpp>
+
+int main(int argc, char** argv)
+{
+	return tune_main(argc, argv);
+}
@@ -0,0 +1,16 @@
+/*
+** File Name:	analyze_trace.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Summarizes a trace written by `benchmark.run --trace`. Run with `--help` for
+** usage.
+*/
+
+#include <trace_analysis.hpp>
+
+int main(int argc, char** argv)
+{
+	return analyze_main(argc, argv);
+}
@@ -0,0 +1,15 @@
+/*
+** File Name:	make_data.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Creates the test files used by the benchmarks. Run with `--help` for usage.
+*/
+
+#include <generate.hpp>
+
+int main(int argc, char** argv)
+{
+	return generate_main(argc, argv);
+}
@@ -0,0 +1,15 @@
+/*
+** File Name:	pipeline_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures a read, transform, and write pipeline. Run with `--help` for usage.
+*/
+
+#include <pipeline.hpp>
+
+int main(int argc, char** argv)
+{
+	return pipeline_main(argc, argv);
+}
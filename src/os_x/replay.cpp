@@ -0,0 +1,15 @@
+/*
+** File Name:	replay.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Replays a recorded IO trace against a file. Run with `--help` for usage.
+*/
+
+#include <replay.hpp>
+
+int main(int argc, char** argv)
+{
+	return replay_main(argc, argv);
+}
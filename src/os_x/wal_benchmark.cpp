@@ -0,0 +1,15 @@
+/*
+** File Name:	wal_benchmark.cpp
+** Author:	Aditya Ramesh
+** Date:	10/18/2026
+** Contact:	_@adityaramesh.com
+**
+** Measures group commit to a write-ahead log. Run with `--help` for usage.
+*/
+
+#include <wal.hpp>
+
+int main(int argc, char** argv)
+{
+	return wal_main(argc, argv);
+}
@@ -0,0 +1,169 @@
+#! /usr/bin/env ruby
+
+# Compares two sets of results written with `-f json` by `out/benchmark.run`,
+# `out/metadata_benchmark.run`, or the other programs that use
+# `include/report.hpp`. Each argument is either a JSON file or a directory of
+# JSON files. For every configuration (engine, block size, queue depth,
+# placement, consumer stage, threads, and file size or number of entries) that
+# occurs in both sets, the trial times are compared with a two-sided
+# Mann-Whitney U test. A change is reported as a regression if it is significant
+# at the level `--alpha` and the median slows down by more than `--threshold`
+# percent. Configurations whose baseline median is zero, which happens when the
+# trials are shorter than the resolution of the timer, are listed separately and
+# are never counted as regressions. The exit status is nonzero if there are any
+# regressions, so that this can be used as a gate.
+#
+# Usage: tools/compare.rb [--alpha A] [--threshold PERCENT] baseline candidate
+
+require 'json'
+
+def load_results(path)
+	files = File.directory?(path) ? Dir[File.join(path, '*.json')].sort : [path]
+	abort "No results found in \"#{path}\"." if files.empty?
+
+	env = {}
+	results = {}
+	files.each do |f|
+		data = JSON.parse(File.read(f))
+		env = data['environment'] if env.empty?
+		data['results'].each do |r|
+			key = [r['engine'], r['block_size'], r['queue_depth'] || 0,
+				r['placement'] || '', r['consumer'] || 'count',
+				r['threads'] || r['streams'] || 1, r['file_size'] || r['entries']]
+			(results[key] ||= []).concat(r['samples_ms'])
+		end
+	end
+	[env, results]
+end
+
+def median(v)
+	s = v.sort
+	n = s.size
+	n.odd? ? s[n / 2] : (s[n / 2 - 1] + s[n / 2]) / 2.0
+end
+
+# Returns the two-sided p-value of the Mann-Whitney U test, using the normal
+# approximation with a correction for ties.
+def mann_whitney(a, b)
+	n1 = a.size
+	n2 = b.size
+	all = a.map { |x| [x, 0] } + b.map { |x| [x, 1] }
+	all.sort_by! { |x| x[0] }
+
+	ranks = Array.new(all.size)
+	ties = 0.0
+	i = 0
+	while i < all.size
+		j = i
+		j += 1 while j + 1 < all.size && all[j + 1][0] == all[i][0]
+		r = (i + j) / 2.0 + 1
+		(i..j).each { |k| ranks[k] = r }
+		t = j - i + 1
+		ties += t**3 - t
+		i = j + 1
+	end
+
+	r1 = (0...all.size).select { |k| all[k][1] == 0 }.map { |k| ranks[k] }.sum
+	u = r1 - n1 * (n1 + 1) / 2.0
+	n = n1 + n2
+	var = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)))
+	return 1.0 if var <= 0
+
+	z = (u - n1 * n2 / 2.0).abs / Math.sqrt(var)
+	Math.erfc(z / Math.sqrt(2))
+end
+
+# Formats a size as `format_size` in `include/options.hpp` does.
+def format_size(n)
+	n % 1024 == 0 ? "#{n / 1024} KB" : "#{n} B"
+end
+
+def label(key)
+	engine, block_size, queue_depth, placement, consumer, threads, size = key
+	s = block_size.zero? ? engine : "#{engine} #{format_size(block_size)}"
+	s += " qd #{queue_depth}" unless queue_depth.zero?
+	s += " @ #{placement}" unless placement.empty?
+	s += " [#{consumer}]" unless consumer == 'count'
+	s += " #{threads} threads" if threads > 1
+	"#{s} (#{size})"
+end
+
+def print_environment_changes(a, b)
+	changes = []
+	(a['system'] || {}).each do |k, v|
+		w = (b['system'] || {})[k]
+		changes << "  #{k}: #{v} -> #{w}" if w != v
+	end
+	fa = (a['files'] || []).map { |f| [f['path'], f] }.to_h
+	(b['files'] || []).each do |f|
+		g = fa[f['path']] or next
+		f.each do |k, v|
+			changes << "  #{f['path']} #{k}: #{g[k]} -> #{v}" if g[k] != v
+		end
+	end
+	return if changes.empty?
+	puts "The environments differ, so changes may not be due to the code:"
+	puts changes
+	puts
+end
+
+alpha = 0.05
+threshold = 5.0
+args = []
+i = 0
+while i < ARGV.size
+	case ARGV[i]
+	when '--alpha'     then alpha = Float(ARGV[i += 1])
+	when '--threshold' then threshold = Float(ARGV[i += 1])
+	when '-h', '--help'
+		puts "Usage: #{$0} [--alpha A] [--threshold PERCENT] baseline candidate"
+		exit
+	else args << ARGV[i]
+	end
+	i += 1
+end
+abort "Usage: #{$0} [--alpha A] [--threshold PERCENT] baseline candidate" if args.size != 2
+
+env_a, base = load_results(args[0])
+env_b, cand = load_results(args[1])
+print_environment_changes(env_a, env_b)
+
+regressions = 0
+# Configurations whose baseline median is below the resolution of the timer,
+# for which there is no relative change.
+unresolved = []
+printf("%-40s %12s %12s %9s %9s  %s\n", 'Configuration', 'Base (ms)',
+	'New (ms)', 'Change', 'p', 'Verdict')
+
+base.keys.select { |k| cand.key?(k) }.each do |k|
+	a = base[k]
+	b = cand[k]
+	ma = median(a)
+	mb = median(b)
+	if ma == 0
+		unresolved << [k, mb]
+		next
+	end
+	change = 100.0 * (mb - ma) / ma
+	p = mann_whitney(a, b)
+
+	verdict =
+		if p >= alpha || change.abs <= threshold then 'same'
+		elsif change > 0 then 'slower'
+		else 'faster'
+		end
+	regressions += 1 if verdict == 'slower'
+	printf("%-40s %12.3f %12.3f %+8.1f%% %9.4f  %s\n", label(k), ma, mb,
+		change, p, verdict)
+end
+
+unresolved.each do |k, mb|
+	printf("Zero baseline median: %s (new %.3f ms)\n", label(k), mb)
+end
+(base.keys - cand.keys).each { |k| puts "Only in baseline: #{label(k)}" }
+(cand.keys - base.keys).each { |k| puts "Only in candidate: #{label(k)}" }
+
+if regressions > 0
+	puts "\n#{regressions} regression(s)."
+	exit 1
+end
@@ -1,14 +1,14 @@
 #! /usr/bin/env ruby
 
-def make_test_files()
-	block_size = 64 * 2**10
+# Any arguments are forwarded to `out/make_data.run` (e.g. `-c needles -p`). Run
+# `./out/make_data.run --help` for the list of options.
+def make_test_files(args)
 	[8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256,
 	320, 384, 448, 512, 640, 768, 896, 1024].each do |i|
-		file_size = i * 2**20
-		count = file_size / block_size
 		puts "Creating #{i} MB test file."
-		`dd if=/dev/urandom of=data/test_#{i}.bin bs=#{block_size} count=#{count}`
+		system("./out/make_data.run", *args, "data/test_#{i}.bin", "#{i}M") or
+			abort "Failed to create data/test_#{i}.bin."
 	end
 end
 
-make_test_files()
+make_test_files(ARGV)